@@ -0,0 +1,329 @@
+// bench - diff/patch benchmarks over generated corpora
+//
+//   bench [--filter TEXT] [--min-time MS] [--json FILE]
+//
+// Every scenario builds a (left, right) document pair at several sizes and times Diff, DiffTo
+// (into a reused buffer) and Patch on it. Each case reports ns/op, heap allocations and bytes
+// allocated per op (counted by the operator new replacement in alloc_counter.h) and the size of the
+// delta text. --filter runs only cases whose name ("scenario/size/op") contains TEXT,
+// --min-time sets the minimum measuring time per case (default 200 ms) and --json also
+// writes the results as JSON to FILE ("-" for stdout) for tracking regressions.
+
+#include "JsonDiffPatch/JsonDiffPatch.h"
+#include "../tests/alloc_counter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+    const int EXIT_OK = 0;
+    const int EXIT_ERROR = 2;
+
+    const double DEFAULT_MIN_TIME_MS = 200.0;
+
+    const char* const OPS[] = { "diff", "diff_to", "patch" };
+
+    struct Corpus {
+        json left;
+        json right;
+        JsonDiffPatch::Options options;
+    };
+
+    struct Scenario {
+        const char* name;
+        std::vector<size_t> sizes;
+        std::function<Corpus(size_t size, std::mt19937& rng)> build;
+    };
+
+    struct Result {
+        std::string name;
+        std::string scenario;
+        size_t size;
+        std::string op;
+        size_t iterations;
+        double nsPerOp;
+        double allocsPerOp;
+        double bytesPerOp;
+        size_t deltaBytes;
+    };
+
+    size_t Pick(std::mt19937& rng, size_t count) {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+    }
+
+    // Multiplayer game state: players keyed by id with position, stats and inventory;
+    // about one player in twenty moves and a few take damage or pick something up
+    Corpus GameState(size_t players, std::mt19937& rng) {
+        Corpus corpus;
+        json& state = corpus.left;
+        state["tick"] = 1000;
+        state["map"] = "arena_03";
+        for (size_t i = 0; i < players; ++i) {
+            json player;
+            player["name"] = "player" + std::to_string(i);
+            player["pos"] = { { "x", double(Pick(rng, 1000)) }, { "y", double(Pick(rng, 1000)) }, { "z", 0.0 } };
+            player["hp"] = 100;
+            player["team"] = i % 2 ? "red" : "blue";
+            player["inventory"] = { { "ammo", 30 }, { "grenades", 2 }, { "medkits", 1 } };
+            player["flags"] = { { "alive", true }, { "crouched", false } };
+            state["players"][std::to_string(1000 + i)] = player;
+        }
+
+        corpus.right = state;
+        json& next = corpus.right;
+        next["tick"] = 1001;
+        for (auto& player : next["players"]) {
+            size_t roll = Pick(rng, 20);
+            if (roll == 0) {
+                player["pos"]["x"] = player["pos"]["x"].get<double>() + 1.5;
+                player["pos"]["y"] = player["pos"]["y"].get<double>() - 0.5;
+            } else if (roll == 1) {
+                player["hp"] = player["hp"].get<int>() - 10;
+            } else if (roll == 2) {
+                player["inventory"]["ammo"] = 29;
+            }
+        }
+        return corpus;
+    }
+
+    // Entity list matched by id: a few entities despawn, spawn or change state
+    Corpus Entities(size_t count, std::mt19937& rng) {
+        Corpus corpus;
+        corpus.options.ObjectHash = [](const json& item) {
+            auto id = item.find("id");
+            return id != item.end() ? id->dump() : item.dump();
+        };
+        corpus.left = json::array();
+        for (size_t i = 0; i < count; ++i) {
+            corpus.left.push_back({ { "id", i }, { "type", i % 3 ? "npc" : "item" },
+                                    { "x", int(Pick(rng, 500)) }, { "y", int(Pick(rng, 500)) }, { "hp", 50 } });
+        }
+
+        size_t nextId = count;
+        corpus.right = json::array();
+        for (const auto& entity : corpus.left) {
+            size_t roll = Pick(rng, 50);
+            if (roll == 0) {
+                continue;
+            }
+            json copy = entity;
+            if (roll == 1) {
+                copy["hp"] = 40;
+            } else if (roll == 2) {
+                corpus.right.push_back({ { "id", nextId++ }, { "type", "npc" }, { "x", 0 }, { "y", 0 }, { "hp", 50 } });
+            }
+            corpus.right.push_back(std::move(copy));
+        }
+        return corpus;
+    }
+
+    // Large array of numbers with one percent of the values changed in place
+    Corpus Numbers(size_t count, std::mt19937& rng) {
+        Corpus corpus;
+        corpus.left = json::array();
+        for (size_t i = 0; i < count; ++i) {
+            corpus.left.push_back(int(Pick(rng, 1000000)));
+        }
+        corpus.right = corpus.left;
+        for (size_t i = 0; i < count / 100 + 1; ++i) {
+            corpus.right[Pick(rng, count)] = -1;
+        }
+        return corpus;
+    }
+
+    // Array of numbers with a few values inserted and removed, which needs the LCS
+    Corpus NumbersShifted(size_t count, std::mt19937& rng) {
+        Corpus corpus = Numbers(count, rng);
+        corpus.right = corpus.left;
+        auto& values = corpus.right.get_ref<json::array_t&>();
+        for (int i = 0; i < 3; ++i) {
+            values.insert(values.begin() + Pick(rng, values.size()), -2);
+            values.erase(values.begin() + Pick(rng, values.size()));
+        }
+        values.insert(values.begin() + 1, -3);
+        values.erase(values.end() - 2);
+        return corpus;
+    }
+
+    // Object of long text fields (chat log, descriptions) with small edits in a few
+    Corpus LongStrings(size_t fields, std::mt19937& rng) {
+        static const char* words[] = { "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "and", "runs" };
+        Corpus corpus;
+        for (size_t i = 0; i < fields; ++i) {
+            std::string text;
+            while (text.size() < 2000) {
+                text += words[Pick(rng, 10)];
+                text += ' ';
+            }
+            corpus.left["text" + std::to_string(i)] = text;
+            if (i % 4 == 0) {
+                text.replace(Pick(rng, 1900), 8, "EDITED! ");
+                text += "appended line";
+            }
+            corpus.right["text" + std::to_string(i)] = text;
+        }
+        return corpus;
+    }
+
+    // Chain of nested objects, changed at the bottom and in one sibling on the way down
+    Corpus DeepNesting(size_t depth, std::mt19937&) {
+        Corpus corpus;
+        json left = { { "leaf", 1 }, { "note", "bottom" } };
+        json right = { { "leaf", 2 }, { "note", "bottom" } };
+        for (size_t level = depth; level > 0; --level) {
+            json wrappedLeft = { { "child", std::move(left) }, { "level", level }, { "tags", { "a", "b" } } };
+            json wrappedRight = { { "child", std::move(right) }, { "level", level }, { "tags", { "a", "b" } } };
+            if (level == depth / 2) {
+                wrappedRight["tags"].push_back("c");
+            }
+            left = std::move(wrappedLeft);
+            right = std::move(wrappedRight);
+        }
+        corpus.left = std::move(left);
+        corpus.right = std::move(right);
+        return corpus;
+    }
+
+    std::vector<Scenario> Scenarios() {
+        return {
+            { "game_state", { 10, 100, 1000 }, GameState },
+            { "entities", { 100, 1000, 2000 }, Entities },
+            { "numbers", { 1000, 10000, 100000 }, Numbers },
+            { "numbers_shifted", { 1000, 2000 }, NumbersShifted },
+            { "long_strings", { 1, 10, 100 }, LongStrings },
+            { "deep_nesting", { 16, 64, 256 }, DeepNesting },
+        };
+    }
+
+    // Runs op until minTimeMs has passed (at least once after one warm-up call)
+    template<typename Op>
+    Result Measure(double minTimeMs, Op op) {
+        using Clock = std::chrono::steady_clock;
+        op();
+
+        Result result{};
+        AllocationCounter::Scope allocations;
+        auto start = Clock::now();
+        double elapsed = 0;
+        do {
+            op();
+            ++result.iterations;
+            elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        } while (elapsed < minTimeMs * 1e6);
+
+        double n = double(result.iterations);
+        result.nsPerOp = elapsed / n;
+        result.allocsPerOp = double(allocations.Allocations()) / n;
+        result.bytesPerOp = double(allocations.Bytes()) / n;
+        return result;
+    }
+
+    void WriteJson(const std::vector<Result>& results, std::ostream& out) {
+        json report;
+        report["context"] = { { "library", "JsonDiffPatch" }, { "unit", "ns" } };
+        report["benchmarks"] = json::array();
+        for (const auto& r : results) {
+            report["benchmarks"].push_back({
+                { "name", r.name }, { "scenario", r.scenario }, { "size", r.size }, { "op", r.op },
+                { "iterations", r.iterations }, { "ns_per_op", r.nsPerOp },
+                { "allocs_per_op", r.allocsPerOp }, { "bytes_per_op", r.bytesPerOp },
+                { "delta_bytes", r.deltaBytes } });
+        }
+        out << report.dump(2) << '\n';
+    }
+
+    void PrintUsage() {
+        std::fprintf(stderr, "usage: bench [--filter TEXT] [--min-time MS] [--json FILE]\n");
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string jsonPath;
+    double minTimeMs = DEFAULT_MIN_TIME_MS;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) minTimeMs = std::strtod(argv[++i], nullptr);
+        else {
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+    }
+
+    // The table moves to stderr when the JSON report goes to stdout
+    FILE* table = jsonPath == "-" ? stderr : stdout;
+    std::vector<Result> results;
+    std::fprintf(table, "%-32s %14s %12s %14s %12s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", "delta bytes");
+
+    try {
+        for (const auto& scenario : Scenarios()) {
+            for (size_t size : scenario.sizes) {
+                std::string prefix = std::string(scenario.name) + "/" + std::to_string(size) + "/";
+                auto selected = [&](const char* op) {
+                    return filter.empty() || (prefix + op).find(filter) != std::string::npos;
+                };
+                if (std::none_of(std::begin(OPS), std::end(OPS), selected)) {
+                    continue;
+                }
+
+                std::mt19937 rng(static_cast<unsigned>(size));
+                Corpus corpus = scenario.build(size, rng);
+                JsonDiffPatch::JsonDiffPatch jdp(corpus.options);
+                json delta = jdp.Diff(corpus.left, corpus.right);
+                size_t deltaBytes = delta.is_null() ? 0 : delta.dump().size();
+                std::string buffer;
+
+                std::function<void()> ops[] = {
+                    [&] { json d = jdp.Diff(corpus.left, corpus.right); },
+                    [&] { jdp.DiffTo(corpus.left, corpus.right, buffer); },
+                    [&] { json patched = jdp.Patch(corpus.left, delta); },
+                };
+
+                for (size_t k = 0; k < std::size(OPS); ++k) {
+                    if (!selected(OPS[k])) {
+                        continue;
+                    }
+                    Result result = Measure(minTimeMs, ops[k]);
+                    result.name = prefix + OPS[k];
+                    result.scenario = scenario.name;
+                    result.size = size;
+                    result.op = OPS[k];
+                    result.deltaBytes = deltaBytes;
+                    results.push_back(result);
+                    std::fprintf(table, "%-32s %14.0f %12.1f %14.0f %12zu\n", result.name.c_str(),
+                                 result.nsPerOp, result.allocsPerOp, result.bytesPerOp, result.deltaBytes);
+                    std::fflush(table);
+                }
+            }
+        }
+
+        if (jsonPath == "-") {
+            WriteJson(results, std::cout);
+        } else if (!jsonPath.empty()) {
+            std::ofstream file(jsonPath);
+            WriteJson(results, file);
+            if (!file) {
+                throw std::runtime_error("cannot write " + jsonPath);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "bench: %s\n", e.what());
+        return EXIT_ERROR;
+    }
+
+    return EXIT_OK;
+}
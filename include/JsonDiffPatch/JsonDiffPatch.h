@@ -1,9 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <string>
 #include <vector>
 #include <functional>
+#include <iosfwd>
+#include <list>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
 #include "../../thirdparty/nlohmann/json.hpp"
 
 using json = nlohmann::json;
@@ -25,6 +34,29 @@ namespace JsonDiffPatch {
     const int DIFF_INSERT = 1;
     const int DIFF_EQUAL = 2;
 
+    const int BINARY_CBOR = 1;
+    const int BINARY_MSGPACK = 2;
+
+    // Node kinds of a DeltaView
+    const int DELTA_ADDED = 0;      // [right]
+    const int DELTA_DELETED = 1;    // [left, 0, 0]
+    const int DELTA_MODIFIED = 2;   // [left, right]
+    const int DELTA_TEXTDIFF = 3;   // [text, 0, 2]
+    const int DELTA_OBJECT = 4;     // changed members
+    const int DELTA_ARRAY = 5;      // changed entries, {"_t": "a", ...}
+    const int DELTA_MOVED = 6;      // array element moved, ["", target, 3]
+
+    // Steps reported to a DiffTracer
+    const int TRACE_OBJECT_DIFF = 0;
+    const int TRACE_ARRAY_DIFF = 1;
+    const int TRACE_OBJECT_PATCH = 2;
+    const int TRACE_ARRAY_PATCH = 3;
+    const int TRACE_OBJECT_UNPATCH = 4;
+    const int TRACE_ARRAY_UNPATCH = 5;
+
+    // Default memory cap of a DeltaCache
+    const size_t DEFAULT_DELTA_CACHE_BYTES = 16 * 1024 * 1024;
+
     struct TextDiff {
         int operation;
         std::string text;
@@ -46,30 +78,139 @@ namespace JsonDiffPatch {
         bool IncludeValueOnMove = false;
     };
 
-    struct Options {
+    // Work counters and phase timings of the engine calls made while a sink is attached with
+    // SetStats. They add up over calls until Reset(). Timings are in nanoseconds and only cover
+    // outermost calls (TextDiffNs is part of DiffNs). Building with JSONDIFFPATCH_DISABLE_STATS
+    // defined compiles the collection out; the counters then stay zero.
+    struct DiffStats {
+        size_t NodesVisited = 0;      // value pairs compared by Diff, delta nodes applied by Patch/Unpatch
+        size_t LcsArrays = 0;         // arrays that needed the LCS
+        size_t LcsCells = 0;          // LCS table cells filled
+        size_t HashCalls = 0;         // ObjectHash invocations
+        size_t TextDiffs = 0;         // strings diffed or patched with the text diff
+        size_t ValuesCopied = 0;      // subtrees copied into a json delta or result
+        size_t ScratchGrowths = 0;    // times the LCS table kept by the engine had to grow
+        uint64_t ParseNs = 0;
+        uint64_t DiffNs = 0;
+        uint64_t TextDiffNs = 0;
+        uint64_t PatchNs = 0;
+        uint64_t SerializeNs = 0;
+
+        void Reset() { *this = DiffStats(); }
+        // Adds the counters and timings of another sink, e.g. one per worker thread; the
+        // timings then add up thread time rather than elapsed time
+        DiffStats& operator+=(const DiffStats& other);
+    };
+
+    // Receives the object and array steps of Diff, Patch and Unpatch (see Options::Tracer),
+    // nested like the recursion and on the thread running the call. path is a JSON pointer
+    // built from the delta keys (array indices without the "_" prefix), which for diffs
+    // points into the right document. leftCount/rightCount are the member or element counts
+    // of both sides; for patches, of the input value and of the delta entries. DiffTo,
+    // DiffText, DiffView and DiffStream are not traced.
+    class DiffTracer {
+    public:
+        virtual ~DiffTracer() = default;
+        virtual void Enter(int /*operation*/, const std::string& /*path*/, size_t /*leftCount*/, size_t /*rightCount*/) {}
+        virtual void Exit(int operation, const std::string& path, size_t leftCount, size_t rightCount,
+                          uint64_t elapsedNs) = 0;
+    };
+
+    // Counters of a DeltaCache. Bytes is the estimated memory held by its deltas.
+    struct DeltaCacheStats {
+        size_t Hits = 0;
+        size_t Misses = 0;
+        size_t Evictions = 0;
+        size_t Entries = 0;
+        size_t Bytes = 0;
+    };
+
+    // Content hash of a document as used in DeltaCache keys (see BasicDeltaCache::Hash). Two
+    // independently mixed 64-bit words, so that unrelated documents sharing a hash, and getting
+    // each other's delta, is out of practical reach.
+    struct DocumentHash {
+        uint64_t Low = 0;
+        uint64_t High = 0;
+
+        bool operator==(const DocumentHash& other) const { return Low == other.Low && High == other.High; }
+        bool operator!=(const DocumentHash& other) const { return !(*this == other); }
+    };
+
+    // "ObjectDiff", "ArrayPatch", ... for a TRACE_* operation
+    const char* TraceOperationName(int operation);
+
+    // Writes every traced step as a Chrome trace-event ("X" complete event, path and counts
+    // in args), loadable in chrome://tracing or Perfetto. May be shared by engines running on
+    // several threads. The JSON array is closed by Finish() or the destructor.
+    class ChromeTraceWriter : public DiffTracer {
+    public:
+        explicit ChromeTraceWriter(std::ostream& out);
+        ~ChromeTraceWriter() override;
+
+        ChromeTraceWriter(const ChromeTraceWriter&) = delete;
+        ChromeTraceWriter& operator=(const ChromeTraceWriter&) = delete;
+
+        void Exit(int operation, const std::string& path, size_t leftCount, size_t rightCount,
+                  uint64_t elapsedNs) override;
+        void Finish();
+
+    private:
+        std::ostream& _out;
+        std::mutex _mutex;
+        std::chrono::steady_clock::time_point _origin;
+        bool _first = true;
+        bool _finished = false;
+    };
+
+    template<typename BasicJsonType>
+    class BasicDeltaCache;
+
+    // The engine works on any nlohmann::basic_json specialization (BasicJsonType): ordered_json,
+    // custom allocators, string or number types. nlohmann::json and nlohmann::ordered_json are
+    // instantiated in the library; for other types include JsonDiffPatchImpl.h.
+    template<typename BasicJsonType>
+    struct BasicOptions {
         int ArrayDiff = MODE_EFFICIENT;
         int TextDiff = TEXTDIFF_EFFICIENT;
         size_t MinEfficientTextDiffLength = 50;
         ArrayOptions DiffArrayOptions;
-        std::function<std::string(const json&)> ObjectHash = nullptr;
+        std::function<std::string(const BasicJsonType&)> ObjectHash = nullptr;
+        // When set, the transient memory of a call that the instance does not keep for
+        // reuse (DiffTo/DiffText work lists, moved array elements) comes from a monotonic
+        // arena on top of this resource, released in one shot when the outermost
+        // Diff/Patch/Unpatch returns. Deltas and results are regular BasicJsonType values
+        // and never live in the arena.
+        std::pmr::memory_resource* ScratchResource = nullptr;
+        // When set, receives the object/array steps of Diff/Patch/Unpatch with their JSON
+        // pointer and duration. Not owned; it must outlive the engines using it.
+        DiffTracer* Tracer = nullptr;
+        // When set, Diff and DiffTo of a document pair seen before are looked up here instead
+        // of computed (see BasicDeltaCache). Not owned; it must outlive the engines using it.
+        BasicDeltaCache<BasicJsonType>* DeltaCache = nullptr;
+        // Part of every DeltaCache key. An ObjectHash other than a plain function pointer (a
+        // lambda or functor, whose captured state the cache cannot see) is only cached with a
+        // non-zero tag; give each distinct ObjectHash configuration sharing a cache its own.
+        uint64_t DeltaCacheTag = 0;
     };
 
-    // LCS (Longest Common Subsequence) implementation
-    struct LcsResult {
-        std::vector<json> Sequence;
-        std::vector<int> Indices1;
-        std::vector<int> Indices2;
+    // LCS (Longest Common Subsequence) of two element ranges: for every element the index of
+    // its partner on the other side, or -1 if it is not part of the subsequence
+    template<typename BasicJsonType>
+    struct BasicLcsResult {
+        std::vector<int> LeftMatch;
+        std::vector<int> RightMatch;
     };
 
-    class ItemMatch {
+    template<typename BasicJsonType>
+    class BasicItemMatch {
     public:
-        std::function<std::string(const json&)> ObjectHash;
+        std::function<std::string(const BasicJsonType&)> ObjectHash;
         
-        ItemMatch(std::function<std::string(const json&)> objectHash = nullptr)
+        BasicItemMatch(std::function<std::string(const BasicJsonType&)> objectHash = nullptr)
             : ObjectHash(objectHash) {}
         
-        bool Match(const json& obj1, const json& obj2) const;
-        bool MatchArrayElement(const json& obj1, int index1, const json& obj2, int index2) const;
+        bool Match(const BasicJsonType& obj1, const BasicJsonType& obj2) const;
+        bool MatchArrayElement(const BasicJsonType& obj1, int index1, const BasicJsonType& obj2, int index2) const;
     };
 
     // Simple text diff engine (basic version of DiffMatchPatch)
@@ -85,49 +226,620 @@ namespace JsonDiffPatch {
         static std::pair<std::string, std::vector<bool>> ApplyPatches(const std::vector<TextPatch>& patches, const std::string& text);
     };
 
-    // Main JsonDiffPatch class
-    class JsonDiffPatch {
+    // Compact binary delta encoding. A delta is rewritten into arrays headed by numeric op
+    // codes (object keys stay strings, array indices become integers instead of "_12"-style
+    // keys) and then serialized as CBOR or MessagePack, prefixed by one format byte.
+    // An empty buffer stands for "no difference".
+    template<typename BasicJsonType>
+    class BasicBinaryDelta {
+    public:
+        static std::vector<uint8_t> Encode(const BasicJsonType& delta, int format = BINARY_CBOR);
+        static BasicJsonType Decode(const uint8_t* data, size_t size);
+        static BasicJsonType Decode(const std::vector<uint8_t>& data) { return Decode(data.data(), data.size()); }
+    };
+
+    // Typed delta whose values point into the two documents it was computed from (or into
+    // the json delta it was read from) instead of copying them, so replacing a large subtree
+    // costs one node. Array entries carry integer indices. The referenced documents must
+    // outlive the view and stay unmodified. Materialize() builds the equivalent json delta,
+    // FromJson() reads one; Patch/Unpatch apply a view directly.
+    template<typename BasicJsonType>
+    class BasicDeltaView {
+    public:
+        struct Node {
+            int Kind = DELTA_OBJECT;
+            const typename BasicJsonType::string_t* Key = nullptr;  // member name inside an object
+            size_t Index = 0;                       // entry index inside an array ("_3" when deleted or moved)
+            size_t Target = 0;                      // destination index of a move
+            const BasicJsonType* Left = nullptr;    // deleted or old value
+            const BasicJsonType* Right = nullptr;   // added or new value
+            std::string Text;                       // text diff patches
+            std::vector<Node> Children;             // object/array entries in delta order
+        };
+
+        // True if the documents were equal
+        bool Empty() const { return !_root; }
+        const Node& Root() const { return *_root; }
+
+        // The delta Diff would have returned (null when equal)
+        BasicJsonType Materialize() const;
+        static BasicJsonType Materialize(const Node& node);
+
+        // Reads a delta in the jsondiffpatch JSON format; throws on malformed deltas
+        static BasicDeltaView FromJson(const BasicJsonType& delta);
+        static BasicDeltaView FromJson(BasicJsonType&& delta) = delete;
+
+    private:
+        template<typename> friend class BasicJsonDiffPatch;
+        static void ReadNode(const BasicJsonType& delta, Node& node);
+        static void ReadArray(const BasicJsonType& delta, Node& node);
+        std::unique_ptr<Node> _root;
+    };
+
+    namespace detail {
+
+        // One entry of the work lists ArrayPatch/ArrayUnpatch collect before applying them
+        template<typename BasicJsonType>
+        struct ArrayOp {
+            size_t index;
+            size_t target;                  // destination of a move
+            const BasicJsonType* value;     // points into the delta
+            bool isMove;
+        };
+
+        // Growable buffers an engine keeps between calls. The LCS table only lives during
+        // one ComputeLcs; buffers still needed while the engine recurses into array elements
+        // are leased per nesting level, so nested arrays get their own.
+        template<typename BasicJsonType>
+        class Workspace {
+        public:
+            struct Frame {
+                BasicLcsResult<BasicJsonType> lcs;
+                std::vector<ArrayOp<BasicJsonType>> ops[4];
+            };
+
+            // Holds the frame of the next nesting level, cleared, until destroyed
+            class Lease {
+            public:
+                explicit Lease(Workspace& workspace) : _workspace(workspace), frame(workspace.Acquire()) {}
+                ~Lease() { --_workspace._depth; }
+                Lease(const Lease&) = delete;
+                Lease& operator=(const Lease&) = delete;
+
+            private:
+                Workspace& _workspace;
+
+            public:
+                Frame& frame;
+            };
+
+            Workspace() = default;
+            // Scratch memory is not engine state: copies start out empty
+            Workspace(const Workspace&) {}
+            Workspace& operator=(const Workspace&) { return *this; }
+
+            // Serializer writing to a retargetable string. Kept for DiffTo/DiffText because
+            // constructing a serializer allocates its indentation buffer.
+            class StringSink : public nlohmann::detail::output_adapter_protocol<char> {
+            public:
+                void write_character(char c) override { out->push_back(c); }
+                void write_characters(const char* s, std::size_t length) override { out->append(s, length); }
+
+                std::string* out = nullptr;
+            };
+
+            struct Output {
+                StringSink sink;
+                nlohmann::detail::serializer<BasicJsonType> serializer;
+
+                // Non-owning handle on the sink
+                Output() : serializer(nlohmann::detail::output_adapter_t<char>(std::shared_ptr<void>(), &sink), ' ') {}
+            };
+
+            // Flat (m + 1) x (n + 1) LCS table
+            std::vector<int> lcsMatrix;
+
+            // The kept serializer, now writing to out
+            Output& BindOutput(std::string& out) {
+                if (!_output) {
+                    _output = std::make_unique<Output>();
+                }
+                _output->sink.out = &out;
+                return *_output;
+            }
+
+            void Shrink() {
+                lcsMatrix = std::vector<int>();
+                _frames.resize(_depth);
+                _output.reset();
+            }
+
+        private:
+            Frame& Acquire() {
+                if (_depth == _frames.size()) {
+                    _frames.push_back(std::make_unique<Frame>());
+                }
+                Frame& frame = *_frames[_depth++];
+                frame.lcs.LeftMatch.clear();
+                frame.lcs.RightMatch.clear();
+                for (auto& ops : frame.ops) {
+                    ops.clear();
+                }
+                return frame;
+            }
+
+            std::vector<std::unique_ptr<Frame>> _frames;
+            size_t _depth = 0;
+            std::unique_ptr<Output> _output;
+        };
+
+        template<typename StringType>
+        struct PathTrie;
+
+        // Statistics sink of an engine. Copies start without one, so engines copied to other
+        // threads never write to the same DiffStats.
+        class StatsSink {
+        public:
+            StatsSink() = default;
+            StatsSink(const StatsSink&) {}
+            StatsSink& operator=(const StatsSink&) { return *this; }
+
+            DiffStats* stats = nullptr;
+        };
+
+    } // namespace detail
+
+    template<typename BasicJsonType>
+    class BasicDiffSession;
+
+    template<typename BasicJsonType>
+    class BasicTrackedDocument;
+
+    // Main JsonDiffPatch class. An instance keeps scratch buffers between calls, so it must
+    // not be used by several threads at the same time; give each thread its own.
+    template<typename BasicJsonType>
+    class BasicJsonDiffPatch {
+    public:
+        using json_type = BasicJsonType;
+        using Options = BasicOptions<BasicJsonType>;
+        using DeltaView = BasicDeltaView<BasicJsonType>;
+        
     private:
+        using ItemMatch = BasicItemMatch<BasicJsonType>;
+        using LcsResult = BasicLcsResult<BasicJsonType>;
+        
         Options _options;
+        ItemMatch _itemMatch;
+        detail::Workspace<BasicJsonType> _scratch;
+        detail::StatsSink _stats;
+        std::string _tracePath;   // JSON pointer of the value being traced, kept only with a Tracer
+        bool _caching = false;    // inside a Diff whose result goes to Options::DeltaCache
+        
+        BasicJsonType ObjectDiff(const BasicJsonType& left, const BasicJsonType& right);
+        BasicJsonType ArrayDiff(const BasicJsonType& left, const BasicJsonType& right);
+        BasicJsonType ObjectPatch(const BasicJsonType& obj, const BasicJsonType& patch);
+        BasicJsonType ArrayPatch(const BasicJsonType& left, const BasicJsonType& patch);
+        BasicJsonType ObjectUnpatch(const BasicJsonType& obj, const BasicJsonType& patch);
+        BasicJsonType ArrayUnpatch(const BasicJsonType& right, const BasicJsonType& patch);
+        BasicJsonType HintedDiff(const detail::PathTrie<typename BasicJsonType::string_t>& hints,
+                                 const BasicJsonType& left, const BasicJsonType& right);
+        bool UsesDeltaCache() const;
+        BasicJsonType CachedDiff(const BasicJsonType& left, const BasicJsonType& right,
+                                 const DocumentHash& leftHash, const DocumentHash& rightHash);
+        bool CachedDiffTo(const BasicJsonType& left, const BasicJsonType& right,
+                          const DocumentHash& leftHash, const DocumentHash& rightHash, std::string& out);
+        
+        void PatchNode(BasicJsonType& target, const typename BasicDeltaView<BasicJsonType>::Node& node);
+        void UnpatchNode(BasicJsonType& target, const typename BasicDeltaView<BasicJsonType>::Node& node);
+        void PatchArrayNode(BasicJsonType& target, const typename BasicDeltaView<BasicJsonType>::Node& node);
+        void UnpatchArrayNode(BasicJsonType& target, const typename BasicDeltaView<BasicJsonType>::Node& node);
         
-        json ObjectDiff(const json& left, const json& right);
-        json ArrayDiff(const json& left, const json& right);
-        json ObjectPatch(const json& obj, const json& patch);
-        json ArrayPatch(const json& left, const json& patch);
-        json ObjectUnpatch(const json& obj, const json& patch);
-        json ArrayUnpatch(const json& right, const json& patch);
+        void ComputeLcs(const BasicJsonType* left, size_t leftSize,
+                        const BasicJsonType* right, size_t rightSize, LcsResult& result);
+        // ComputeLcs in parts, so a DiffSession can fill the table over several steps. Cells
+        // are numbered row by row over the leftSize x rightSize interior of the table.
+        void BeginLcs(size_t leftSize, size_t rightSize);
+        void FillLcs(const BasicJsonType* left, const BasicJsonType* right, size_t rightSize,
+                     size_t firstCell, size_t lastCell);
+        void BacktrackLcs(const BasicJsonType* left, size_t leftSize,
+                          const BasicJsonType* right, size_t rightSize, LcsResult& result);
+        BasicJsonType DecodeDelta(const std::vector<uint8_t>& binaryDelta);
         
-        LcsResult ComputeLcs(const std::vector<json>& left, const std::vector<json>& right, const ItemMatch& match);
+        class DeltaWriter;
+        class DeltaViewBuilder;
+        friend class BasicDiffSession<BasicJsonType>;
+        friend class BasicTrackedDocument<BasicJsonType>;
         
     public:
-        JsonDiffPatch() = default;
-        JsonDiffPatch(const Options& options) : _options(options) {}
+        BasicJsonDiffPatch() = default;
+        BasicJsonDiffPatch(const Options& options) : _options(options), _itemMatch(options.ObjectHash) {}
+        
+        BasicJsonType Diff(const BasicJsonType& left, const BasicJsonType& right);
+        BasicJsonType Patch(const BasicJsonType& left, const BasicJsonType& patch);
+        BasicJsonType Unpatch(const BasicJsonType& right, const BasicJsonType& patch);
+        
+        // Diff of documents known to differ only below the given JSON pointers: only those
+        // subtrees (and the objects and arrays leading to them) are compared, everything else
+        // is taken as equal. Arrays on the way are diffed whole if their lengths differ or
+        // their elements are not diffed one by one (simple mode, ObjectHash). Pointers that
+        // exist on neither side are ignored; "" diffs the whole documents.
+        BasicJsonType Diff(const BasicJsonType& left, const BasicJsonType& right,
+                           const std::vector<typename BasicJsonType::json_pointer>& hints);
+        
+        // Diff with the documents' BasicDeltaCache::Hash values already known, so a lookup in
+        // Options::DeltaCache does not traverse the documents to hash them. The hashes are
+        // trusted; without a cache they are ignored.
+        BasicJsonType Diff(const BasicJsonType& left, const BasicJsonType& right,
+                           const DocumentHash& leftHash, const DocumentHash& rightHash);
+        
+        // Delta from the snapshot of a tracked document to its current value, visiting only
+        // the paths changed since the last Commit (see BasicTrackedDocument)
+        BasicJsonType Diff(const BasicTrackedDocument<BasicJsonType>& document);
         
-        json Diff(const json& left, const json& right);
-        json Patch(const json& left, const json& patch);
-        json Unpatch(const json& right, const json& patch);
+        // Releases the LCS table, array work lists and serializer kept for reuse between calls
+        void ShrinkScratch() { _scratch.Shrink(); }
+        
+        // Attaches a DiffStats sink (nullptr detaches it); it must outlive the calls it records
+        void SetStats(DiffStats* stats) { _stats.stats = stats; }
+        DiffStats* Stats() const { return _stats.stats; }
+        
+        // Writes the delta as JSON text straight into out (its previous contents are replaced)
+        // without building the delta as a json tree; reusing the same string keeps its capacity.
+        // The text equals Diff(left, right).dump(). Returns false and leaves out empty if equal.
+        bool DiffTo(const BasicJsonType& left, const BasicJsonType& right, std::string& out);
+        // DiffTo with known document hashes, as for Diff above
+        bool DiffTo(const BasicJsonType& left, const BasicJsonType& right,
+                    const DocumentHash& leftHash, const DocumentHash& rightHash, std::string& out);
+        
+        // Like DiffTo, but for two JSON texts. Members that are byte-identical on both sides are
+        // validated once but not parsed into values; only the differing subtrees are parsed and
+        // diffed. Empty text counts as "". Throws on invalid JSON anywhere in either text.
+        bool DiffText(const char* left, size_t leftLength, const char* right, size_t rightLength,
+                      std::string& out);
+        
+        // Computes the delta as a view into left and right (see BasicDeltaView); temporaries
+        // are rejected because the view would dangle
+        DeltaView DiffView(const BasicJsonType& left, const BasicJsonType& right);
+        DeltaView DiffView(BasicJsonType&& left, const BasicJsonType& right) = delete;
+        DeltaView DiffView(const BasicJsonType& left, BasicJsonType&& right) = delete;
+        DeltaView DiffView(BasicJsonType&& left, BasicJsonType&& right) = delete;
+        
+        // Starts a diff that is computed in slices of bounded work (see BasicDiffSession);
+        // temporaries are rejected because the session keeps pointers into both documents
+        BasicDiffSession<BasicJsonType> BeginDiff(const BasicJsonType& left, const BasicJsonType& right);
+        BasicDiffSession<BasicJsonType> BeginDiff(BasicJsonType&& left, const BasicJsonType& right) = delete;
+        BasicDiffSession<BasicJsonType> BeginDiff(const BasicJsonType& left, BasicJsonType&& right) = delete;
+        BasicDiffSession<BasicJsonType> BeginDiff(BasicJsonType&& left, BasicJsonType&& right) = delete;
+        
+        // Apply a view in place on one copy of the document, without going through json deltas.
+        // Stricter than the json overloads: an array delta on a non-array throws.
+        BasicJsonType Patch(const BasicJsonType& left, const DeltaView& delta);
+        BasicJsonType Unpatch(const BasicJsonType& right, const DeltaView& delta);
+        
+        std::vector<uint8_t> DiffBinary(const BasicJsonType& left, const BasicJsonType& right, int format = BINARY_CBOR);
+        BasicJsonType Patch(const BasicJsonType& left, const std::vector<uint8_t>& binaryDelta);
+        BasicJsonType Unpatch(const BasicJsonType& right, const std::vector<uint8_t>& binaryDelta);
+        
+        // Streaming diff of two JSON texts without building either document. Both inputs are
+        // tokenized in lockstep and walked member by member, so memory stays proportional to the
+        // nesting depth plus what has to be materialized: values whose types differ, object
+        // members whose keys appear in a different order, and in an array whose elements differ,
+        // the window between its common head and tail, which the regular ArrayDiff then diffs. At
+        // the first differing element both arrays are counted on a second pass over the input:
+        // equal lengths are diffed position by position, other lengths compare the elements at the
+        // same distance from the end. Memory ranges and streams that seek are read this way; other
+        // streams materialize the rest of the array from its first difference on. With ObjectHash
+        // or MODE_SIMPLE arrays are materialized whole. Each delta fragment is handed to
+        // onFragment as soon as it is known, with the delta keys leading to it (array entries use
+        // "3" / "_3" keys and each array delta is announced by a {"_t": "a"} fragment before its
+        // first entry). Returns true if any difference was found; throws on invalid input.
+        using DeltaFragmentHandler = std::function<void(const std::vector<std::string>& path, BasicJsonType&& fragment)>;
+        
+        bool DiffStream(std::istream& left, std::istream& right, const DeltaFragmentHandler& onFragment);
+        bool DiffStream(const char* left, size_t leftLength, const char* right, size_t rightLength,
+                        const DeltaFragmentHandler& onFragment);
+        BasicJsonType DiffStream(std::istream& left, std::istream& right);
+        
+        // Merges a fragment produced by DiffStream into a delta
+        static void ApplyFragment(BasicJsonType& delta, const std::vector<std::string>& path, BasicJsonType&& fragment);
         
         std::string Diff(const std::string& left, const std::string& right);
         std::string Patch(const std::string& left, const std::string& patch);
         std::string Unpatch(const std::string& right, const std::string& patch);
     };
 
+    // Diff computed in slices, for callers that must not block for long, such as a game
+    // spreading a large diff over several frames. Every Step does about budget units of work:
+    // one per value pair diffed, object member or array element visited and LCS cell filled.
+    // Nested objects and arrays are walked rather than compared whole, so a step stops close
+    // to its budget even in deep documents. What is never split: comparing two scalars, one
+    // text diff, one copied subtree, array elements matched through an ObjectHash (nested
+    // arrays are compared whole there) and arrays in MODE_SIMPLE, which are compared in one
+    // go. The traversal stack and the LCS progress are kept between steps, and the result
+    // equals Diff(left, right). The session works on a copy of the engine, so the engine stays
+    // free for other calls; it counts into the engine's DiffStats sink but is not traced.
+    // left and right must outlive the session and stay unmodified. If a step throws (an
+    // ObjectHash failing), later calls throw std::logic_error.
+    template<typename BasicJsonType>
+    class BasicDiffSession {
+    public:
+        // True once the delta is complete
+        bool Done() const { return _started && _frames.empty() && !_failed; }
+
+        // Works for about budget units (at least one); returns Done()
+        bool Step(size_t budget);
+
+        // Does the remaining work and returns the delta (null when equal); call it once
+        BasicJsonType Finish();
+
+    private:
+        friend class BasicJsonDiffPatch<BasicJsonType>;
+
+        // An object or array being diffed
+        struct Frame {
+            const BasicJsonType* left = nullptr;
+            const BasicJsonType* right = nullptr;
+            int stage = 0;
+            BasicJsonType delta;                            // built so far
+            typename BasicJsonType::const_iterator member;  // next member of an object stage
+            size_t index = 0;                               // next element (or LCS cell) of an array stage
+            size_t head = 0;                                // common head and tail of an array
+            size_t tail = 0;
+            BasicLcsResult<BasicJsonType> lcs;
+            // Where the delta of the child being diffed goes
+            const typename BasicJsonType::string_t* childKey = nullptr;
+            size_t childIndex = 0;
+        };
+
+        BasicDiffSession(const BasicJsonDiffPatch<BasicJsonType>& engine,
+                         const BasicJsonType& left, const BasicJsonType& right);
+
+        bool Visit(const BasicJsonType& left, const BasicJsonType& right, BasicJsonType& delta);
+        void Push(const BasicJsonType& left, const BasicJsonType& right, int stage);
+        void StepObject(Frame& frame);
+        void StepArray(Frame& frame);
+        void Deliver(Frame& parent, BasicJsonType&& delta);
+        void Complete();
+        bool OutOfBudget() const { return _spent >= _budget; }
+
+        BasicJsonDiffPatch<BasicJsonType> _engine;
+        const BasicJsonType* _left;
+        const BasicJsonType* _right;
+        std::vector<Frame> _frames;
+        BasicJsonType _result;
+        bool _started = false;
+        bool _failed = false;
+        size_t _spent = 0;
+        size_t _budget = 0;
+    };
+
+    // Least-recently-used cache of deltas, keyed by content: a structural hash of each
+    // document and a fingerprint of the diff options. With Options::DeltaCache set, Diff and
+    // DiffTo of a pair seen before cost hashing both documents and copying (or writing out)
+    // the cached delta. Hashing is a full traversal of each document, hit or miss; callers
+    // that diff the same documents repeatedly can keep their Hash() and pass it to the Diff
+    // and DiffTo overloads taking hashes, which makes a hit independent of the document size.
+    // Deltas are evicted once their estimated memory exceeds maxBytes; a single delta larger
+    // than that is not kept. Document hashes are 128 bits and trusted, not checked against the
+    // documents. The options fingerprint covers Options::DeltaCacheTag and tells plain function
+    // pointer ObjectHash functions apart by address; engines with any other ObjectHash bypass
+    // the cache unless they set a tag, as the cache cannot see what a lambda captured.
+    // Thread-safe: one cache may serve engines on several threads. The subtree diffs that hinted, tracked, streaming
+    // and text diffs hand to Diff go through the cache too; DiffSession does not use it.
+    template<typename BasicJsonType>
+    class BasicDeltaCache {
+    public:
+        explicit BasicDeltaCache(size_t maxBytes = DEFAULT_DELTA_CACHE_BYTES) : _maxBytes(maxBytes) {}
+
+        BasicDeltaCache(const BasicDeltaCache&) = delete;
+        BasicDeltaCache& operator=(const BasicDeltaCache&) = delete;
+
+        DeltaCacheStats Stats() const;
+        size_t MaxBytes() const { return _maxBytes; }
+        // Drops every delta; the hit, miss and eviction counters keep counting
+        void Clear();
+
+        // Hash of a document's type, contents and (for ordered_json) member order, as used in keys
+        static DocumentHash Hash(const BasicJsonType& document);
+
+    private:
+        friend class BasicJsonDiffPatch<BasicJsonType>;
+
+        struct Key {
+            DocumentHash left;
+            DocumentHash right;
+            uint64_t options;
+
+            bool operator==(const Key& other) const {
+                return left == other.left && right == other.right && options == other.options;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                return static_cast<size_t>(key.left.Low ^ (key.right.Low * 31) ^ (key.options * 131));
+            }
+        };
+
+        struct Entry {
+            Key key;
+            BasicJsonType delta;
+            size_t bytes;
+        };
+
+        static Key MakeKey(const DocumentHash& leftHash, const DocumentHash& rightHash,
+                           const BasicOptions<BasicJsonType>& options);
+        // Calls visit with the cached delta, under the lock, and counts a hit or a miss
+        template<typename Visitor>
+        bool Find(const Key& key, Visitor&& visit);
+        void Insert(const Key& key, const BasicJsonType& delta);
+
+        size_t _maxBytes;
+        mutable std::mutex _mutex;
+        std::list<Entry> _entries;   // most recently used first
+        std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> _index;
+        DeltaCacheStats _stats;
+    };
+
+    // A document whose mutations go through the wrapper, which records the changed paths in a
+    // trie together with the snapshot value of every changed subtree. Diff(document) then
+    // visits only those paths instead of both whole documents, and Commit makes the current
+    // value the new snapshot; both cost in proportion to the changes, not the document.
+    // Paths are JSON pointers. Set replaces a value or adds an object member, Erase removes a
+    // member or an array element, Insert adds an array element (at an index or "-" for the
+    // end) and Edit hands out the value for in-place changes, counting its whole subtree as
+    // changed. Inserting into or erasing from an array counts the whole array as changed;
+    // setting an element does not. Parents must exist; invalid paths throw
+    // std::invalid_argument. The delta equals Diff(Snapshot(), Value()), except that members
+    // of an ordered_json delta may come in a different order.
+    template<typename BasicJsonType>
+    class BasicTrackedDocument {
+    public:
+        using json_pointer = typename BasicJsonType::json_pointer;
+
+        explicit BasicTrackedDocument(BasicJsonType value = BasicJsonType()) : _value(std::move(value)) {}
+
+        const BasicJsonType& Value() const { return _value; }
+
+        // The value as of the last Commit, rebuilt from the current one (a full copy)
+        BasicJsonType Snapshot() const;
+
+        void Set(const json_pointer& path, BasicJsonType value);
+        // Returns false if there was no such member
+        bool Erase(const json_pointer& path);
+        void Insert(const json_pointer& path, BasicJsonType value);
+        // The reference is valid until the next change to the document
+        BasicJsonType& Edit(const json_pointer& path);
+
+        // True if anything changed since the last Commit
+        bool Dirty() const { return _root.captured || !_root.children.empty(); }
+        void Commit() { _root = Node(); }
+
+    private:
+        friend class BasicJsonDiffPatch<BasicJsonType>;
+        using string_t = typename BasicJsonType::string_t;
+
+        // Trie of changed paths. A captured node covers its whole subtree: original holds its
+        // snapshot value (existed is false if it was not in the snapshot) and there are no
+        // children. Other nodes only lead to changes further down.
+        struct Node {
+            bool captured = false;
+            bool existed = true;
+            BasicJsonType original;
+            std::map<string_t, std::unique_ptr<Node>> children;
+        };
+
+        static const BasicJsonType* Child(const BasicJsonType& value, const string_t& token);
+        BasicJsonType& Parent(const std::vector<string_t>& tokens);
+        void Capture(const std::vector<string_t>& tokens, size_t count);
+        static void Restore(BasicJsonType& value, const Node& node);
+        static BasicJsonType DiffNode(BasicJsonDiffPatch<BasicJsonType>& engine, const Node& node,
+                                      const BasicJsonType* current);
+
+        BasicJsonType _value;
+        Node _root;
+    };
+
+    using Options = BasicOptions<json>;
+    using LcsResult = BasicLcsResult<json>;
+    using ItemMatch = BasicItemMatch<json>;
+    using BinaryDelta = BasicBinaryDelta<json>;
+    using DeltaView = BasicDeltaView<json>;
+    using DiffSession = BasicDiffSession<json>;
+    using TrackedDocument = BasicTrackedDocument<json>;
+    using DeltaCache = BasicDeltaCache<json>;
+    using JsonDiffPatch = BasicJsonDiffPatch<json>;
+    using OrderedJsonDiffPatch = BasicJsonDiffPatch<nlohmann::ordered_json>;
+
+    // Instantiated in the library
+    extern template class BasicItemMatch<nlohmann::json>;
+    extern template class BasicItemMatch<nlohmann::ordered_json>;
+    extern template class BasicBinaryDelta<nlohmann::json>;
+    extern template class BasicBinaryDelta<nlohmann::ordered_json>;
+    extern template class BasicDeltaView<nlohmann::json>;
+    extern template class BasicDeltaView<nlohmann::ordered_json>;
+    extern template class BasicJsonDiffPatch<nlohmann::json>;
+    extern template class BasicJsonDiffPatch<nlohmann::ordered_json>;
+    extern template class BasicDiffSession<nlohmann::json>;
+    extern template class BasicDiffSession<nlohmann::ordered_json>;
+    extern template class BasicTrackedDocument<nlohmann::json>;
+    extern template class BasicTrackedDocument<nlohmann::ordered_json>;
+    extern template class BasicDeltaCache<nlohmann::json>;
+    extern template class BasicDeltaCache<nlohmann::ordered_json>;
+
+    // NDJSON pipeline configuration
+    struct PipelineOptions {
+        size_t Lanes = 0;             // parse/diff/dump lanes, 0 = derived from the core count
+        size_t QueueCapacity = 256;   // records buffered between two stages
+        bool Unpatch = false;         // apply {doc, delta} records in reverse
+    };
+
+    // Processes a stream of newline-delimited records. {"left": ..., "right": ...} records
+    // produce their delta (null when equal), {"doc": ..., "delta": ...} records the patched
+    // document. Parsing, diff/patch and serialization run as separate pipelined stages over
+    // lock-free queues in several lanes; output lines keep the input order. A record that
+    // fails produces {"error": "..."} instead. Blank lines are skipped. Returns the number
+    // of records processed.
+    size_t RunNdjsonPipeline(std::istream& in, std::ostream& out,
+                             const Options& options = Options(),
+                             const PipelineOptions& pipelineOptions = PipelineOptions());
+
+    // Server side of snapshot-based state sync (Quake-style netcode). Keeps a ring of the most
+    // recent snapshots and the snapshot each client acknowledged last, its baseline, and hands
+    // every client the delta from its baseline to the latest snapshot. A delta is computed once
+    // per baseline and tick and shared by all clients on that baseline, so a tick costs one
+    // diff per distinct baseline instead of one per client. Baseline 0 stands for the empty
+    // (null) document: clients that acknowledged nothing yet, or whose baseline has left the
+    // ring, get the whole state. Not thread-safe.
+    class SnapshotSync {
+    public:
+        using ClientId = uint64_t;
+
+        explicit SnapshotSync(size_t capacity = 32, const Options& options = Options());
+
+        // Stores the state of a new tick and returns its sequence number (1, 2, ...)
+        uint64_t Push(json state);
+        uint64_t Latest() const { return _latest; }
+        // The snapshot with that sequence number, or nullptr if it is not in the ring
+        const json* Find(uint64_t sequence) const;
+
+        // Records that client received snapshot sequence. Returns false, keeping the previous
+        // baseline, if it is not newer than that baseline or not in the ring.
+        bool Ack(ClientId client, uint64_t sequence);
+        void RemoveClient(ClientId client) { _baselines.erase(client); }
+        // The snapshot the client's next delta starts from (0: the empty document)
+        uint64_t Baseline(ClientId client) const;
+
+        // Delta from the client's baseline to the latest snapshot, as json (null when equal) or
+        // as JSON text (empty when equal). Shared with the clients on the same baseline and
+        // valid until the next Push.
+        const json& DeltaFor(ClientId client);
+        const std::string& DeltaTextFor(ClientId client);
+
+        // Diffs computed so far, for checking how much work is shared
+        size_t DiffCount() const { return _diffCount; }
+        JsonDiffPatch& Engine() { return _engine; }
+
+    private:
+        struct CachedDelta {
+            bool hasDelta = false;
+            json delta;
+            bool hasText = false;
+            std::string text;
+        };
+
+        const json& Value(uint64_t sequence) const;
+
+        size_t _capacity;
+        JsonDiffPatch _engine;
+        std::deque<std::pair<uint64_t, json>> _snapshots;     // oldest first
+        uint64_t _latest = 0;
+        std::unordered_map<ClientId, uint64_t> _baselines;
+        std::unordered_map<uint64_t, CachedDelta> _deltas;    // to the latest snapshot, by baseline
+        size_t _diffCount = 0;
+    };
+
 } // namespace JsonDiffPatch
 
-// C API for GameMaker Studio 2
-#ifdef _WIN32
-    #ifdef JSONDIFFPATCH_EXPORTS
-        #define JSONDIFFPATCH_API __declspec(dllexport)
-    #else
-        #define JSONDIFFPATCH_API
-    #endif
-#else
-    #define JSONDIFFPATCH_API
-#endif
-
-extern "C" {
-    JSONDIFFPATCH_API const char* JDP_Diff(const char* json_left, const char* json_right);
-    JSONDIFFPATCH_API const char* JDP_Patch(const char* json_left, const char* patch_json);
-    JSONDIFFPATCH_API const char* JDP_Unpatch(const char* json_right, const char* patch_json);
-    JSONDIFFPATCH_API void JDP_FreeString(const char* s);
-}
+// C API for GameMaker Studio 2 and other FFI callers
+#include "JsonDiffPatchC.h"
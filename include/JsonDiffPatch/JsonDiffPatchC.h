@@ -0,0 +1,186 @@
+#pragma once
+
+// Plain C interface of JsonDiffPatch, usable from C and FFI bindings
+
+#include <stddef.h>
+
+#ifdef _WIN32
+    #ifdef JSONDIFFPATCH_EXPORTS
+        #define JSONDIFFPATCH_API __declspec(dllexport)
+    #else
+        #define JSONDIFFPATCH_API
+    #endif
+#else
+    #define JSONDIFFPATCH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    JSONDIFFPATCH_API const char* JDP_Diff(const char* json_left, const char* json_right);
+    JSONDIFFPATCH_API const char* JDP_Patch(const char* json_left, const char* patch_json);
+    JSONDIFFPATCH_API const char* JDP_Unpatch(const char* json_right, const char* patch_json);
+    JSONDIFFPATCH_API void JDP_FreeString(const char* s);
+
+    // Handle-based API: each handle owns its own engine, options and result buffer.
+    // options_json may be NULL/"" for defaults, otherwise an object with any of
+    //   "arrayDiff": "simple" | "efficient", "textDiff": "simple" | "efficient",
+    //   "minEfficientTextDiffLength": <n>, "detectMove": <bool>,
+    //   "includeValueOnMove": <bool>, "objectHash": "<key>" | ["<key>", ...],
+    //   "scratchArena": <bool> (per-call arena for transient memory)
+    // JDP_Create returns NULL if the options cannot be parsed.
+    // Strings returned by the *H functions stay valid until the next call on the same
+    // handle. A handle must not be used from several threads at the same time.
+    typedef struct JDP_Instance* JDP_Handle;
+
+    JSONDIFFPATCH_API JDP_Handle JDP_Create(const char* options_json);
+    JSONDIFFPATCH_API void JDP_Destroy(JDP_Handle handle);
+    JSONDIFFPATCH_API const char* JDP_DiffH(JDP_Handle handle, const char* json_left, const char* json_right);
+    JSONDIFFPATCH_API const char* JDP_PatchH(JDP_Handle handle, const char* json_left, const char* patch_json);
+    JSONDIFFPATCH_API const char* JDP_UnpatchH(JDP_Handle handle, const char* json_right, const char* patch_json);
+
+    // Length-delimited API: inputs are (pointer, length) spans that need no terminator and
+    // the result is serialized straight into the caller's buffer. *needed receives the
+    // result length without the terminating NUL, so out must hold at least *needed + 1 bytes.
+    // If it is too small, JDP_ERROR_BUFFER_TOO_SMALL is returned and the call can be repeated
+    // with a larger buffer. An empty result means "no difference" / null.
+    #define JDP_OK 0
+    #define JDP_ERROR -1
+    #define JDP_ERROR_BUFFER_TOO_SMALL -2
+
+    JSONDIFFPATCH_API int JDP_DiffN(const char* json_left, size_t left_len,
+                                    const char* json_right, size_t right_len,
+                                    char* out, size_t cap, size_t* needed);
+    JSONDIFFPATCH_API int JDP_PatchN(const char* json_left, size_t left_len,
+                                     const char* patch_json, size_t patch_len,
+                                     char* out, size_t cap, size_t* needed);
+    JSONDIFFPATCH_API int JDP_UnpatchN(const char* json_right, size_t right_len,
+                                       const char* patch_json, size_t patch_len,
+                                       char* out, size_t cap, size_t* needed);
+
+    // Batched API: processes count input pairs in one call. Item i's result is written
+    // NUL-terminated into arena at offsets[i] with length lengths[i]; *needed receives the
+    // total arena size required. statuses (optional) receives JDP_OK or JDP_ERROR per item.
+    // handle may be NULL for default options. If parallel is non-zero the items are spread
+    // over the library's internal worker pool. If the arena is too small the call returns
+    // JDP_ERROR_BUFFER_TOO_SMALL with *needed set, and the handle (or, for NULL, the calling
+    // thread) keeps the computed results: JDP_TakeBatchResults copies them into a larger
+    // arena without redoing the work. They are kept until they are taken or the next batch
+    // call on the same handle; JDP_TakeBatchResults returns JDP_ERROR if there are none.
+    typedef struct JDP_Span {
+        const char* data;
+        size_t size;
+    } JDP_Span;
+
+    JSONDIFFPATCH_API int JDP_DiffBatch(JDP_Handle handle, const JDP_Span* lefts, const JDP_Span* rights,
+                                        size_t count, char* arena, size_t arena_cap,
+                                        size_t* offsets, size_t* lengths, int* statuses,
+                                        size_t* needed, int parallel);
+    JSONDIFFPATCH_API int JDP_PatchBatch(JDP_Handle handle, const JDP_Span* lefts, const JDP_Span* patches,
+                                         size_t count, char* arena, size_t arena_cap,
+                                         size_t* offsets, size_t* lengths, int* statuses,
+                                         size_t* needed, int parallel);
+    JSONDIFFPATCH_API int JDP_UnpatchBatch(JDP_Handle handle, const JDP_Span* rights, const JDP_Span* patches,
+                                           size_t count, char* arena, size_t arena_cap,
+                                           size_t* offsets, size_t* lengths, int* statuses,
+                                           size_t* needed, int parallel);
+    JSONDIFFPATCH_API int JDP_TakeBatchResults(JDP_Handle handle, char* arena, size_t arena_cap,
+                                               size_t* offsets, size_t* lengths, int* statuses,
+                                               size_t* needed);
+
+    // Asynchronous API: work runs on a bounded pool of library threads. The inputs are
+    // copied, so the caller's buffers may be reused right away. The *Async functions
+    // return 0 if the request could not be queued (pool saturated). JDP_Poll returns
+    // JDP_PENDING while the work runs, then JDP_OK or JDP_ERROR; JDP_Wait blocks for up
+    // to timeout_ms (negative waits forever) and returns the same codes. JDP_TakeResult
+    // copies the result like JDP_DiffN and releases the ticket once it succeeded.
+    #define JDP_PENDING 1
+    #define JDP_ERROR_UNKNOWN_TICKET -3
+
+    typedef long long JDP_Ticket;
+
+    JSONDIFFPATCH_API JDP_Ticket JDP_DiffAsync(JDP_Handle handle, const char* json_left, size_t left_len,
+                                               const char* json_right, size_t right_len);
+    JSONDIFFPATCH_API JDP_Ticket JDP_PatchAsync(JDP_Handle handle, const char* json_left, size_t left_len,
+                                                const char* patch_json, size_t patch_len);
+    JSONDIFFPATCH_API JDP_Ticket JDP_UnpatchAsync(JDP_Handle handle, const char* json_right, size_t right_len,
+                                                  const char* patch_json, size_t patch_len);
+    JSONDIFFPATCH_API int JDP_Poll(JDP_Ticket ticket);
+    JSONDIFFPATCH_API int JDP_Wait(JDP_Ticket ticket, int timeout_ms);
+    JSONDIFFPATCH_API int JDP_TakeResult(JDP_Ticket ticket, char* out, size_t cap, size_t* needed);
+
+    // Parsed documents: text is parsed once into a handle that can be diffed and patched
+    // any number of times. Results are returned as new document handles and are only
+    // serialized when JDP_DocumentText/JDP_SerializeDocument is called. Loading NULL or ""
+    // gives a null document (an empty delta). Documents are immutable, so they may be
+    // shared between threads, except that JDP_DocumentText caches the text on first use.
+    // Every returned document must be released with JDP_ReleaseDocument.
+    typedef struct JDP_Document* JDP_Doc;
+
+    JSONDIFFPATCH_API JDP_Doc JDP_LoadDocument(const char* json_text);
+    JSONDIFFPATCH_API JDP_Doc JDP_LoadDocumentN(const char* json_text, size_t len);
+    JSONDIFFPATCH_API void JDP_ReleaseDocument(JDP_Doc doc);
+    JSONDIFFPATCH_API JDP_Doc JDP_DiffDocs(JDP_Handle handle, JDP_Doc left, JDP_Doc right);
+    JSONDIFFPATCH_API JDP_Doc JDP_PatchDoc(JDP_Handle handle, JDP_Doc left, JDP_Doc delta);
+    JSONDIFFPATCH_API JDP_Doc JDP_UnpatchDoc(JDP_Handle handle, JDP_Doc right, JDP_Doc delta);
+    JSONDIFFPATCH_API const char* JDP_DocumentText(JDP_Doc doc);
+    JSONDIFFPATCH_API int JDP_SerializeDocument(JDP_Doc doc, char* out, size_t cap, size_t* needed);
+
+    // Binary deltas (see JsonDiffPatch::BinaryDelta): JDP_DiffBinary writes a CBOR or
+    // MessagePack encoded delta into out (no terminator; *needed = 0 means no difference).
+    // JDP_PatchBinary/JDP_UnpatchBinary accept such a delta and return JSON text like JDP_PatchN.
+    #define JDP_BINARY_CBOR 1
+    #define JDP_BINARY_MSGPACK 2
+
+    JSONDIFFPATCH_API int JDP_DiffBinary(JDP_Handle handle, const char* json_left, size_t left_len,
+                                         const char* json_right, size_t right_len, int format,
+                                         unsigned char* out, size_t cap, size_t* needed);
+    JSONDIFFPATCH_API int JDP_PatchBinary(JDP_Handle handle, const char* json_left, size_t left_len,
+                                          const unsigned char* delta, size_t delta_len,
+                                          char* out, size_t cap, size_t* needed);
+    JSONDIFFPATCH_API int JDP_UnpatchBinary(JDP_Handle handle, const char* json_right, size_t right_len,
+                                            const unsigned char* delta, size_t delta_len,
+                                            char* out, size_t cap, size_t* needed);
+
+    // Resumable diff for callers with a frame budget (see JsonDiffPatch::DiffSession).
+    // JDP_BeginDiff parses both texts with the handle's options (NULL: defaults) and returns
+    // a session, or NULL if they cannot be parsed. Every JDP_DiffStep then does about budget
+    // units of work and returns JDP_PENDING until the delta is complete, then JDP_OK
+    // (JDP_ERROR once a step failed). JDP_FinishDiff does whatever work is left and copies
+    // the delta like JDP_DiffN; it can be repeated with a larger buffer. The session keeps
+    // copies of the inputs, does not use the handle after JDP_BeginDiff and records no
+    // statistics. Release it with JDP_EndDiff.
+    typedef struct JDP_DiffSession* JDP_Session;
+
+    JSONDIFFPATCH_API JDP_Session JDP_BeginDiff(JDP_Handle handle, const char* json_left, size_t left_len,
+                                                const char* json_right, size_t right_len);
+    JSONDIFFPATCH_API int JDP_DiffStep(JDP_Session session, size_t budget);
+    JSONDIFFPATCH_API int JDP_FinishDiff(JDP_Session session, char* out, size_t cap, size_t* needed);
+    JSONDIFFPATCH_API void JDP_EndDiff(JDP_Session session);
+
+    // Statistics of the last call made with a handle (NULL: the calling thread's default
+    // instance, used by the functions without a handle). Work counters and per-phase times
+    // in nanoseconds, see JsonDiffPatch::DiffStats. A parallel batch counts the items of all
+    // its threads, its times adding up thread time; asynchronous calls record nothing. All
+    // zero when the library is built with JSONDIFFPATCH_DISABLE_STATS.
+    typedef struct JDP_Stats {
+        unsigned long long nodes_visited;
+        unsigned long long lcs_arrays;
+        unsigned long long lcs_cells;
+        unsigned long long hash_calls;
+        unsigned long long text_diffs;
+        unsigned long long values_copied;
+        unsigned long long scratch_growths;
+        unsigned long long parse_ns;
+        unsigned long long diff_ns;
+        unsigned long long text_diff_ns;
+        unsigned long long patch_ns;
+        unsigned long long serialize_ns;
+    } JDP_Stats;
+
+    JSONDIFFPATCH_API int JDP_GetLastStats(JDP_Handle handle, JDP_Stats* out);
+
+#ifdef __cplusplus
+}
+#endif
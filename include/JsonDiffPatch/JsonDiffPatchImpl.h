@@ -0,0 +1,1369 @@
+#pragma once
+
+// Template definitions of the diff/patch engine. The library instantiates them for
+// nlohmann::json and nlohmann::ordered_json; include this header to use the engine with
+// another nlohmann::basic_json specialization.
+
+#include "JsonDiffPatch.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace JsonDiffPatch {
+
+namespace detail {
+
+    template<typename T>
+    struct IsStdMap : std::false_type {};
+
+    template<typename Key, typename Value, typename Compare, typename Allocator>
+    struct IsStdMap<std::map<Key, Value, Compare, Allocator>> : std::true_type {};
+
+    // True when object members iterate in key order (nlohmann::json), false when they keep
+    // insertion order (nlohmann::ordered_json)
+    template<typename BasicJsonType>
+    constexpr bool IsSortedObject = IsStdMap<typename BasicJsonType::object_t>::value;
+
+    template<typename StringType>
+    std::string ToStdString(const StringType& str) {
+        return std::string(str.data(), str.size());
+    }
+
+    inline const std::string& ToStdString(const std::string& str) {
+        return str;
+    }
+
+    inline std::string ToStdString(std::string&& str) {
+        return std::move(str);
+    }
+
+    // The text engine works on std::string whatever the string type of the document
+    template<typename BasicJsonType>
+    decltype(auto) StringValue(const BasicJsonType& value) {
+        return ToStdString(value.template get_ref<const typename BasicJsonType::string_t&>());
+    }
+
+    // Delta key of an array entry: "3", or "_3" for a removed element
+    template<typename BasicJsonType>
+    typename BasicJsonType::string_t IndexKey(size_t index, bool removed = false) {
+        char key[24];
+        char* p = key;
+        if (removed) {
+            *p++ = '_';
+        }
+        p = std::to_chars(p, key + sizeof(key), index).ptr;
+        return typename BasicJsonType::string_t(key, static_cast<size_t>(p - key));
+    }
+
+    // Array index of a delta key, skipping offset leading characters ("_3" -> 3)
+    template<typename StringType>
+    size_t ParseIndex(const StringType& key, size_t offset) {
+        size_t index = 0;
+        const char* begin = key.data() + (std::min)(offset, key.size());
+        auto parsed = std::from_chars(begin, key.data() + key.size(), index);
+        if (parsed.ec != std::errc() || parsed.ptr == begin) {
+            throw std::invalid_argument("Invalid array delta key");
+        }
+        return index;
+    }
+
+    // Reference tokens of a JSON pointer, root first
+    template<typename BasicJsonType>
+    std::vector<typename BasicJsonType::string_t> PointerTokens(typename BasicJsonType::json_pointer pointer) {
+        std::vector<typename BasicJsonType::string_t> tokens;
+        while (!pointer.empty()) {
+            tokens.push_back(pointer.back());
+            pointer.pop_back();
+        }
+        std::reverse(tokens.begin(), tokens.end());
+        return tokens;
+    }
+
+    // Array index token of a JSON pointer: decimal, without leading zeros
+    template<typename StringType>
+    bool PointerIndex(const StringType& token, size_t& index) {
+        if (token.empty() || (token.size() > 1 && token[0] == '0')) {
+            return false;
+        }
+        auto parsed = std::from_chars(token.data(), token.data() + token.size(), index);
+        return parsed.ec == std::errc() && parsed.ptr == token.data() + token.size();
+    }
+
+    // Set of JSON pointers as a trie; a whole node covers its subtree and has no children
+    template<typename StringType>
+    struct PathTrie {
+        bool whole = false;
+        std::map<StringType, std::unique_ptr<PathTrie>> children;
+
+        void Insert(const std::vector<StringType>& tokens) {
+            PathTrie* node = this;
+            for (const auto& token : tokens) {
+                if (node->whole) {
+                    return;
+                }
+                auto& child = node->children[token];
+                if (!child) {
+                    child = std::make_unique<PathTrie>();
+                }
+                node = child.get();
+            }
+            node->whole = true;
+            node->children.clear();
+        }
+    };
+
+    // Scratch arena of the outermost engine call running on this thread
+    inline thread_local std::pmr::memory_resource* t_scratchArena = nullptr;
+
+    const size_t SCRATCH_ARENA_INITIAL_SIZE = 4096;
+
+    // Opened by every engine entry point. The outermost call whose options name a
+    // ScratchResource creates the arena; nested calls share it.
+    class ScratchScope {
+    public:
+        explicit ScratchScope(std::pmr::memory_resource* upstream) {
+            if (upstream && !t_scratchArena) {
+                _arena.emplace(SCRATCH_ARENA_INITIAL_SIZE, upstream);
+                t_scratchArena = &*_arena;
+            }
+        }
+
+        ~ScratchScope() {
+            if (_arena) {
+                t_scratchArena = nullptr;
+            }
+        }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+    private:
+        std::optional<std::pmr::monotonic_buffer_resource> _arena;
+    };
+
+    // Resource for transient containers: the current arena, else the default resource
+    inline std::pmr::memory_resource* Scratch() {
+        return t_scratchArena ? t_scratchArena : std::pmr::get_default_resource();
+    }
+
+    // DiffStats sink of the outermost engine call running on this thread
+    inline thread_local DiffStats* t_stats = nullptr;
+
+    // Opened by every engine entry point (and by callers timing their own parse/serialize
+    // work). The outermost scope for a sink attaches it to the thread and adds the elapsed
+    // time to the given phase, if any; nested scopes of the same sink do nothing.
+    class StatsScope {
+    public:
+#ifdef JSONDIFFPATCH_DISABLE_STATS
+        StatsScope(DiffStats*, uint64_t DiffStats::*) {}
+#else
+        StatsScope(DiffStats* stats, uint64_t DiffStats::* phase) {
+            if (stats && t_stats != stats) {
+                _previous = t_stats;
+                _stats = stats;
+                _phase = phase;
+                _start = std::chrono::steady_clock::now();
+                t_stats = stats;
+            }
+        }
+
+        ~StatsScope() {
+            if (_stats) {
+                if (_phase) {
+                    _stats->*_phase += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - _start).count());
+                }
+                t_stats = _previous;
+            }
+        }
+
+    private:
+        DiffStats* _stats = nullptr;
+        DiffStats* _previous = nullptr;
+        uint64_t DiffStats::* _phase = nullptr;
+        std::chrono::steady_clock::time_point _start;
+#endif
+
+    public:
+        StatsScope(const StatsScope&) = delete;
+        StatsScope& operator=(const StatsScope&) = delete;
+    };
+
+#ifdef JSONDIFFPATCH_DISABLE_STATS
+    #define JSONDIFFPATCH_STATS_ADD(counter, amount) ((void)0)
+#else
+    #define JSONDIFFPATCH_STATS_ADD(counter, amount) \
+        do { if (::JsonDiffPatch::detail::t_stats) ::JsonDiffPatch::detail::t_stats->counter += (amount); } while (0)
+#endif
+
+    // Adds the time until it is destroyed to a phase of the thread's current sink; unlike
+    // StatsScope it also measures nested work (the text diffs inside a diff)
+    class StatsTimer {
+    public:
+#ifdef JSONDIFFPATCH_DISABLE_STATS
+        explicit StatsTimer(uint64_t DiffStats::*) {}
+#else
+        explicit StatsTimer(uint64_t DiffStats::* phase) : _phase(phase) {
+            if (t_stats) {
+                _start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~StatsTimer() {
+            if (t_stats) {
+                t_stats->*_phase += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start).count());
+            }
+        }
+
+    private:
+        uint64_t DiffStats::* _phase;
+        std::chrono::steady_clock::time_point _start;
+#endif
+
+    public:
+        StatsTimer(const StatsTimer&) = delete;
+        StatsTimer& operator=(const StatsTimer&) = delete;
+    };
+
+    // Reports one object/array step to the tracer, if any, when it is entered and left
+    class TraceScope {
+    public:
+        TraceScope(DiffTracer* tracer, int operation, const std::string& path, size_t leftCount, size_t rightCount)
+            : _tracer(tracer), _operation(operation), _path(path), _leftCount(leftCount), _rightCount(rightCount) {
+            if (_tracer) {
+                _tracer->Enter(_operation, _path, _leftCount, _rightCount);
+                _start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~TraceScope() {
+            if (_tracer) {
+                _tracer->Exit(_operation, _path, _leftCount, _rightCount,
+                              static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - _start).count()));
+            }
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        DiffTracer* _tracer;
+        int _operation;
+        const std::string& _path;
+        size_t _leftCount;
+        size_t _rightCount;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    // Appends a member name or an index to the traced JSON pointer for the lifetime of the
+    // scope; does nothing without a tracer
+    class TracePath {
+    public:
+        template<typename Key>
+        TracePath(DiffTracer* tracer, std::string& path, const Key& key) {
+            if (tracer) {
+                Open(path);
+                for (char c : key) {
+                    if (c == '~') path += "~0";
+                    else if (c == '/') path += "~1";
+                    else path += c;
+                }
+            }
+        }
+
+        TracePath(DiffTracer* tracer, std::string& path, size_t index) {
+            if (tracer) {
+                Open(path);
+                path += std::to_string(index);
+            }
+        }
+
+        ~TracePath() {
+            if (_path) _path->resize(_size);
+        }
+
+        TracePath(const TracePath&) = delete;
+        TracePath& operator=(const TracePath&) = delete;
+
+    private:
+        void Open(std::string& path) {
+            _path = &path;
+            _size = path.size();
+            path += '/';
+        }
+
+        std::string* _path = nullptr;
+        size_t _size = 0;
+    };
+
+    // Text diff of two strings as patch text, empty if there is none
+    inline std::string TextDiffPatches(const std::string& left, const std::string& right) {
+        StatsTimer timer(&DiffStats::TextDiffNs);
+        JSONDIFFPATCH_STATS_ADD(TextDiffs, 1);
+        auto patches = SimpleTextDiff::CreatePatches(left, right);
+        return patches.empty() ? std::string() : SimpleTextDiff::PatchesToText(patches);
+    }
+
+    // Applies a text diff ([patchText, 0, 2]) to a string value, or reverts it
+    template<typename BasicJsonType>
+    BasicJsonType ApplyTextDiff(const std::string& patchText, const BasicJsonType& value, bool reverse) {
+        if (!value.is_string()) {
+            throw std::runtime_error("Invalid patch object");
+        }
+        
+        JSONDIFFPATCH_STATS_ADD(TextDiffs, 1);
+        auto patches = SimpleTextDiff::PatchesFromText(patchText);
+        
+        if (reverse) {
+            for (auto& patch : patches) {
+                for (auto& diff : patch.diffs) {
+                    if (diff.operation == DIFF_DELETE) {
+                        diff.operation = DIFF_INSERT;
+                    } else if (diff.operation == DIFF_INSERT) {
+                        diff.operation = DIFF_DELETE;
+                    }
+                }
+            }
+        } else if (patches.empty()) {
+            throw std::runtime_error("Invalid textline");
+        }
+        
+        auto result = SimpleTextDiff::ApplyPatches(patches, StringValue(value));
+        
+        for (size_t i = 0; i < result.second.size(); ++i) {
+            bool success = result.second[i];
+            if (!success) {
+                throw std::runtime_error("Text patch failed");
+            }
+        }
+        
+        return BasicJsonType(result.first);
+    }
+
+} // namespace detail
+
+// ItemMatch implementation
+template<typename BasicJsonType>
+bool BasicItemMatch<BasicJsonType>::Match(const BasicJsonType& obj1, const BasicJsonType& obj2) const {
+    if (ObjectHash && obj1.is_object()) {
+        JSONDIFFPATCH_STATS_ADD(HashCalls, 2);
+        std::string hash1 = ObjectHash(obj1);
+        std::string hash2 = ObjectHash(obj2);
+        return !hash1.empty() && !hash2.empty() && hash1 == hash2;
+    }
+    return obj1 == obj2;
+}
+
+template<typename BasicJsonType>
+bool BasicItemMatch<BasicJsonType>::MatchArrayElement(const BasicJsonType& obj1, int index1, const BasicJsonType& obj2, int index2) const {
+    if (ObjectHash) {
+        return Match(obj1, obj2);
+    }
+    
+    if (!obj1.is_object() && !obj1.is_array()) {
+        return obj1 == obj2;
+    }
+    
+    return index1 == index2;
+}
+
+
+// LCS implementation
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::ComputeLcs(
+    const BasicJsonType* left, size_t leftSize, const BasicJsonType* right, size_t rightSize, LcsResult& result) {
+    BeginLcs(leftSize, rightSize);
+    FillLcs(left, right, rightSize, 0, leftSize * rightSize);
+    BacktrackLcs(left, leftSize, right, rightSize, result);
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::BeginLcs(size_t leftSize, size_t rightSize) {
+    size_t m = leftSize;
+    size_t n = rightSize;
+    size_t width = n + 1;
+    
+    // LCS matrix, (m + 1) rows of width cells in the reused table. Every cell is written
+    // before it is read except row and column 0; row 0 is cleared here, column 0 by FillLcs.
+    std::vector<int>& matrix = _scratch.lcsMatrix;
+    if (matrix.size() < (m + 1) * width) {
+        JSONDIFFPATCH_STATS_ADD(ScratchGrowths, 1);
+        matrix.resize((m + 1) * width);
+    }
+    JSONDIFFPATCH_STATS_ADD(LcsArrays, 1);
+    JSONDIFFPATCH_STATS_ADD(LcsCells, m * n);
+    std::fill(matrix.begin(), matrix.begin() + width, 0);
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::FillLcs(
+    const BasicJsonType* left, const BasicJsonType* right, size_t rightSize, size_t firstCell, size_t lastCell) {
+    size_t n = rightSize;
+    size_t width = n + 1;
+    std::vector<int>& matrix = _scratch.lcsMatrix;
+    
+    // One row (or the part of it in range) at a time
+    size_t cell = firstCell;
+    while (cell < lastCell) {
+        size_t i = cell / n + 1;
+        size_t j = cell % n + 1;
+        size_t rowEnd = (std::min)(n, j + (lastCell - cell) - 1);
+        if (j == 1) {
+            matrix[i * width] = 0;
+        }
+        for (; j <= rowEnd; ++j) {
+            if (_itemMatch.MatchArrayElement(left[i-1], static_cast<int>(i-1), right[j-1], static_cast<int>(j-1))) {
+                matrix[i * width + j] = matrix[(i-1) * width + j-1] + 1;
+            } else {
+                matrix[i * width + j] = (std::max)(matrix[(i-1) * width + j], matrix[i * width + j-1]);
+            }
+        }
+        cell = (i - 1) * n + rowEnd;
+    }
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::BacktrackLcs(
+    const BasicJsonType* left, size_t leftSize, const BasicJsonType* right, size_t rightSize, LcsResult& result) {
+    size_t width = rightSize + 1;
+    const std::vector<int>& matrix = _scratch.lcsMatrix;
+    
+    // Backtrack to find the LCS
+    result.LeftMatch.assign(leftSize, -1);
+    result.RightMatch.assign(rightSize, -1);
+    size_t i = leftSize, j = rightSize;
+    
+    while (i > 0 && j > 0) {
+        if (_itemMatch.Match(left[i-1], right[j-1])) {
+            result.LeftMatch[i-1] = static_cast<int>(j-1);
+            result.RightMatch[j-1] = static_cast<int>(i-1);
+            --i;
+            --j;
+        } else if (matrix[i * width + j-1] > matrix[(i-1) * width + j]) {
+            --j;
+        } else {
+            --i;
+        }
+    }
+}
+
+// JsonDiffPatch main implementation
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Diff(const BasicJsonType& left, const BasicJsonType& right) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    if (!_caching && UsesDeltaCache()) {
+        return CachedDiff(left, right, BasicDeltaCache<BasicJsonType>::Hash(left),
+                          BasicDeltaCache<BasicJsonType>::Hash(right));
+    }
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    
+    static const BasicJsonType emptyString("");
+    const BasicJsonType& leftValue = left.is_null() ? emptyString : left;
+    const BasicJsonType& rightValue = right.is_null() ? emptyString : right;
+    
+    if (leftValue.is_object() && rightValue.is_object()) {
+        return ObjectDiff(leftValue, rightValue);
+    }
+    
+    if (_options.ArrayDiff == MODE_EFFICIENT && 
+        leftValue.is_array() && rightValue.is_array()) {
+        return ArrayDiff(leftValue, rightValue);
+    }
+    
+    if (_options.TextDiff == TEXTDIFF_EFFICIENT &&
+        leftValue.is_string() && rightValue.is_string()) {
+        const auto& leftStr = detail::StringValue(leftValue);
+        const auto& rightStr = detail::StringValue(rightValue);
+        
+        if (leftStr == rightStr) {
+            return BasicJsonType(nullptr);
+        }
+        
+        if (leftStr.length() > _options.MinEfficientTextDiffLength || 
+            rightStr.length() > _options.MinEfficientTextDiffLength) {
+            std::string patches = detail::TextDiffPatches(leftStr, rightStr);
+            if (!patches.empty()) {
+                return BasicJsonType::array({ std::move(patches), 0, OP_TEXTDIFF });
+            }
+        }
+    }
+    
+    if (!_itemMatch.Match(leftValue, rightValue)) {
+        JSONDIFFPATCH_STATS_ADD(ValuesCopied, 2);
+        return BasicJsonType::array({ leftValue, rightValue });
+    }
+    
+    return BasicJsonType(nullptr);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ObjectDiff(const BasicJsonType& left, const BasicJsonType& right) {
+    detail::TraceScope trace(_options.Tracer, TRACE_OBJECT_DIFF, _tracePath, left.size(), right.size());
+    // Stays null (no allocation) until the first changed member
+    BasicJsonType diffPatch;
+    
+    // Find properties modified or deleted
+    for (auto it = left.begin(); it != left.end(); ++it) {
+        const auto& key = it.key();
+        const BasicJsonType& leftValue = it.value();
+        
+        auto match = right.find(key);
+        if (match != right.end()) {
+            detail::TracePath segment(_options.Tracer, _tracePath, key);
+            BasicJsonType d = Diff(leftValue, *match);
+            if (!d.is_null()) {
+                diffPatch[key] = std::move(d);
+            }
+        } else {
+            // Property deleted
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType deleteArray = BasicJsonType::array({ leftValue, 0, OP_DELETED });
+            diffPatch[key] = std::move(deleteArray);
+        }
+    }
+    
+    // Find properties that were added
+    for (auto it = right.begin(); it != right.end(); ++it) {
+        const auto& key = it.key();
+        const BasicJsonType& rightValue = it.value();
+        
+        if (!left.contains(key)) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType addArray = BasicJsonType::array({ rightValue });
+            diffPatch[key] = std::move(addArray);
+        }
+    }
+    
+    return diffPatch;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ArrayDiff(const BasicJsonType& left, const BasicJsonType& right) {
+    detail::TraceScope trace(_options.Tracer, TRACE_ARRAY_DIFF, _tracePath, left.size(), right.size());
+    if (left == right) {
+        return BasicJsonType(nullptr);
+    }
+    
+    const ItemMatch& itemMatch = _itemMatch;
+    BasicJsonType result = BasicJsonType::object();
+    result["_t"] = "a";
+    
+    const auto& leftVec = left.template get_ref<const typename BasicJsonType::array_t&>();
+    const auto& rightVec = right.template get_ref<const typename BasicJsonType::array_t&>();
+    
+    // Handle case where arrays have same length - check for simple replacements first
+    if (leftVec.size() == rightVec.size()) {
+        bool hasChanges = false;
+        
+        for (size_t i = 0; i < leftVec.size(); ++i) {
+            if (!itemMatch.Match(leftVec[i], rightVec[i])) {
+                // Check if this is a simple replacement vs nested change
+                detail::TracePath segment(_options.Tracer, _tracePath, i);
+                BasicJsonType childDiff = Diff(leftVec[i], rightVec[i]);
+                if (!childDiff.is_null()) {
+                    if (childDiff.is_array() && childDiff.size() == 2) {
+                        // Simple replacement: [old_value, new_value]
+                        result[detail::IndexKey<BasicJsonType>(i)] = std::move(childDiff);
+                    } else {
+                        // Nested change (object diff, etc.)
+                        result[detail::IndexKey<BasicJsonType>(i)] = std::move(childDiff);
+                    }
+                    hasChanges = true;
+                }
+            }
+        }
+        
+        if (!hasChanges) {
+            return BasicJsonType(nullptr);
+        }
+        
+        // Check if result is empty (only contains "_t")
+        if (result.size() == 1 && result.contains("_t")) {
+            return BasicJsonType(nullptr);
+        }
+        
+        return result;
+    }
+    
+    // For different length arrays, use the existing LCS-based approach
+    size_t commonHead = 0;
+    size_t commonTail = 0;
+    
+    // Find common head
+    while (commonHead < leftVec.size() && commonHead < rightVec.size() &&
+           itemMatch.MatchArrayElement(leftVec[commonHead], static_cast<int>(commonHead), 
+                                     rightVec[commonHead], static_cast<int>(commonHead))) {
+        detail::TracePath segment(_options.Tracer, _tracePath, commonHead);
+        BasicJsonType child = Diff(leftVec[commonHead], rightVec[commonHead]);
+        if (!child.is_null()) {
+            result[detail::IndexKey<BasicJsonType>(commonHead)] = std::move(child);
+        }
+        commonHead++;
+    }
+    
+    // Find common tail
+    while (commonTail + commonHead < leftVec.size() && 
+           commonTail + commonHead < rightVec.size() &&
+           itemMatch.MatchArrayElement(leftVec[leftVec.size() - 1 - commonTail], 
+                                     static_cast<int>(leftVec.size() - 1 - commonTail),
+                                     rightVec[rightVec.size() - 1 - commonTail], 
+                                     static_cast<int>(rightVec.size() - 1 - commonTail))) {
+        size_t index1 = leftVec.size() - 1 - commonTail;
+        size_t index2 = rightVec.size() - 1 - commonTail;
+        detail::TracePath segment(_options.Tracer, _tracePath, index2);
+        BasicJsonType child = Diff(leftVec[index1], rightVec[index2]);
+        if (!child.is_null()) {
+            result[detail::IndexKey<BasicJsonType>(index2)] = std::move(child);
+        }
+        commonTail++;
+    }
+    
+    // Handle simple cases
+    if (commonHead + commonTail == leftVec.size()) {
+        // Block was added
+        for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType addArray = BasicJsonType::array({ rightVec[index] });
+            result[detail::IndexKey<BasicJsonType>(index)] = std::move(addArray);
+        }
+        return result;
+    }
+    
+    if (commonHead + commonTail == rightVec.size()) {
+        // Block was removed
+        for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType deleteArray = BasicJsonType::array({ leftVec[index], 0, OP_DELETED });
+            result[detail::IndexKey<BasicJsonType>(index, true)] = std::move(deleteArray);
+        }
+        return result;
+    }
+    
+    // Complex diff using LCS
+    typename detail::Workspace<BasicJsonType>::Lease scratch(_scratch);
+    LcsResult& lcs = scratch.frame.lcs;
+    ComputeLcs(leftVec.data() + commonHead, leftVec.size() - commonHead - commonTail,
+               rightVec.data() + commonHead, rightVec.size() - commonHead - commonTail, lcs);
+    
+    // Mark deletions
+    for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+        if (lcs.LeftMatch[index - commonHead] < 0) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType deleteArray = BasicJsonType::array({ leftVec[index], 0, OP_DELETED });
+            result[detail::IndexKey<BasicJsonType>(index, true)] = std::move(deleteArray);
+        }
+    }
+    
+    // Mark additions and modifications
+    for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+        int match = lcs.RightMatch[index - commonHead];
+        
+        if (match < 0) {
+            // Added
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            BasicJsonType addArray = BasicJsonType::array({ rightVec[index] });
+            result[detail::IndexKey<BasicJsonType>(index)] = std::move(addArray);
+        } else {
+            // Potentially modified
+            size_t leftIndex = static_cast<size_t>(match) + commonHead;
+            
+            detail::TracePath segment(_options.Tracer, _tracePath, index);
+            BasicJsonType diff = Diff(leftVec[leftIndex], rightVec[index]);
+            if (!diff.is_null()) {
+                result[detail::IndexKey<BasicJsonType>(index)] = std::move(diff);
+            }
+        }
+    }
+    
+    // Check if result is empty (only contains "_t")
+    if (result.size() == 1 && result.contains("_t")) {
+        return BasicJsonType(nullptr);
+    }
+    
+    return result;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Diff(const BasicJsonType& left, const BasicJsonType& right,
+                                                      const std::vector<typename BasicJsonType::json_pointer>& hints) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    
+    detail::PathTrie<typename BasicJsonType::string_t> trie;
+    for (const auto& hint : hints) {
+        trie.Insert(detail::PointerTokens<BasicJsonType>(hint));
+    }
+    if (!trie.whole && trie.children.empty()) {
+        return BasicJsonType(nullptr);
+    }
+    return HintedDiff(trie, left, right);
+}
+
+// Follows ObjectDiff/ArrayDiff along the hinted paths only
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::HintedDiff(const detail::PathTrie<typename BasicJsonType::string_t>& hints,
+                                                            const BasicJsonType& left, const BasicJsonType& right) {
+    if (hints.whole || left.type() != right.type() || !left.is_structured()) {
+        return Diff(left, right);
+    }
+    
+    BasicJsonType diffPatch;
+    if (left.is_object()) {
+        for (const auto& hint : hints.children) {
+            const auto& key = hint.first;
+            auto leftMember = left.find(key);
+            auto rightMember = right.find(key);
+            if (leftMember != left.end() && rightMember != right.end()) {
+                detail::TracePath segment(_options.Tracer, _tracePath, key);
+                BasicJsonType d = HintedDiff(*hint.second, *leftMember, *rightMember);
+                if (!d.is_null()) {
+                    diffPatch[key] = std::move(d);
+                }
+            } else if (leftMember != left.end()) {
+                JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+                diffPatch[key] = BasicJsonType::array({ *leftMember, 0, OP_DELETED });
+            } else if (rightMember != right.end()) {
+                JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+                diffPatch[key] = BasicJsonType::array({ *rightMember });
+            }
+        }
+        return diffPatch;
+    }
+    
+    if (_options.ArrayDiff != MODE_EFFICIENT || _options.ObjectHash || left.size() != right.size()) {
+        return Diff(left, right);
+    }
+    
+    // Same-length arrays are diffed element by element; indices in ascending order
+    std::vector<std::pair<size_t, const detail::PathTrie<typename BasicJsonType::string_t>*>> elements;
+    for (const auto& hint : hints.children) {
+        size_t index;
+        if (detail::PointerIndex(hint.first, index) && index < left.size()) {
+            elements.emplace_back(index, hint.second.get());
+        }
+    }
+    std::sort(elements.begin(), elements.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& element : elements) {
+        detail::TracePath segment(_options.Tracer, _tracePath, element.first);
+        BasicJsonType d = HintedDiff(*element.second, left[element.first], right[element.first]);
+        if (!d.is_null()) {
+            if (diffPatch.is_null()) {
+                diffPatch["_t"] = "a";
+            }
+            diffPatch[detail::IndexKey<BasicJsonType>(element.first)] = std::move(d);
+        }
+    }
+    return diffPatch;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Patch(const BasicJsonType& left, const BasicJsonType& patch) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::PatchNs);
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    
+    if (patch.is_null()) {
+        JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+        return left;
+    }
+    
+    if (patch.is_object()) {
+        if (left.is_array() && patch.contains("_t") && 
+            patch["_t"].is_string() && patch["_t"] == "a") {
+            return ArrayPatch(left, patch);
+        }
+        return ObjectPatch(left, patch);
+    }
+    
+    if (patch.is_array()) {
+        const BasicJsonType& patchArray = patch;
+        
+        if (patchArray.size() == 1) {
+            // Add
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            return patchArray[0];
+        }
+        
+        if (patchArray.size() == 2) {
+            // Replace
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            return patchArray[1];
+        }
+        
+        if (patchArray.size() == 3) {
+            // Delete, Move or TextDiff
+            if (!patchArray[2].is_number_integer()) {
+                throw std::runtime_error("Invalid patch object");
+            }
+            
+            int op = patchArray[2].template get<int>();
+            
+            if (op == 0) {
+                return BasicJsonType(nullptr);
+            }
+            
+            if (op == OP_TEXTDIFF) {
+                return detail::ApplyTextDiff(detail::StringValue(patchArray[0]), left, false);
+            }
+            
+            throw std::runtime_error("Invalid patch object");
+        }
+        
+        throw std::runtime_error("Invalid patch object");
+    }
+    
+    return BasicJsonType(nullptr);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ObjectPatch(const BasicJsonType& obj, const BasicJsonType& patch) {
+    detail::TraceScope trace(_options.Tracer, TRACE_OBJECT_PATCH, _tracePath, obj.size(), patch.size());
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = obj.is_null() ? BasicJsonType::object() : obj;
+    
+    if (patch.is_null()) {
+        return target;
+    }
+    
+    for (auto it = patch.begin(); it != patch.end(); ++it) {
+        const auto& key = it.key();
+        const BasicJsonType& patchValue = it.value();
+        
+        // Check for deletion
+        if (patchValue.is_array() && patchValue.size() == 3 && 
+            patchValue[2].is_number_integer() && patchValue[2].template get<int>() == 0) {
+            target.erase(key);
+        } else {
+            detail::TracePath segment(_options.Tracer, _tracePath, key);
+            if (target.contains(key)) {
+                target[key] = Patch(target[key], patchValue);
+            } else {
+                target[key] = Patch(BasicJsonType(nullptr), patchValue);
+            }
+        }
+    }
+    
+    return target;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ArrayPatch(const BasicJsonType& left, const BasicJsonType& patch) {
+    // Expect: patch has "_t":"a"
+    detail::TraceScope trace(_options.Tracer, TRACE_ARRAY_PATCH, _tracePath, left.size(), patch.size() - 1);
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = left;
+    auto& arr = target.template get_ref<typename BasicJsonType::array_t&>();
+
+    // Work lists point into the patch; values are copied once, into the array
+    using ArrayOp = detail::ArrayOp<BasicJsonType>;
+    typename detail::Workspace<BasicJsonType>::Lease scratch(_scratch);
+    auto& removals = scratch.frame.ops[0];        // target: destination of a move-out
+    auto& modifications = scratch.frame.ops[1];
+    auto& insertions = scratch.frame.ops[2];
+
+    // Classify ops
+    for (auto it = patch.begin(); it != patch.end(); ++it) {
+        const auto& key = it.key();
+        if (key == "_t") continue;
+
+        const BasicJsonType& v = it.value();
+        if (!key.empty() && key[0] == '_') {
+            // deletion or move-out
+            size_t idx = detail::ParseIndex(key, 1);
+            if (v.is_array() && v.size() == 3) {
+                int op = v[2].template get<int>();
+                if (op == OP_DELETED) {
+                    removals.push_back({ idx, 0, nullptr, false });
+                }
+                else if (op == OP_ARRAYMOVE) {
+                    // jsondiffpatch encodes move as ["<val>", toIndex, 3]
+                    size_t to = v[1].template get<size_t>();
+                    removals.push_back({ idx, to, nullptr, true });
+                }
+            }
+        }
+        else {
+            // addition or modification
+            size_t idx = detail::ParseIndex(key, 0);
+            if (v.is_array() && v.size() == 1) {
+                insertions.push_back({ idx, 0, &v[0], false });
+            }
+            else if (v.is_array() && v.size() == 3 && v[2].is_number_integer()
+                && v[2].template get<int>() == OP_ARRAYMOVE) {
+                // (rare form) move encoded on positive key
+                size_t to = v[1].template get<size_t>();
+                // treat as: remove from '_' + fromIndex and insert at to
+                // if you ever generate this form, you’d need the "from"; most diffs use the '_' key form.
+                insertions.push_back({ to, 0, &v[0], true });
+            }
+            else {
+                modifications.push_back({ idx, 0, &v, false });
+            }
+        }
+    }
+
+    // 1) Apply removals (including move extraction) in DESC order
+    std::sort(removals.begin(), removals.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index > b.index; });
+
+    // Keep a temporary store for values we move so we can reinsert later using fresh indices
+    struct PendingMove { size_t target; BasicJsonType value; };
+    std::pmr::vector<PendingMove> pendingMoves(detail::Scratch());
+
+    for (const auto& r : removals) {
+        if (arr.empty()) continue;
+        size_t idx = (r.index < arr.size()) ? r.index : (arr.size() - 1);
+        if (r.isMove) {
+            pendingMoves.push_back({ r.target, std::move(arr[idx]) });
+        }
+        arr.erase(arr.begin() + idx);
+    }
+
+    // 2) Apply modifications in ASC order (only if index still exists)
+    std::sort(modifications.begin(), modifications.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+
+    for (const auto& m : modifications) {
+        if (m.index < arr.size()) {
+            detail::TracePath segment(_options.Tracer, _tracePath, m.index);
+            arr[m.index] = Patch(arr[m.index], *m.value);
+        }
+    }
+
+    // 3) Apply move insertions first (ASC), then regular insertions (ASC)
+    std::sort(pendingMoves.begin(), pendingMoves.end(),
+        [](const PendingMove& a, const PendingMove& b) { return a.target < b.target; });
+
+    for (auto& mv : pendingMoves) {
+        size_t pos = (mv.target <= arr.size()) ? mv.target : arr.size();
+        arr.insert(arr.begin() + pos, std::move(mv.value));
+    }
+
+    std::sort(insertions.begin(), insertions.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, insertions.size());
+    for (const auto& ins : insertions) {
+        size_t pos = (ins.index <= arr.size()) ? ins.index : arr.size();
+        arr.insert(arr.begin() + pos, *ins.value);
+    }
+
+    return target;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Unpatch(const BasicJsonType& right, const BasicJsonType& patch) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::PatchNs);
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    
+    if (patch.is_null()) {
+        JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+        return right;
+    }
+    
+    if (patch.is_object()) {
+        if (right.is_array() && patch.contains("_t") && 
+            patch["_t"].is_string() && patch["_t"] == "a") {
+            return ArrayUnpatch(right, patch);
+        }
+        return ObjectUnpatch(right, patch);
+    }
+    
+    if (patch.is_array()) {
+        const BasicJsonType& patchArray = patch;
+        
+        if (patchArray.size() == 1) {
+            // Add (we need to remove)
+            return BasicJsonType(nullptr);
+        }
+        
+        if (patchArray.size() == 2) {
+            // Replace
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            return patchArray[0];
+        }
+        
+        if (patchArray.size() == 3) {
+            if (!patchArray[2].is_number_integer()) {
+                throw std::runtime_error("Invalid patch object");
+            }
+            
+            int op = patchArray[2].template get<int>();
+            
+            if (op == 0) {
+                JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+                return patchArray[0];
+            }
+            
+            if (op == OP_TEXTDIFF) {
+                return detail::ApplyTextDiff(detail::StringValue(patchArray[0]), right, true);
+            }
+            
+            throw std::runtime_error("Invalid patch object");
+        }
+        
+        throw std::runtime_error("Invalid patch object");
+    }
+    
+    return BasicJsonType(nullptr);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ObjectUnpatch(const BasicJsonType& obj, const BasicJsonType& patch) {
+    detail::TraceScope trace(_options.Tracer, TRACE_OBJECT_UNPATCH, _tracePath, obj.size(), patch.size());
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = obj.is_null() ? BasicJsonType::object() : obj;
+    
+    if (patch.is_null()) {
+        return target;
+    }
+    
+    for (auto it = patch.begin(); it != patch.end(); ++it) {
+        const auto& key = it.key();
+        const BasicJsonType& patchValue = it.value();
+        
+        // Check for addition (which we need to undo by removing)
+        if (patchValue.is_array() && patchValue.size() == 1) {
+            target.erase(key);
+        } else {
+            detail::TracePath segment(_options.Tracer, _tracePath, key);
+            if (target.contains(key)) {
+                target[key] = Unpatch(target[key], patchValue);
+            } else {
+                target[key] = Unpatch(BasicJsonType(nullptr), patchValue);
+            }
+        }
+    }
+    
+    return target;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::ArrayUnpatch(const BasicJsonType& right, const BasicJsonType& patch) {
+    detail::TraceScope trace(_options.Tracer, TRACE_ARRAY_UNPATCH, _tracePath, right.size(), patch.size() - 1);
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = right;
+    auto& arr = target.template get_ref<typename BasicJsonType::array_t&>();
+
+    using ArrayOp = detail::ArrayOp<BasicJsonType>;
+    typename detail::Workspace<BasicJsonType>::Lease scratch(_scratch);
+    auto& adds = scratch.frame.ops[0];     // positive key, size==1 → remove
+    auto& dels = scratch.frame.ops[1];     // "_i": [value,0,0] → insert back
+    auto& mods = scratch.frame.ops[2];     // positive key with object → unpatch
+    auto& moves = scratch.frame.ops[3];    // moved to index from target → move back
+
+    for (auto it = patch.begin(); it != patch.end(); ++it) {
+        const auto& key = it.key();
+        if (key == "_t") continue;
+        const BasicJsonType& v = it.value();
+
+        if (!key.empty() && key[0] == '_') {
+            size_t idx = detail::ParseIndex(key, 1);
+            if (v.is_array() && v.size() == 3) {
+                int op = v[2].template get<int>();
+                if (op == OP_DELETED) {
+                    dels.push_back({ idx, 0, &v[0], false });
+                }
+                else if (op == OP_ARRAYMOVE) {
+                    // original: moved from idx to v[1]
+                    size_t to = v[1].template get<size_t>();
+                    moves.push_back({ to, idx, nullptr, true }); // move back from "to" to "idx"
+                }
+            }
+        }
+        else {
+            size_t idx = detail::ParseIndex(key, 0);
+            if (v.is_array() && v.size() == 1) {
+                adds.push_back({ idx, 0, nullptr, false });
+            }
+            else {
+                mods.push_back({ idx, 0, &v, false });
+            }
+        }
+    }
+
+    // 1) Undo additions: remove at index (DESC to keep indices stable)
+    std::sort(adds.begin(), adds.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index > b.index; });
+    for (const auto& a : adds) {
+        if (arr.empty()) continue;
+        if (a.index < arr.size()) {
+            arr.erase(arr.begin() + a.index);
+        }
+        else {
+            // if out of range, remove last (best-effort)
+            arr.pop_back();
+        }
+    }
+
+    // 2) Undo moves: move from 'index' back to 'target' (ASC by target)
+    std::sort(moves.begin(), moves.end(),
+        [](const ArrayOp& x, const ArrayOp& y) { return x.target < y.target; });
+    for (const auto& mv : moves) {
+        if (arr.empty()) continue;
+        size_t from = (mv.index < arr.size()) ? mv.index : (arr.size() - 1);
+        BasicJsonType val = std::move(arr[from]);
+        arr.erase(arr.begin() + from);
+        size_t to = (mv.target <= arr.size()) ? mv.target : arr.size();
+        arr.insert(arr.begin() + to, std::move(val));
+    }
+
+    // 3) Undo modifications (ASC)
+    std::sort(mods.begin(), mods.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+    for (const auto& m : mods) {
+        if (m.index < arr.size()) {
+            detail::TracePath segment(_options.Tracer, _tracePath, m.index);
+            arr[m.index] = Unpatch(arr[m.index], *m.value);
+        }
+    }
+
+    // 4) Reinsert deletions (ASC)
+    std::sort(dels.begin(), dels.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, dels.size());
+    for (const auto& d : dels) {
+        size_t pos = (d.index <= arr.size()) ? d.index : arr.size();
+        arr.insert(arr.begin() + pos, *d.value);
+    }
+
+    return target;
+}
+
+// Binary delta implementation
+namespace detail {
+
+    const int BIN_ADD = 0;
+    const int BIN_REPLACE = 1;
+    const int BIN_DELETE = 2;
+    const int BIN_TEXTDIFF = 3;
+    const int BIN_MOVE = 4;
+    const int BIN_OBJECT = 5;
+    const int BIN_ARRAY = 6;
+
+    template<typename BasicJsonType>
+    BasicJsonType EncodeNode(const BasicJsonType& delta);
+
+    template<typename BasicJsonType>
+    BasicJsonType EncodeArrayNode(const BasicJsonType& delta) {
+        BasicJsonType node = BasicJsonType::array();
+        node.push_back(BIN_ARRAY);
+        for (auto it = delta.begin(); it != delta.end(); ++it) {
+            const auto& key = it.key();
+            if (key == "_t") continue;
+
+            // "i" -> 2*i, "_i" -> 2*i+1
+            bool removed = !key.empty() && key[0] == '_';
+            uint64_t index = ParseIndex(key, removed ? 1 : 0);
+            node.push_back(index * 2 + (removed ? 1 : 0));
+            node.push_back(EncodeNode(it.value()));
+        }
+        return node;
+    }
+
+    template<typename BasicJsonType>
+    BasicJsonType EncodeNode(const BasicJsonType& delta) {
+        if (delta.is_object()) {
+            auto type = delta.find("_t");
+            if (type != delta.end() && *type == "a") {
+                return EncodeArrayNode(delta);
+            }
+
+            BasicJsonType node = BasicJsonType::array();
+            node.push_back(BIN_OBJECT);
+            for (auto it = delta.begin(); it != delta.end(); ++it) {
+                node.push_back(it.key());
+                node.push_back(EncodeNode(it.value()));
+            }
+            return node;
+        }
+
+        if (delta.is_array()) {
+            if (delta.size() == 1) {
+                return BasicJsonType::array({ BIN_ADD, delta[0] });
+            }
+            if (delta.size() == 2) {
+                return BasicJsonType::array({ BIN_REPLACE, delta[0], delta[1] });
+            }
+            if (delta.size() == 3 && delta[2].is_number_integer()) {
+                int op = delta[2].template get<int>();
+                if (op == OP_DELETED) {
+                    return BasicJsonType::array({ BIN_DELETE, delta[0] });
+                }
+                if (op == OP_TEXTDIFF) {
+                    return BasicJsonType::array({ BIN_TEXTDIFF, delta[0] });
+                }
+                if (op == OP_ARRAYMOVE) {
+                    return BasicJsonType::array({ BIN_MOVE, delta[1], delta[0] });
+                }
+            }
+        }
+
+        throw std::runtime_error("Invalid patch object");
+    }
+
+    template<typename BasicJsonType>
+    BasicJsonType DecodeNode(const BasicJsonType& node) {
+        if (!node.is_array() || node.empty() || !node[0].is_number_integer()) {
+            throw std::runtime_error("Invalid binary delta");
+        }
+
+        switch (node[0].template get<int>()) {
+            case BIN_ADD:
+                return BasicJsonType::array({ node.at(1) });
+            case BIN_REPLACE:
+                return BasicJsonType::array({ node.at(1), node.at(2) });
+            case BIN_DELETE:
+                return BasicJsonType::array({ node.at(1), 0, OP_DELETED });
+            case BIN_TEXTDIFF:
+                return BasicJsonType::array({ node.at(1), 0, OP_TEXTDIFF });
+            case BIN_MOVE:
+                return BasicJsonType::array({ node.at(2), node.at(1), OP_ARRAYMOVE });
+            case BIN_OBJECT: {
+                BasicJsonType delta = BasicJsonType::object();
+                for (size_t i = 1; i + 1 < node.size(); i += 2) {
+                    delta[node[i].template get<typename BasicJsonType::string_t>()] = DecodeNode(node[i + 1]);
+                }
+                return delta;
+            }
+            case BIN_ARRAY: {
+                BasicJsonType delta = BasicJsonType::object();
+                delta["_t"] = "a";
+                for (size_t i = 1; i + 1 < node.size(); i += 2) {
+                    uint64_t slot = node[i].template get<uint64_t>();
+                    delta[IndexKey<BasicJsonType>(static_cast<size_t>(slot / 2), slot % 2 == 1)] = DecodeNode(node[i + 1]);
+                }
+                return delta;
+            }
+            default:
+                throw std::runtime_error("Invalid binary delta");
+        }
+    }
+
+}
+
+template<typename BasicJsonType>
+std::vector<uint8_t> BasicBinaryDelta<BasicJsonType>::Encode(const BasicJsonType& delta, int format) {
+    std::vector<uint8_t> result;
+    if (delta.is_null()) {
+        return result;
+    }
+
+    BasicJsonType node = detail::EncodeNode(delta);
+    result.push_back(static_cast<uint8_t>(format));
+    if (format == BINARY_CBOR) {
+        BasicJsonType::to_cbor(node, result);
+    } else if (format == BINARY_MSGPACK) {
+        BasicJsonType::to_msgpack(node, result);
+    } else {
+        throw std::runtime_error("Unknown binary delta format");
+    }
+    return result;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicBinaryDelta<BasicJsonType>::Decode(const uint8_t* data, size_t size) {
+    if (!data || size == 0) {
+        return BasicJsonType(nullptr);
+    }
+
+    const uint8_t* body = data + 1;
+    const uint8_t* end = data + size;
+    if (data[0] == BINARY_CBOR) {
+        return detail::DecodeNode(BasicJsonType::from_cbor(body, end));
+    }
+    if (data[0] == BINARY_MSGPACK) {
+        return detail::DecodeNode(BasicJsonType::from_msgpack(body, end));
+    }
+    throw std::runtime_error("Unknown binary delta format");
+}
+
+template<typename BasicJsonType>
+std::vector<uint8_t> BasicJsonDiffPatch<BasicJsonType>::DiffBinary(const BasicJsonType& left, const BasicJsonType& right, int format) {
+    BasicJsonType delta = Diff(left, right);
+    detail::StatsScope stats(_stats.stats, &DiffStats::SerializeNs);
+    return BasicBinaryDelta<BasicJsonType>::Encode(delta, format);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Patch(const BasicJsonType& left, const std::vector<uint8_t>& binaryDelta) {
+    return Patch(left, DecodeDelta(binaryDelta));
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Unpatch(const BasicJsonType& right, const std::vector<uint8_t>& binaryDelta) {
+    return Unpatch(right, DecodeDelta(binaryDelta));
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::DecodeDelta(const std::vector<uint8_t>& binaryDelta) {
+    detail::StatsScope stats(_stats.stats, &DiffStats::ParseNs);
+    return BasicBinaryDelta<BasicJsonType>::Decode(binaryDelta);
+}
+
+template<typename BasicJsonType>
+std::string BasicJsonDiffPatch<BasicJsonType>::Diff(const std::string& left, const std::string& right) {
+    try {
+        std::string result;
+        DiffText(left.data(), left.size(), right.data(), right.size(), result);
+        return result;
+    } catch (const std::exception&) {
+        return "";
+    }
+}
+
+template<typename BasicJsonType>
+std::string BasicJsonDiffPatch<BasicJsonType>::Patch(const std::string& left, const std::string& patch) {
+    try {
+        BasicJsonType leftJson;
+        BasicJsonType patchJson;
+        {
+            detail::StatsScope stats(_stats.stats, &DiffStats::ParseNs);
+            leftJson = left.empty() ? BasicJsonType("") : BasicJsonType::parse(left);
+            patchJson = patch.empty() ? BasicJsonType(nullptr) : BasicJsonType::parse(patch);
+        }
+        BasicJsonType result = Patch(leftJson, patchJson);
+        detail::StatsScope stats(_stats.stats, &DiffStats::SerializeNs);
+        return result.is_null() ? "" : detail::ToStdString(result.dump());
+    } catch (const std::exception&) {
+        return "";
+    }
+}
+
+template<typename BasicJsonType>
+std::string BasicJsonDiffPatch<BasicJsonType>::Unpatch(const std::string& right, const std::string& patch) {
+    try {
+        BasicJsonType rightJson;
+        BasicJsonType patchJson;
+        {
+            detail::StatsScope stats(_stats.stats, &DiffStats::ParseNs);
+            rightJson = right.empty() ? BasicJsonType("") : BasicJsonType::parse(right);
+            patchJson = patch.empty() ? BasicJsonType(nullptr) : BasicJsonType::parse(patch);
+        }
+        BasicJsonType result = Unpatch(rightJson, patchJson);
+        detail::StatsScope stats(_stats.stats, &DiffStats::SerializeNs);
+        return result.is_null() ? "" : detail::ToStdString(result.dump());
+    } catch (const std::exception&) {
+        return "";
+    }
+}
+
+} // namespace JsonDiffPatch
+
+#include "detail/DeltaView.h"
+#include "detail/DeltaWriter.h"
+#include "detail/RawDiff.h"
+#include "detail/StreamingDiff.h"
+#include "detail/DiffSession.h"
+#include "detail/TrackedDocument.h"
+#include "detail/DeltaCache.h"
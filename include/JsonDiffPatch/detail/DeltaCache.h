@@ -0,0 +1,313 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+#include <cstring>
+#include <string_view>
+
+namespace JsonDiffPatch {
+
+namespace detail {
+
+    // Rough heap cost of a map node holding an object member, on top of its key and value
+    const size_t OBJECT_MEMBER_OVERHEAD = 48;
+
+    // Folds value into seed: one multiply per step, with the high bits folded back down
+    inline uint64_t MixHash(uint64_t seed, uint64_t value) {
+        uint64_t x = (seed ^ value) * 0x9e3779b97f4a7c15ULL;
+        return x ^ (x >> 29);
+    }
+
+    // The same for the high word of a DocumentHash, with its own constants
+    inline uint64_t MixHighHash(uint64_t seed, uint64_t value) {
+        uint64_t x = (seed ^ value) * 0xc2b2ae3d27d4eb4fULL;
+        return x ^ (x >> 31);
+    }
+
+    inline void MixHash(DocumentHash& hash, uint64_t value) {
+        hash.Low = MixHash(hash.Low, value);
+        hash.High = MixHighHash(hash.High, value);
+    }
+
+    inline void MixHash(DocumentHash& hash, const DocumentHash& value) {
+        hash.Low = MixHash(hash.Low, value.Low);
+        hash.High = MixHighHash(hash.High, value.High);
+    }
+
+    // std::hash for the low word, eight bytes per step of MixHighHash for the high one, so
+    // that bytes colliding in one rarely collide in the other
+    inline DocumentHash BytesHash(const char* data, size_t size) {
+        DocumentHash hash;
+        hash.Low = std::hash<std::string_view>()(std::string_view(data, size));
+        hash.High = MixHighHash(0, size);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash.High = MixHighHash(hash.High, word);
+        }
+        if (i < size) {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i, size - i);
+            hash.High = MixHighHash(hash.High, word);
+        }
+        return hash;
+    }
+
+    template<typename StringType>
+    DocumentHash StringHash(const StringType& text) {
+        return BytesHash(text.data(), text.size());
+    }
+
+    // Hash of a value's type, contents and (for ordered_json) member order
+    template<typename BasicJsonType>
+    DocumentHash StructuralHash(const BasicJsonType& value) {
+        DocumentHash hash;
+        MixHash(hash, static_cast<uint64_t>(value.type()));
+        switch (value.type()) {
+        case nlohmann::detail::value_t::object:
+            MixHash(hash, value.size());
+            for (auto it = value.begin(); it != value.end(); ++it) {
+                MixHash(hash, StringHash(it.key()));
+                MixHash(hash, StructuralHash(it.value()));
+            }
+            break;
+        case nlohmann::detail::value_t::array:
+            MixHash(hash, value.size());
+            for (const auto& element : value) {
+                MixHash(hash, StructuralHash(element));
+            }
+            break;
+        case nlohmann::detail::value_t::string:
+            MixHash(hash, StringHash(StringValue(value)));
+            break;
+        case nlohmann::detail::value_t::boolean:
+            MixHash(hash, value.template get<bool>() ? 1 : 0);
+            break;
+        case nlohmann::detail::value_t::number_integer:
+            MixHash(hash, static_cast<uint64_t>(value.template get<typename BasicJsonType::number_integer_t>()));
+            break;
+        case nlohmann::detail::value_t::number_unsigned:
+            MixHash(hash, static_cast<uint64_t>(value.template get<typename BasicJsonType::number_unsigned_t>()));
+            break;
+        case nlohmann::detail::value_t::number_float: {
+            double number = static_cast<double>(value.template get<typename BasicJsonType::number_float_t>());
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            MixHash(hash, bits);
+            break;
+        }
+        case nlohmann::detail::value_t::binary: {
+            const auto& binary = value.get_binary();
+            MixHash(hash, BytesHash(reinterpret_cast<const char*>(binary.data()), binary.size()));
+            break;
+        }
+        default:
+            break;
+        }
+        return hash;
+    }
+
+    // Everything in the options that changes the delta
+    template<typename BasicJsonType>
+    uint64_t OptionsFingerprint(const BasicOptions<BasicJsonType>& options) {
+        uint64_t hash = MixHash(0, static_cast<uint64_t>(options.ArrayDiff));
+        hash = MixHash(hash, static_cast<uint64_t>(options.TextDiff));
+        hash = MixHash(hash, options.MinEfficientTextDiffLength);
+        hash = MixHash(hash, options.DiffArrayOptions.DetectMove ? 1 : 0);
+        hash = MixHash(hash, options.DiffArrayOptions.IncludeValueOnMove ? 1 : 0);
+        hash = MixHash(hash, options.DeltaCacheTag);
+        if (options.ObjectHash) {
+            hash = MixHash(hash, options.ObjectHash.target_type().hash_code());
+            using Function = std::string (*)(const BasicJsonType&);
+            if (const Function* function = options.ObjectHash.template target<Function>()) {
+                hash = MixHash(hash, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(*function)));
+            }
+        }
+        return hash;
+    }
+
+    // Estimated heap memory held by a value
+    template<typename BasicJsonType>
+    size_t ApproximateSize(const BasicJsonType& value) {
+        size_t size = sizeof(BasicJsonType);
+        switch (value.type()) {
+        case nlohmann::detail::value_t::object:
+            size += sizeof(typename BasicJsonType::object_t);
+            for (auto it = value.begin(); it != value.end(); ++it) {
+                size += OBJECT_MEMBER_OVERHEAD + it.key().size() + ApproximateSize(it.value());
+            }
+            break;
+        case nlohmann::detail::value_t::array:
+            size += sizeof(typename BasicJsonType::array_t);
+            for (const auto& element : value) {
+                size += ApproximateSize(element);
+            }
+            break;
+        case nlohmann::detail::value_t::string:
+            size += sizeof(typename BasicJsonType::string_t) + StringValue(value).size();
+            break;
+        case nlohmann::detail::value_t::binary:
+            size += sizeof(typename BasicJsonType::binary_t) + value.get_binary().size();
+            break;
+        default:
+            break;
+        }
+        return size;
+    }
+
+    // Sets a flag for the lifetime of the scope
+    class FlagScope {
+    public:
+        explicit FlagScope(bool& flag) : _flag(flag) { _flag = true; }
+        ~FlagScope() { _flag = false; }
+
+        FlagScope(const FlagScope&) = delete;
+        FlagScope& operator=(const FlagScope&) = delete;
+
+    private:
+        bool& _flag;
+    };
+
+} // namespace detail
+
+template<typename BasicJsonType>
+DeltaCacheStats BasicDeltaCache<BasicJsonType>::Stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+template<typename BasicJsonType>
+void BasicDeltaCache<BasicJsonType>::Clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _index.clear();
+    _entries.clear();
+    _stats.Entries = 0;
+    _stats.Bytes = 0;
+}
+
+template<typename BasicJsonType>
+DocumentHash BasicDeltaCache<BasicJsonType>::Hash(const BasicJsonType& document) {
+    return detail::StructuralHash(document);
+}
+
+template<typename BasicJsonType>
+typename BasicDeltaCache<BasicJsonType>::Key BasicDeltaCache<BasicJsonType>::MakeKey(
+    const DocumentHash& leftHash, const DocumentHash& rightHash, const BasicOptions<BasicJsonType>& options) {
+    return Key{ leftHash, rightHash, detail::OptionsFingerprint(options) };
+}
+
+template<typename BasicJsonType>
+template<typename Visitor>
+bool BasicDeltaCache<BasicJsonType>::Find(const Key& key, Visitor&& visit) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        ++_stats.Misses;
+        return false;
+    }
+    ++_stats.Hits;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    visit(it->second->delta);
+    return true;
+}
+
+template<typename BasicJsonType>
+void BasicDeltaCache<BasicJsonType>::Insert(const Key& key, const BasicJsonType& delta) {
+    size_t bytes = sizeof(Entry) + detail::ApproximateSize(delta);
+    if (bytes > _maxBytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Another engine may have stored the same pair meanwhile
+    if (_index.count(key)) {
+        return;
+    }
+    while (_stats.Bytes + bytes > _maxBytes) {
+        const Entry& oldest = _entries.back();
+        _stats.Bytes -= oldest.bytes;
+        _index.erase(oldest.key);
+        _entries.pop_back();
+        --_stats.Entries;
+        ++_stats.Evictions;
+    }
+    _entries.push_front(Entry{ key, delta, bytes });
+    _index.emplace(key, _entries.begin());
+    _stats.Bytes += bytes;
+    ++_stats.Entries;
+}
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::UsesDeltaCache() const {
+    if (!_options.DeltaCache) {
+        return false;
+    }
+    // A plain function pointer is told apart by address; anything else needs a tag
+    using Function = std::string (*)(const BasicJsonType&);
+    return !_options.ObjectHash || _options.DeltaCacheTag != 0 ||
+           _options.ObjectHash.template target<Function>() != nullptr;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Diff(const BasicJsonType& left, const BasicJsonType& right,
+                                                      const DocumentHash& leftHash, const DocumentHash& rightHash) {
+    if (_caching || !UsesDeltaCache()) {
+        return Diff(left, right);
+    }
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    return CachedDiff(left, right, leftHash, rightHash);
+}
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::DiffTo(const BasicJsonType& left, const BasicJsonType& right,
+                                               const DocumentHash& leftHash, const DocumentHash& rightHash,
+                                               std::string& out) {
+    if (!UsesDeltaCache()) {
+        return DiffTo(left, right, out);
+    }
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    out.clear();
+    return CachedDiffTo(left, right, leftHash, rightHash, out);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::CachedDiff(const BasicJsonType& left, const BasicJsonType& right,
+                                                            const DocumentHash& leftHash, const DocumentHash& rightHash) {
+    auto& cache = *_options.DeltaCache;
+    auto key = cache.MakeKey(leftHash, rightHash, _options);
+    BasicJsonType delta;
+    if (cache.Find(key, [&](const BasicJsonType& cached) { delta = cached; })) {
+        return delta;
+    }
+
+    detail::FlagScope caching(_caching);
+    delta = Diff(left, right);
+    cache.Insert(key, delta);
+    return delta;
+}
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::CachedDiffTo(const BasicJsonType& left, const BasicJsonType& right,
+                                                     const DocumentHash& leftHash, const DocumentHash& rightHash,
+                                                     std::string& out) {
+    auto& cache = *_options.DeltaCache;
+    auto key = cache.MakeKey(leftHash, rightHash, _options);
+    // Written straight from the cached delta, without copying it
+    auto write = [&](const BasicJsonType& delta) {
+        if (!delta.is_null()) {
+            _scratch.BindOutput(out).serializer.dump(delta, false, false, 0);
+        }
+    };
+    if (!cache.Find(key, write)) {
+        detail::FlagScope caching(_caching);
+        BasicJsonType delta = Diff(left, right);
+        cache.Insert(key, delta);
+        write(delta);
+    }
+    return !out.empty();
+}
+
+} // namespace JsonDiffPatch
@@ -0,0 +1,598 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+namespace JsonDiffPatch {
+
+// Builds a DeltaView. Mirrors Diff/ObjectDiff/ArrayDiff decision for decision, recording
+// pointers to the compared values where they copy them.
+template<typename BasicJsonType>
+class BasicJsonDiffPatch<BasicJsonType>::DeltaViewBuilder {
+public:
+    using Node = typename DeltaView::Node;
+
+    explicit DeltaViewBuilder(BasicJsonDiffPatch& engine)
+        : _engine(engine), _options(engine._options), _itemMatch(engine._itemMatch) {}
+
+    // Fills node with the delta of left and right; returns false if they are equal
+    bool Build(const BasicJsonType& left, const BasicJsonType& right, Node& node) {
+        JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+        static const BasicJsonType emptyString("");
+        const BasicJsonType& leftValue = left.is_null() ? emptyString : left;
+        const BasicJsonType& rightValue = right.is_null() ? emptyString : right;
+
+        if (leftValue.is_object() && rightValue.is_object()) {
+            return BuildObject(leftValue, rightValue, node);
+        }
+
+        if (_options.ArrayDiff == MODE_EFFICIENT &&
+            leftValue.is_array() && rightValue.is_array()) {
+            return BuildArray(leftValue, rightValue, node);
+        }
+
+        if (_options.TextDiff == TEXTDIFF_EFFICIENT &&
+            leftValue.is_string() && rightValue.is_string()) {
+            const auto& leftStr = detail::StringValue(leftValue);
+            const auto& rightStr = detail::StringValue(rightValue);
+
+            if (leftStr == rightStr) {
+                return false;
+            }
+
+            if (leftStr.length() > _options.MinEfficientTextDiffLength ||
+                rightStr.length() > _options.MinEfficientTextDiffLength) {
+                std::string patches = detail::TextDiffPatches(leftStr, rightStr);
+                if (!patches.empty()) {
+                    node.Kind = DELTA_TEXTDIFF;
+                    node.Text = std::move(patches);
+                    return true;
+                }
+            }
+        }
+
+        if (!_itemMatch.Match(leftValue, rightValue)) {
+            node.Kind = DELTA_MODIFIED;
+            node.Left = &leftValue;
+            node.Right = &rightValue;
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    bool BuildObject(const BasicJsonType& left, const BasicJsonType& right, Node& node) {
+        node.Kind = DELTA_OBJECT;
+
+        for (auto it = left.begin(); it != left.end(); ++it) {
+            auto match = right.find(it.key());
+            if (match != right.end()) {
+                Node& child = AddChild(node);
+                if (!Build(it.value(), *match, child)) {
+                    node.Children.pop_back();
+                    continue;
+                }
+                child.Key = &it.key();
+            } else {
+                // Property deleted
+                Node& child = AddChild(node);
+                child.Kind = DELTA_DELETED;
+                child.Key = &it.key();
+                child.Left = &it.value();
+            }
+        }
+
+        for (auto it = right.begin(); it != right.end(); ++it) {
+            if (!left.contains(it.key())) {
+                Node& child = AddChild(node);
+                child.Kind = DELTA_ADDED;
+                child.Key = &it.key();
+                child.Right = &it.value();
+            }
+        }
+
+        return !node.Children.empty();
+    }
+
+    bool BuildArray(const BasicJsonType& left, const BasicJsonType& right, Node& node) {
+        if (left == right) {
+            return false;
+        }
+
+        node.Kind = DELTA_ARRAY;
+        const auto& leftVec = left.template get_ref<const typename BasicJsonType::array_t&>();
+        const auto& rightVec = right.template get_ref<const typename BasicJsonType::array_t&>();
+
+        if (leftVec.size() == rightVec.size()) {
+            for (size_t i = 0; i < leftVec.size(); ++i) {
+                if (!_itemMatch.Match(leftVec[i], rightVec[i])) {
+                    AddModified(node, leftVec[i], rightVec[i], i);
+                }
+            }
+            return !node.Children.empty();
+        }
+
+        size_t commonHead = 0;
+        size_t commonTail = 0;
+
+        while (commonHead < leftVec.size() && commonHead < rightVec.size() &&
+               _itemMatch.MatchArrayElement(leftVec[commonHead], static_cast<int>(commonHead),
+                                            rightVec[commonHead], static_cast<int>(commonHead))) {
+            AddModified(node, leftVec[commonHead], rightVec[commonHead], commonHead);
+            commonHead++;
+        }
+
+        while (commonTail + commonHead < leftVec.size() &&
+               commonTail + commonHead < rightVec.size() &&
+               _itemMatch.MatchArrayElement(leftVec[leftVec.size() - 1 - commonTail],
+                                            static_cast<int>(leftVec.size() - 1 - commonTail),
+                                            rightVec[rightVec.size() - 1 - commonTail],
+                                            static_cast<int>(rightVec.size() - 1 - commonTail))) {
+            AddModified(node, leftVec[leftVec.size() - 1 - commonTail],
+                        rightVec[rightVec.size() - 1 - commonTail], rightVec.size() - 1 - commonTail);
+            commonTail++;
+        }
+
+        if (commonHead + commonTail == leftVec.size()) {
+            for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+                AddEntry(node, DELTA_ADDED, index).Right = &rightVec[index];
+            }
+            return true;
+        }
+
+        if (commonHead + commonTail == rightVec.size()) {
+            for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+                AddEntry(node, DELTA_DELETED, index).Left = &leftVec[index];
+            }
+            return true;
+        }
+
+        typename detail::Workspace<BasicJsonType>::Lease scratch(_engine._scratch);
+        LcsResult& lcs = scratch.frame.lcs;
+        _engine.ComputeLcs(leftVec.data() + commonHead, leftVec.size() - commonHead - commonTail,
+                           rightVec.data() + commonHead, rightVec.size() - commonHead - commonTail, lcs);
+
+        for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+            if (lcs.LeftMatch[index - commonHead] < 0) {
+                AddEntry(node, DELTA_DELETED, index).Left = &leftVec[index];
+            }
+        }
+
+        for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+            int match = lcs.RightMatch[index - commonHead];
+            if (match < 0) {
+                AddEntry(node, DELTA_ADDED, index).Right = &rightVec[index];
+            } else {
+                AddModified(node, leftVec[static_cast<size_t>(match) + commonHead], rightVec[index], index);
+            }
+        }
+
+        return !node.Children.empty();
+    }
+
+    // Array entry for index; kept only if the elements differ
+    void AddModified(Node& node, const BasicJsonType& left, const BasicJsonType& right, size_t index) {
+        Node& child = AddChild(node);
+        if (Build(left, right, child)) {
+            child.Index = index;
+        } else {
+            node.Children.pop_back();
+        }
+    }
+
+    Node& AddEntry(Node& node, int kind, size_t index) {
+        Node& child = AddChild(node);
+        child.Kind = kind;
+        child.Index = index;
+        return child;
+    }
+
+    static Node& AddChild(Node& node) {
+        node.Children.emplace_back();
+        return node.Children.back();
+    }
+
+    BasicJsonDiffPatch& _engine;
+    const Options& _options;
+    const ItemMatch& _itemMatch;
+};
+
+template<typename BasicJsonType>
+typename BasicJsonDiffPatch<BasicJsonType>::DeltaView
+BasicJsonDiffPatch<BasicJsonType>::DiffView(const BasicJsonType& left, const BasicJsonType& right) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    DeltaView view;
+    auto root = std::make_unique<typename DeltaView::Node>();
+    if (DeltaViewBuilder(*this).Build(left, right, *root)) {
+        view._root = std::move(root);
+    }
+    return view;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicDeltaView<BasicJsonType>::Materialize() const {
+    return _root ? Materialize(*_root) : BasicJsonType(nullptr);
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicDeltaView<BasicJsonType>::Materialize(const Node& node) {
+    BasicJsonType result = BasicJsonType::array();
+    switch (node.Kind) {
+        case DELTA_ADDED:
+            result.push_back(*node.Right);
+            break;
+        case DELTA_DELETED:
+            result.push_back(*node.Left);
+            result.push_back(0);
+            result.push_back(OP_DELETED);
+            break;
+        case DELTA_MODIFIED:
+            result.push_back(*node.Left);
+            result.push_back(*node.Right);
+            break;
+        case DELTA_TEXTDIFF:
+            result.push_back(node.Text);
+            result.push_back(0);
+            result.push_back(OP_TEXTDIFF);
+            break;
+        case DELTA_OBJECT:
+            result = BasicJsonType::object();
+            for (const Node& child : node.Children) {
+                result[*child.Key] = Materialize(child);
+            }
+            break;
+        case DELTA_ARRAY:
+            result = BasicJsonType::object();
+            result["_t"] = "a";
+            for (const Node& child : node.Children) {
+                bool removed = child.Kind == DELTA_DELETED || child.Kind == DELTA_MOVED;
+                result[detail::IndexKey<BasicJsonType>(child.Index, removed)] = Materialize(child);
+            }
+            break;
+        case DELTA_MOVED:
+            result.push_back(node.Right ? *node.Right : BasicJsonType(""));
+            result.push_back(node.Target);
+            result.push_back(OP_ARRAYMOVE);
+            break;
+        default:
+            throw std::invalid_argument("Invalid delta view node");
+    }
+    return result;
+}
+
+template<typename BasicJsonType>
+BasicDeltaView<BasicJsonType> BasicDeltaView<BasicJsonType>::FromJson(const BasicJsonType& delta) {
+    BasicDeltaView view;
+    if (!delta.is_null()) {
+        view._root = std::make_unique<Node>();
+        ReadNode(delta, *view._root);
+    }
+    return view;
+}
+
+template<typename BasicJsonType>
+void BasicDeltaView<BasicJsonType>::ReadNode(const BasicJsonType& delta, Node& node) {
+    if (delta.is_object()) {
+        auto type = delta.find("_t");
+        if (type != delta.end() && type->is_string() && *type == "a") {
+            ReadArray(delta, node);
+            return;
+        }
+
+        node.Kind = DELTA_OBJECT;
+        for (auto it = delta.begin(); it != delta.end(); ++it) {
+            if (it.value().is_null()) {
+                continue;
+            }
+            node.Children.emplace_back();
+            Node& child = node.Children.back();
+            child.Key = &it.key();
+            ReadNode(it.value(), child);
+            if (child.Kind == DELTA_MOVED) {
+                throw std::runtime_error("Invalid patch object");
+            }
+        }
+        return;
+    }
+
+    if (!delta.is_array() || delta.empty() || delta.size() > 3) {
+        throw std::runtime_error("Invalid patch object");
+    }
+
+    if (delta.size() == 1) {
+        node.Kind = DELTA_ADDED;
+        node.Right = &delta[0];
+        return;
+    }
+
+    if (delta.size() == 2) {
+        node.Kind = DELTA_MODIFIED;
+        node.Left = &delta[0];
+        node.Right = &delta[1];
+        return;
+    }
+
+    if (!delta[2].is_number_integer()) {
+        throw std::runtime_error("Invalid patch object");
+    }
+
+    int op = delta[2].template get<int>();
+    if (op == OP_DELETED) {
+        node.Kind = DELTA_DELETED;
+        node.Left = &delta[0];
+    } else if (op == OP_TEXTDIFF && delta[0].is_string()) {
+        node.Kind = DELTA_TEXTDIFF;
+        node.Text = detail::StringValue(delta[0]);
+    } else if (op == OP_ARRAYMOVE && delta[1].is_number_integer() &&
+               (delta[1].is_number_unsigned() || delta[1].template get<typename BasicJsonType::number_integer_t>() >= 0)) {
+        // Deltas built in C++ hold the target as a signed integer, parsed ones as unsigned
+        node.Kind = DELTA_MOVED;
+        node.Target = delta[1].template get<size_t>();
+        node.Right = &delta[0];
+    } else {
+        throw std::runtime_error("Invalid patch object");
+    }
+}
+
+template<typename BasicJsonType>
+void BasicDeltaView<BasicJsonType>::ReadArray(const BasicJsonType& delta, Node& node) {
+    node.Kind = DELTA_ARRAY;
+    for (auto it = delta.begin(); it != delta.end(); ++it) {
+        const auto& key = it.key();
+        if (key == "_t") continue;
+
+        node.Children.emplace_back();
+        Node& child = node.Children.back();
+        ReadNode(it.value(), child);
+
+        if (!key.empty() && key[0] == '_') {
+            // "_3": deleted or moved away
+            if (child.Kind != DELTA_DELETED && child.Kind != DELTA_MOVED) {
+                throw std::runtime_error("Invalid patch object");
+            }
+            child.Index = detail::ParseIndex(key, 1);
+        } else if (child.Kind == DELTA_MOVED) {
+            // Move on a positive key: Patch inserts the value at the target
+            child.Kind = DELTA_ADDED;
+            child.Index = child.Target;
+        } else if (child.Kind == DELTA_DELETED) {
+            throw std::runtime_error("Invalid patch object");
+        } else {
+            child.Index = detail::ParseIndex(key, 0);
+        }
+    }
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Patch(const BasicJsonType& left, const DeltaView& delta) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::PatchNs);
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = left;
+    if (!delta.Empty()) {
+        PatchNode(target, delta.Root());
+    }
+    return target;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Unpatch(const BasicJsonType& right, const DeltaView& delta) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::PatchNs);
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+    BasicJsonType target = right;
+    if (!delta.Empty()) {
+        UnpatchNode(target, delta.Root());
+    }
+    return target;
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::PatchNode(BasicJsonType& target, const typename DeltaView::Node& node) {
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    switch (node.Kind) {
+        case DELTA_ADDED:
+        case DELTA_MODIFIED:
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            target = *node.Right;
+            break;
+        case DELTA_DELETED:
+            target = nullptr;
+            break;
+        case DELTA_TEXTDIFF:
+            target = detail::ApplyTextDiff(node.Text, target, false);
+            break;
+        case DELTA_OBJECT:
+            if (target.is_null()) {
+                target = BasicJsonType::object();
+            }
+            for (const auto& child : node.Children) {
+                if (child.Kind == DELTA_DELETED) {
+                    target.erase(*child.Key);
+                } else {
+                    PatchNode(target[*child.Key], child);
+                }
+            }
+            break;
+        case DELTA_ARRAY:
+            PatchArrayNode(target, node);
+            break;
+        default:
+            throw std::runtime_error("Invalid patch object");
+    }
+}
+
+// Same order of operations as ArrayPatch
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::PatchArrayNode(BasicJsonType& target, const typename DeltaView::Node& node) {
+    if (!target.is_array()) {
+        throw std::runtime_error("Invalid patch object");
+    }
+    auto& arr = target.template get_ref<typename BasicJsonType::array_t&>();
+
+    // Modifications keep the position of their node among the children in target
+    using ArrayOp = detail::ArrayOp<BasicJsonType>;
+    typename detail::Workspace<BasicJsonType>::Lease scratch(_scratch);
+    auto& removals = scratch.frame.ops[0];
+    auto& modifications = scratch.frame.ops[1];
+    auto& insertions = scratch.frame.ops[2];
+
+    for (size_t k = 0; k < node.Children.size(); ++k) {
+        const auto& child = node.Children[k];
+        if (child.Kind == DELTA_DELETED) {
+            removals.push_back({ child.Index, 0, nullptr, false });
+        } else if (child.Kind == DELTA_MOVED) {
+            removals.push_back({ child.Index, child.Target, nullptr, true });
+        } else if (child.Kind == DELTA_ADDED) {
+            insertions.push_back({ child.Index, 0, child.Right, false });
+        } else {
+            modifications.push_back({ child.Index, k, nullptr, false });
+        }
+    }
+
+    std::sort(removals.begin(), removals.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index > b.index; });
+
+    struct PendingMove { size_t target; BasicJsonType value; };
+    std::pmr::vector<PendingMove> pendingMoves(detail::Scratch());
+
+    for (const auto& r : removals) {
+        if (arr.empty()) continue;
+        size_t idx = (r.index < arr.size()) ? r.index : (arr.size() - 1);
+        if (r.isMove) {
+            pendingMoves.push_back({ r.target, std::move(arr[idx]) });
+        }
+        arr.erase(arr.begin() + idx);
+    }
+
+    std::sort(modifications.begin(), modifications.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+
+    for (const auto& m : modifications) {
+        if (m.index < arr.size()) {
+            PatchNode(arr[m.index], node.Children[m.target]);
+        }
+    }
+
+    std::sort(pendingMoves.begin(), pendingMoves.end(),
+        [](const PendingMove& a, const PendingMove& b) { return a.target < b.target; });
+
+    for (auto& mv : pendingMoves) {
+        size_t pos = (mv.target <= arr.size()) ? mv.target : arr.size();
+        arr.insert(arr.begin() + pos, std::move(mv.value));
+    }
+
+    std::sort(insertions.begin(), insertions.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, insertions.size());
+    for (const auto& ins : insertions) {
+        size_t pos = (ins.index <= arr.size()) ? ins.index : arr.size();
+        arr.insert(arr.begin() + pos, *ins.value);
+    }
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::UnpatchNode(BasicJsonType& target, const typename DeltaView::Node& node) {
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    switch (node.Kind) {
+        case DELTA_ADDED:
+            target = nullptr;
+            break;
+        case DELTA_MODIFIED:
+        case DELTA_DELETED:
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            target = *node.Left;
+            break;
+        case DELTA_TEXTDIFF:
+            target = detail::ApplyTextDiff(node.Text, target, true);
+            break;
+        case DELTA_OBJECT:
+            if (target.is_null()) {
+                target = BasicJsonType::object();
+            }
+            for (const auto& child : node.Children) {
+                if (child.Kind == DELTA_ADDED) {
+                    target.erase(*child.Key);
+                } else {
+                    UnpatchNode(target[*child.Key], child);
+                }
+            }
+            break;
+        case DELTA_ARRAY:
+            UnpatchArrayNode(target, node);
+            break;
+        default:
+            throw std::runtime_error("Invalid patch object");
+    }
+}
+
+// Same order of operations as ArrayUnpatch
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::UnpatchArrayNode(BasicJsonType& target, const typename DeltaView::Node& node) {
+    if (!target.is_array()) {
+        throw std::runtime_error("Invalid patch object");
+    }
+    auto& arr = target.template get_ref<typename BasicJsonType::array_t&>();
+
+    using ArrayOp = detail::ArrayOp<BasicJsonType>;
+    typename detail::Workspace<BasicJsonType>::Lease scratch(_scratch);
+    auto& adds = scratch.frame.ops[0];
+    auto& dels = scratch.frame.ops[1];
+    auto& mods = scratch.frame.ops[2];     // target: position of the node among the children
+    auto& moves = scratch.frame.ops[3];
+
+    for (size_t k = 0; k < node.Children.size(); ++k) {
+        const auto& child = node.Children[k];
+        if (child.Kind == DELTA_ADDED) {
+            adds.push_back({ child.Index, 0, nullptr, false });
+        } else if (child.Kind == DELTA_DELETED) {
+            dels.push_back({ child.Index, 0, child.Left, false });
+        } else if (child.Kind == DELTA_MOVED) {
+            moves.push_back({ child.Target, child.Index, nullptr, true });
+        } else {
+            mods.push_back({ child.Index, k, nullptr, false });
+        }
+    }
+
+    std::sort(adds.begin(), adds.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index > b.index; });
+    for (const auto& a : adds) {
+        if (arr.empty()) continue;
+        if (a.index < arr.size()) {
+            arr.erase(arr.begin() + a.index);
+        } else {
+            arr.pop_back();
+        }
+    }
+
+    std::sort(moves.begin(), moves.end(),
+        [](const ArrayOp& x, const ArrayOp& y) { return x.target < y.target; });
+    for (const auto& mv : moves) {
+        if (arr.empty()) continue;
+        size_t from = (mv.index < arr.size()) ? mv.index : (arr.size() - 1);
+        BasicJsonType val = std::move(arr[from]);
+        arr.erase(arr.begin() + from);
+        size_t to = (mv.target <= arr.size()) ? mv.target : arr.size();
+        arr.insert(arr.begin() + to, std::move(val));
+    }
+
+    std::sort(mods.begin(), mods.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+    for (const auto& m : mods) {
+        if (m.index < arr.size()) {
+            UnpatchNode(arr[m.index], node.Children[m.target]);
+        }
+    }
+
+    std::sort(dels.begin(), dels.end(),
+        [](const ArrayOp& a, const ArrayOp& b) { return a.index < b.index; });
+    JSONDIFFPATCH_STATS_ADD(ValuesCopied, dels.size());
+    for (const auto& d : dels) {
+        size_t pos = (d.index <= arr.size()) ? d.index : arr.size();
+        arr.insert(arr.begin() + pos, *d.value);
+    }
+}
+
+} // namespace JsonDiffPatch
@@ -0,0 +1,368 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+namespace JsonDiffPatch {
+
+// Serializes a delta while it is being computed. Mirrors Diff/ObjectDiff/ArrayDiff
+// decision for decision, so the text is byte-identical to Diff(left, right).dump().
+// Every member is written speculatively and cut off again if its child turns out equal.
+template<typename BasicJsonType>
+class BasicJsonDiffPatch<BasicJsonType>::DeltaWriter {
+public:
+    DeltaWriter(BasicJsonDiffPatch& engine, std::string& out)
+        : _engine(engine), _options(engine._options), _itemMatch(engine._itemMatch),
+          _out(out), _serializer(engine._scratch.BindOutput(out).serializer),
+          _entries(detail::Scratch()) {}
+
+    // Appends the delta of left and right; returns false (and appends nothing) if they are equal
+    bool Write(const BasicJsonType& left, const BasicJsonType& right) {
+        JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+        static const BasicJsonType emptyString("");
+        const BasicJsonType& leftValue = left.is_null() ? emptyString : left;
+        const BasicJsonType& rightValue = right.is_null() ? emptyString : right;
+
+        if (leftValue.is_object() && rightValue.is_object()) {
+            return WriteObject(leftValue, rightValue);
+        }
+
+        if (_options.ArrayDiff == MODE_EFFICIENT &&
+            leftValue.is_array() && rightValue.is_array()) {
+            return WriteArray(leftValue, rightValue);
+        }
+
+        if (_options.TextDiff == TEXTDIFF_EFFICIENT &&
+            leftValue.is_string() && rightValue.is_string()) {
+            const auto& leftStr = detail::StringValue(leftValue);
+            const auto& rightStr = detail::StringValue(rightValue);
+
+            if (leftStr == rightStr) {
+                return false;
+            }
+
+            if (leftStr.length() > _options.MinEfficientTextDiffLength ||
+                rightStr.length() > _options.MinEfficientTextDiffLength) {
+                std::string patches = detail::TextDiffPatches(leftStr, rightStr);
+                if (!patches.empty()) {
+                    _out += '[';
+                    WriteValue(BasicJsonType(std::move(patches)));
+                    WriteOp(OP_TEXTDIFF);
+                    return true;
+                }
+            }
+        }
+
+        if (!_itemMatch.Match(leftValue, rightValue)) {
+            _out += '[';
+            WriteValue(leftValue);
+            _out += ',';
+            WriteValue(rightValue);
+            _out += ']';
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    enum class EntryKind { Added, Deleted, Modified };
+
+    struct Entry {
+        EntryKind kind;
+        size_t left;
+        size_t right;
+        char key[24];
+        size_t keyLength;
+
+        Entry(EntryKind entryKind, size_t leftIndex, size_t rightIndex)
+            : kind(entryKind), left(leftIndex), right(rightIndex) {
+            char* p = key;
+            size_t index = rightIndex;
+            if (kind == EntryKind::Deleted) {
+                *p++ = '_';
+                index = leftIndex;
+            }
+            p = std::to_chars(p, key + sizeof(key), index).ptr;
+            keyLength = static_cast<size_t>(p - key);
+        }
+
+        std::string_view name() const { return std::string_view(key, keyLength); }
+    };
+
+    // Object members come out of both sides in key order, which is also the order the
+    // delta object would serialize them in
+    bool WriteObject(const BasicJsonType& left, const BasicJsonType& right) {
+        if constexpr (!detail::IsSortedObject<BasicJsonType>) {
+            return WriteOrderedObject(left, right);
+        }
+
+        size_t start = _out.size();
+        _out += '{';
+        bool written = false;
+
+        auto leftIt = left.begin();
+        auto rightIt = right.begin();
+        while (leftIt != left.end() || rightIt != right.end()) {
+            int order = leftIt == left.end() ? 1
+                      : rightIt == right.end() ? -1
+                      : leftIt.key().compare(rightIt.key());
+            size_t mark = _out.size();
+
+            if (order < 0) {
+                // Property deleted
+                BeginMember(leftIt.key(), written);
+                _out += '[';
+                WriteValue(leftIt.value());
+                WriteOp(OP_DELETED);
+                ++leftIt;
+            } else if (order > 0) {
+                // Property added
+                BeginMember(rightIt.key(), written);
+                _out += '[';
+                WriteValue(rightIt.value());
+                _out += ']';
+                ++rightIt;
+            } else {
+                BeginMember(leftIt.key(), written);
+                bool changed = Write(leftIt.value(), rightIt.value());
+                ++leftIt;
+                ++rightIt;
+                if (!changed) {
+                    _out.resize(mark);
+                    continue;
+                }
+            }
+            written = true;
+        }
+
+        return EndContainer(start, written);
+    }
+
+    // Insertion-ordered objects: changed and deleted members in left order, then the added
+    // members in right order, as ObjectDiff inserts them
+    bool WriteOrderedObject(const BasicJsonType& left, const BasicJsonType& right) {
+        size_t start = _out.size();
+        _out += '{';
+        bool written = false;
+
+        for (auto leftIt = left.begin(); leftIt != left.end(); ++leftIt) {
+            size_t mark = _out.size();
+            auto rightIt = right.find(leftIt.key());
+            BeginMember(leftIt.key(), written);
+            if (rightIt == right.end()) {
+                _out += '[';
+                WriteValue(leftIt.value());
+                WriteOp(OP_DELETED);
+            } else if (!Write(leftIt.value(), rightIt.value())) {
+                _out.resize(mark);
+                continue;
+            }
+            written = true;
+        }
+
+        for (auto rightIt = right.begin(); rightIt != right.end(); ++rightIt) {
+            if (!left.contains(rightIt.key())) {
+                BeginMember(rightIt.key(), written);
+                _out += '[';
+                WriteValue(rightIt.value());
+                _out += ']';
+                written = true;
+            }
+        }
+
+        return EndContainer(start, written);
+    }
+
+    // Collects the entries ArrayDiff would produce, then writes them in key order
+    // (insertion order for ordered objects, with "_t" leading)
+    bool WriteArray(const BasicJsonType& left, const BasicJsonType& right) {
+        if (left == right) {
+            return false;
+        }
+
+        constexpr bool sorted = detail::IsSortedObject<BasicJsonType>;
+        const auto& leftVec = left.template get_ref<const typename BasicJsonType::array_t&>();
+        const auto& rightVec = right.template get_ref<const typename BasicJsonType::array_t&>();
+        size_t base = _entries.size();
+
+        if (leftVec.size() == rightVec.size()) {
+            for (size_t i = 0; i < leftVec.size(); ++i) {
+                if (!_itemMatch.Match(leftVec[i], rightVec[i])) {
+                    _entries.emplace_back(EntryKind::Modified, i, i);
+                }
+            }
+        } else {
+            CollectResizedArray(leftVec, rightVec);
+        }
+
+        if (sorted) {
+            std::sort(_entries.begin() + base, _entries.end(),
+                      [](const Entry& a, const Entry& b) { return a.name() < b.name(); });
+        }
+
+        size_t start = _out.size();
+        _out += sorted ? "{" : "{\"_t\":\"a\"";
+        bool written = false;
+
+        // Nested arrays push above the current end and truncate back, so indices stay valid
+        size_t end = _entries.size();
+        for (size_t k = base; k < end; ++k) {
+            Entry entry = _entries[k];
+            size_t mark = _out.size();
+            if (written || !sorted) {
+                _out += ',';
+            }
+            _out += '"';
+            _out.append(entry.key, entry.keyLength);
+            _out += "\":";
+
+            if (entry.kind == EntryKind::Added) {
+                _out += '[';
+                WriteValue(rightVec[entry.right]);
+                _out += ']';
+            } else if (entry.kind == EntryKind::Deleted) {
+                _out += '[';
+                WriteValue(leftVec[entry.left]);
+                WriteOp(OP_DELETED);
+            } else if (!Write(leftVec[entry.left], rightVec[entry.right])) {
+                _out.resize(mark);
+                continue;
+            }
+            written = true;
+        }
+        _entries.erase(_entries.begin() + base, _entries.end());
+
+        // "_t" sorts after every index key
+        if (written && sorted) {
+            _out += ",\"_t\":\"a\"";
+        }
+        return EndContainer(start, written);
+    }
+
+    void CollectResizedArray(const typename BasicJsonType::array_t& leftVec,
+                             const typename BasicJsonType::array_t& rightVec) {
+        size_t commonHead = 0;
+        size_t commonTail = 0;
+
+        while (commonHead < leftVec.size() && commonHead < rightVec.size() &&
+               _itemMatch.MatchArrayElement(leftVec[commonHead], static_cast<int>(commonHead),
+                                            rightVec[commonHead], static_cast<int>(commonHead))) {
+            _entries.emplace_back(EntryKind::Modified, commonHead, commonHead);
+            commonHead++;
+        }
+
+        while (commonTail + commonHead < leftVec.size() &&
+               commonTail + commonHead < rightVec.size() &&
+               _itemMatch.MatchArrayElement(leftVec[leftVec.size() - 1 - commonTail],
+                                            static_cast<int>(leftVec.size() - 1 - commonTail),
+                                            rightVec[rightVec.size() - 1 - commonTail],
+                                            static_cast<int>(rightVec.size() - 1 - commonTail))) {
+            _entries.emplace_back(EntryKind::Modified, leftVec.size() - 1 - commonTail,
+                                  rightVec.size() - 1 - commonTail);
+            commonTail++;
+        }
+
+        if (commonHead + commonTail == leftVec.size()) {
+            for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+                _entries.emplace_back(EntryKind::Added, 0, index);
+            }
+            return;
+        }
+
+        if (commonHead + commonTail == rightVec.size()) {
+            for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+                _entries.emplace_back(EntryKind::Deleted, index, 0);
+            }
+            return;
+        }
+
+        typename detail::Workspace<BasicJsonType>::Lease scratch(_engine._scratch);
+        LcsResult& lcs = scratch.frame.lcs;
+        _engine.ComputeLcs(leftVec.data() + commonHead, leftVec.size() - commonHead - commonTail,
+                           rightVec.data() + commonHead, rightVec.size() - commonHead - commonTail, lcs);
+
+        for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
+            if (lcs.LeftMatch[index - commonHead] < 0) {
+                _entries.emplace_back(EntryKind::Deleted, index, 0);
+            }
+        }
+
+        for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
+            int match = lcs.RightMatch[index - commonHead];
+            if (match < 0) {
+                _entries.emplace_back(EntryKind::Added, 0, index);
+            } else {
+                _entries.emplace_back(EntryKind::Modified, static_cast<size_t>(match) + commonHead, index);
+            }
+        }
+    }
+
+    void BeginMember(const typename BasicJsonType::string_t& key, bool written) {
+        if (written) {
+            _out += ',';
+        }
+        WriteKey(key);
+        _out += ':';
+    }
+
+    bool EndContainer(size_t start, bool written) {
+        if (!written) {
+            _out.resize(start);
+            return false;
+        }
+        _out += '}';
+        return true;
+    }
+
+    void WriteKey(const typename BasicJsonType::string_t& key) {
+        // Plain printable ASCII needs no escaping; anything else goes through the serializer
+        bool plain = std::all_of(key.begin(), key.end(), [](char c) {
+            return c >= 0x20 && c < 0x7f && c != '"' && c != '\\';
+        });
+        if (plain) {
+            _out += '"';
+            _out.append(key.data(), key.size());
+            _out += '"';
+        } else {
+            WriteValue(BasicJsonType(key));
+        }
+    }
+
+    void WriteValue(const BasicJsonType& value) {
+        _serializer.dump(value, false, false, 0);
+    }
+
+    // Closes a [value, 0, op] triple
+    void WriteOp(int op) {
+        char digits[16];
+        _out += ",0,";
+        _out.append(digits, std::to_chars(digits, digits + sizeof(digits), op).ptr);
+        _out += ']';
+    }
+
+    BasicJsonDiffPatch& _engine;
+    const Options& _options;
+    const ItemMatch& _itemMatch;
+    std::string& _out;
+    nlohmann::detail::serializer<BasicJsonType>& _serializer;   // kept by the engine, writes to _out
+    std::pmr::vector<Entry> _entries;
+};
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::DiffTo(const BasicJsonType& left, const BasicJsonType& right, std::string& out) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    out.clear();
+    if (UsesDeltaCache()) {
+        return CachedDiffTo(left, right, BasicDeltaCache<BasicJsonType>::Hash(left),
+                            BasicDeltaCache<BasicJsonType>::Hash(right), out);
+    }
+    DeltaWriter writer(*this, out);
+    return writer.Write(left, right);
+}
+
+} // namespace JsonDiffPatch
@@ -0,0 +1,411 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+#include <limits>
+
+namespace JsonDiffPatch {
+
+namespace detail {
+
+    // Stages of a DiffSession frame, in the order Diff/ObjectDiff/ArrayDiff work through them
+    const int SESSION_OBJECT_MEMBERS = 0;       // left members: changed or deleted
+    const int SESSION_OBJECT_ADDED = 1;         // right members missing on the left
+    const int SESSION_ARRAY_START = 2;          // choosing the strategy
+    const int SESSION_ARRAY_SAME_LENGTH = 3;    // element by element
+    const int SESSION_ARRAY_HEAD = 4;           // common head
+    const int SESSION_ARRAY_TAIL = 5;           // common tail
+    const int SESSION_ARRAY_BLOCK_ADDED = 6;
+    const int SESSION_ARRAY_BLOCK_REMOVED = 7;
+    const int SESSION_ARRAY_LCS = 8;            // filling the LCS table, then backtracking
+    const int SESSION_ARRAY_DELETED = 9;        // left elements outside the LCS
+    const int SESSION_ARRAY_MATCHED = 10;       // right elements: added or diffed with their match
+
+} // namespace detail
+
+template<typename BasicJsonType>
+BasicDiffSession<BasicJsonType> BasicJsonDiffPatch<BasicJsonType>::BeginDiff(
+    const BasicJsonType& left, const BasicJsonType& right) {
+    return BasicDiffSession<BasicJsonType>(*this, left, right);
+}
+
+// The copied engine brings the options and its own LCS table; copies start without a
+// statistics sink, so the engine's is attached again
+template<typename BasicJsonType>
+BasicDiffSession<BasicJsonType>::BasicDiffSession(const BasicJsonDiffPatch<BasicJsonType>& engine,
+                                                  const BasicJsonType& left, const BasicJsonType& right)
+    : _engine(engine), _left(&left), _right(&right) {
+    _engine.SetStats(engine.Stats());
+}
+
+template<typename BasicJsonType>
+bool BasicDiffSession<BasicJsonType>::Step(size_t budget) {
+    if (_failed) {
+        throw std::logic_error("Diff session failed in an earlier step");
+    }
+    if (Done()) {
+        return true;
+    }
+
+    detail::StatsScope stats(_engine._stats.stats, &DiffStats::DiffNs);
+    _spent = 0;
+    _budget = (std::max)(budget, size_t(1));
+
+    try {
+        if (!_started) {
+            _started = true;
+            Visit(*_left, *_right, _result);
+        }
+        while (!_frames.empty() && !OutOfBudget()) {
+            Frame& frame = _frames.back();
+            if (frame.stage <= detail::SESSION_OBJECT_ADDED) {
+                StepObject(frame);
+            } else {
+                StepArray(frame);
+            }
+        }
+    }
+    catch (...) {
+        _failed = true;
+        _frames.clear();
+        throw;
+    }
+    return Done();
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicDiffSession<BasicJsonType>::Finish() {
+    Step((std::numeric_limits<size_t>::max)());
+    return std::move(_result);
+}
+
+// Mirrors Diff: scalars are diffed into delta right away (returns true), objects and
+// arrays get a frame whose delta is delivered to the parent when it completes
+template<typename BasicJsonType>
+bool BasicDiffSession<BasicJsonType>::Visit(const BasicJsonType& left, const BasicJsonType& right,
+                                            BasicJsonType& delta) {
+    JSONDIFFPATCH_STATS_ADD(NodesVisited, 1);
+    ++_spent;
+    const auto& options = _engine._options;
+    static const BasicJsonType emptyString("");
+    const BasicJsonType& leftValue = left.is_null() ? emptyString : left;
+    const BasicJsonType& rightValue = right.is_null() ? emptyString : right;
+
+    if (leftValue.is_object() && rightValue.is_object()) {
+        Push(leftValue, rightValue, detail::SESSION_OBJECT_MEMBERS);
+        return false;
+    }
+
+    if (options.ArrayDiff == MODE_EFFICIENT &&
+        leftValue.is_array() && rightValue.is_array()) {
+        Push(leftValue, rightValue, detail::SESSION_ARRAY_START);
+        return false;
+    }
+
+    if (options.TextDiff == TEXTDIFF_EFFICIENT &&
+        leftValue.is_string() && rightValue.is_string()) {
+        const auto& leftStr = detail::StringValue(leftValue);
+        const auto& rightStr = detail::StringValue(rightValue);
+
+        if (leftStr == rightStr) {
+            return true;
+        }
+
+        if (leftStr.length() > options.MinEfficientTextDiffLength ||
+            rightStr.length() > options.MinEfficientTextDiffLength) {
+            std::string patches = detail::TextDiffPatches(leftStr, rightStr);
+            if (!patches.empty()) {
+                delta = BasicJsonType::array({ std::move(patches), 0, OP_TEXTDIFF });
+                return true;
+            }
+        }
+    }
+
+    if (!_engine._itemMatch.Match(leftValue, rightValue)) {
+        JSONDIFFPATCH_STATS_ADD(ValuesCopied, 2);
+        delta = BasicJsonType::array({ leftValue, rightValue });
+    }
+    return true;
+}
+
+template<typename BasicJsonType>
+void BasicDiffSession<BasicJsonType>::Push(const BasicJsonType& left, const BasicJsonType& right, int stage) {
+    Frame& frame = _frames.emplace_back();
+    frame.left = &left;
+    frame.right = &right;
+    frame.stage = stage;
+    if (stage == detail::SESSION_OBJECT_MEMBERS) {
+        frame.member = left.cbegin();
+    }
+}
+
+// Mirrors ObjectDiff. Returns when the budget is spent, a child frame was pushed (frame is
+// then no longer valid) or the object is complete.
+template<typename BasicJsonType>
+void BasicDiffSession<BasicJsonType>::StepObject(Frame& frame) {
+    const BasicJsonType& left = *frame.left;
+    const BasicJsonType& right = *frame.right;
+
+    if (frame.stage == detail::SESSION_OBJECT_MEMBERS) {
+        while (frame.member != left.cend()) {
+            if (OutOfBudget()) {
+                return;
+            }
+            auto it = frame.member++;
+            const auto& key = it.key();
+
+            auto match = right.find(key);
+            if (match != right.end()) {
+                frame.childKey = &key;
+                BasicJsonType delta;
+                if (!Visit(it.value(), *match, delta)) {
+                    return;
+                }
+                Deliver(frame, std::move(delta));
+            } else {
+                // Property deleted
+                ++_spent;
+                JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+                frame.delta[key] = BasicJsonType::array({ it.value(), 0, OP_DELETED });
+            }
+        }
+        frame.stage = detail::SESSION_OBJECT_ADDED;
+        frame.member = right.cbegin();
+    }
+
+    // Properties that were added
+    while (frame.member != right.cend()) {
+        if (OutOfBudget()) {
+            return;
+        }
+        auto it = frame.member++;
+        ++_spent;
+        if (!left.contains(it.key())) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            frame.delta[it.key()] = BasicJsonType::array({ it.value() });
+        }
+    }
+    Complete();
+}
+
+// Mirrors ArrayDiff, stage by stage; returns like StepObject
+template<typename BasicJsonType>
+void BasicDiffSession<BasicJsonType>::StepArray(Frame& frame) {
+    const auto& itemMatch = _engine._itemMatch;
+    const auto& leftVec = frame.left->template get_ref<const typename BasicJsonType::array_t&>();
+    const auto& rightVec = frame.right->template get_ref<const typename BasicJsonType::array_t&>();
+
+    // ArrayDiff starts with a whole-array equality check. It is left out here because it
+    // cannot be split; equal arrays have equal lengths, and the element loop then finds no
+    // change either.
+    if (frame.stage == detail::SESSION_ARRAY_START) {
+        ++_spent;
+        frame.delta = BasicJsonType::object();
+        frame.delta["_t"] = "a";
+        frame.stage = leftVec.size() == rightVec.size() ? detail::SESSION_ARRAY_SAME_LENGTH
+                                                        : detail::SESSION_ARRAY_HEAD;
+        return;
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_SAME_LENGTH) {
+        while (frame.index < leftVec.size()) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t i = frame.index++;
+            ++_spent;
+            // Containers are visited instead of compared with Match, a deep comparison; an
+            // equal pair then yields no delta, as Match would. Objects under an ObjectHash
+            // keep the hash comparison, whose matches are not diffed.
+            bool hashed = itemMatch.ObjectHash && leftVec[i].is_object();
+            bool container = leftVec[i].is_structured() || rightVec[i].is_structured();
+            if ((container && !hashed) || !itemMatch.Match(leftVec[i], rightVec[i])) {
+                frame.childIndex = i;
+                BasicJsonType delta;
+                if (!Visit(leftVec[i], rightVec[i], delta)) {
+                    return;
+                }
+                Deliver(frame, std::move(delta));
+            }
+        }
+        if (frame.delta.size() == 1) {
+            frame.delta = BasicJsonType(nullptr);
+        }
+        Complete();
+        return;
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_HEAD) {
+        while (frame.head < leftVec.size() && frame.head < rightVec.size()) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t i = frame.head;
+            ++_spent;
+            if (!itemMatch.MatchArrayElement(leftVec[i], static_cast<int>(i), rightVec[i], static_cast<int>(i))) {
+                break;
+            }
+            ++frame.head;
+            frame.childIndex = i;
+            BasicJsonType delta;
+            if (!Visit(leftVec[i], rightVec[i], delta)) {
+                return;
+            }
+            Deliver(frame, std::move(delta));
+        }
+        frame.stage = detail::SESSION_ARRAY_TAIL;
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_TAIL) {
+        while (frame.tail + frame.head < leftVec.size() && frame.tail + frame.head < rightVec.size()) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t index1 = leftVec.size() - 1 - frame.tail;
+            size_t index2 = rightVec.size() - 1 - frame.tail;
+            ++_spent;
+            if (!itemMatch.MatchArrayElement(leftVec[index1], static_cast<int>(index1),
+                                             rightVec[index2], static_cast<int>(index2))) {
+                break;
+            }
+            ++frame.tail;
+            frame.childIndex = index2;
+            BasicJsonType delta;
+            if (!Visit(leftVec[index1], rightVec[index2], delta)) {
+                return;
+            }
+            Deliver(frame, std::move(delta));
+        }
+
+        frame.index = frame.head;
+        if (frame.head + frame.tail == leftVec.size()) {
+            frame.stage = detail::SESSION_ARRAY_BLOCK_ADDED;
+        } else if (frame.head + frame.tail == rightVec.size()) {
+            frame.stage = detail::SESSION_ARRAY_BLOCK_REMOVED;
+        } else {
+            frame.stage = detail::SESSION_ARRAY_LCS;
+            frame.index = 0;
+            _engine.BeginLcs(leftVec.size() - frame.head - frame.tail, rightVec.size() - frame.head - frame.tail);
+        }
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_BLOCK_ADDED) {
+        while (frame.index < rightVec.size() - frame.tail) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t index = frame.index++;
+            ++_spent;
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            frame.delta[detail::IndexKey<BasicJsonType>(index)] = BasicJsonType::array({ rightVec[index] });
+        }
+        Complete();
+        return;
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_BLOCK_REMOVED) {
+        while (frame.index < leftVec.size() - frame.tail) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t index = frame.index++;
+            ++_spent;
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            frame.delta[detail::IndexKey<BasicJsonType>(index, true)] =
+                BasicJsonType::array({ leftVec[index], 0, OP_DELETED });
+        }
+        Complete();
+        return;
+    }
+
+    size_t head = frame.head;
+    size_t m = leftVec.size() - head - frame.tail;
+    size_t n = rightVec.size() - head - frame.tail;
+
+    if (frame.stage == detail::SESSION_ARRAY_LCS) {
+        // frame.index counts the table cells filled so far
+        if (frame.index < m * n) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t count = (std::min)(m * n - frame.index, _budget - _spent);
+            _engine.FillLcs(leftVec.data() + head, rightVec.data() + head, n, frame.index, frame.index + count);
+            frame.index += count;
+            _spent += count;
+            if (frame.index < m * n) {
+                return;
+            }
+        }
+        _spent += m + n;
+        _engine.BacktrackLcs(leftVec.data() + head, m, rightVec.data() + head, n, frame.lcs);
+        frame.stage = detail::SESSION_ARRAY_DELETED;
+        frame.index = head;
+    }
+
+    if (frame.stage == detail::SESSION_ARRAY_DELETED) {
+        while (frame.index < head + m) {
+            if (OutOfBudget()) {
+                return;
+            }
+            size_t index = frame.index++;
+            ++_spent;
+            if (frame.lcs.LeftMatch[index - head] < 0) {
+                JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+                frame.delta[detail::IndexKey<BasicJsonType>(index, true)] =
+                    BasicJsonType::array({ leftVec[index], 0, OP_DELETED });
+            }
+        }
+        frame.stage = detail::SESSION_ARRAY_MATCHED;
+        frame.index = head;
+    }
+
+    while (frame.index < head + n) {
+        if (OutOfBudget()) {
+            return;
+        }
+        size_t index = frame.index++;
+        ++_spent;
+        int match = frame.lcs.RightMatch[index - head];
+        if (match < 0) {
+            JSONDIFFPATCH_STATS_ADD(ValuesCopied, 1);
+            frame.delta[detail::IndexKey<BasicJsonType>(index)] = BasicJsonType::array({ rightVec[index] });
+        } else {
+            frame.childIndex = index;
+            BasicJsonType delta;
+            if (!Visit(leftVec[static_cast<size_t>(match) + head], rightVec[index], delta)) {
+                return;
+            }
+            Deliver(frame, std::move(delta));
+        }
+    }
+    if (frame.delta.size() == 1) {
+        frame.delta = BasicJsonType(nullptr);
+    }
+    Complete();
+}
+
+template<typename BasicJsonType>
+void BasicDiffSession<BasicJsonType>::Deliver(Frame& parent, BasicJsonType&& delta) {
+    if (delta.is_null()) {
+        return;
+    }
+    if (parent.stage <= detail::SESSION_OBJECT_ADDED) {
+        parent.delta[*parent.childKey] = std::move(delta);
+    } else {
+        parent.delta[detail::IndexKey<BasicJsonType>(parent.childIndex)] = std::move(delta);
+    }
+}
+
+// Pops the finished frame and hands its delta to the parent (or makes it the result)
+template<typename BasicJsonType>
+void BasicDiffSession<BasicJsonType>::Complete() {
+    BasicJsonType delta = std::move(_frames.back().delta);
+    _frames.pop_back();
+    if (_frames.empty()) {
+        _result = std::move(delta);
+    } else {
+        Deliver(_frames.back(), std::move(delta));
+    }
+}
+
+} // namespace JsonDiffPatch
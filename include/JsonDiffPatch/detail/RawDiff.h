@@ -0,0 +1,420 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace JsonDiffPatch {
+
+namespace detail {
+
+    struct Span {
+        const char* begin;
+        const char* end;
+
+        size_t size() const { return static_cast<size_t>(end - begin); }
+
+        bool operator==(const Span& other) const {
+            return size() == other.size() && std::memcmp(begin, other.begin, size()) == 0;
+        }
+    };
+
+    struct Member {
+        std::string_view key;
+        Span value;
+        const char* start;    // opening quote of the key
+    };
+
+    // Structural scanner: finds where values start and end without decoding them.
+    // Strings are only checked for termination and brackets for nesting; RawDiffer
+    // validates what it skips.
+    class Scanner {
+    public:
+        static const char* SkipWhitespace(const char* p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
+            return p;
+        }
+
+        // p points at the opening quote; returns the position after the closing one
+        static const char* SkipString(const char* p, const char* end) {
+            // Most strings are short keys: look at a few bytes before calling memchr
+            for (const char* stop = end - p > 24 ? p + 24 : end; ++p < stop;) {
+                if (*p == '"') return p + 1;
+                if (*p == '\\') break;
+            }
+            for (;;) {
+                if (p >= end) return nullptr;
+                auto quote = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+                if (!quote) {
+                    return nullptr;
+                }
+                const char* escape = quote;
+                while (escape > p && escape[-1] == '\\') --escape;
+                p = quote + 1;
+                if ((quote - escape) % 2 == 0) {
+                    return p;
+                }
+            }
+        }
+
+        // Returns the position after the value starting at p, or nullptr if malformed
+        static const char* SkipValue(const char* p, const char* end) {
+            if (p >= end) {
+                return nullptr;
+            }
+            if (*p == '"') {
+                return SkipString(p, end);
+            }
+            if (*p != '{' && *p != '[') {
+                const char* start = p;
+                while (p < end && !IsDelimiter(*p)) ++p;
+                return p > start ? p : nullptr;
+            }
+
+            // Bit d of objects is set when nesting level d is an object (kinds are checked
+            // for the first 64 levels)
+            uint64_t objects = 0;
+            size_t depth = 0;
+            while (p < end) {
+                char c = *p;
+                if (c == '"') {
+                    p = SkipString(p, end);
+                    if (!p) return nullptr;
+                    continue;
+                }
+                if (c == '{' || c == '[') {
+                    if (depth < 64) {
+                        objects = c == '{' ? objects | (uint64_t(1) << depth) : objects & ~(uint64_t(1) << depth);
+                    }
+                    ++depth;
+                } else if (c == '}' || c == ']') {
+                    if (depth == 0) return nullptr;
+                    --depth;
+                    if (depth < 64 && ((objects >> depth) & 1) != (c == '}' ? 1u : 0u)) return nullptr;
+                    if (depth == 0) return p + 1;
+                }
+                ++p;
+            }
+            return nullptr;
+        }
+
+        // If the text at p repeats [from, to) of the other document at the same structural
+        // position, returns where the repeated value ends on this side
+        static const char* SkipRepeated(const char* from, const char* to, const char* valueBegin,
+                                        const char* p, const char* end) {
+            size_t length = static_cast<size_t>(to - from);
+            if (length > static_cast<size_t>(end - p) || std::memcmp(from, p, length) != 0) {
+                return nullptr;
+            }
+            // A scalar ends at the first delimiter, which lies past the compared bytes
+            const char* valueEnd = p + length;
+            bool scalar = *valueBegin != '"' && *valueBegin != '{' && *valueBegin != '[';
+            return scalar && valueEnd < end && !IsDelimiter(*valueEnd) ? nullptr : valueEnd;
+        }
+
+        // Splits an object span into members in text order. With a reference (the other
+        // side's members), members repeating the reference member at the same index are
+        // taken over after a memcmp instead of being scanned. Fails on malformed input and
+        // on keys with escapes, whose meaning only the parser settles.
+        static bool ReadObject(Span object, std::pmr::vector<Member>& members, const std::pmr::vector<Member>* reference) {
+            const char* p = SkipWhitespace(object.begin + 1, object.end);
+            if (p < object.end && *p == '}') {
+                return p + 1 == object.end;
+            }
+            for (;;) {
+                if (p >= object.end || *p != '"') return false;
+
+                const Member* same = reference && members.size() < reference->size()
+                    ? &(*reference)[members.size()] : nullptr;
+                const char* valueEnd = same
+                    ? SkipRepeated(same->start, same->value.end, same->value.begin, p, object.end) : nullptr;
+                if (valueEnd) {
+                    const char* base = same->start;
+                    members.push_back({ std::string_view(p + (same->key.data() - base), same->key.size()),
+                                        { p + (same->value.begin - base), valueEnd }, p });
+                } else {
+                    const char* keyEnd = SkipString(p, object.end);
+                    if (!keyEnd) return false;
+                    std::string_view key(p + 1, static_cast<size_t>(keyEnd - p - 2));
+                    if (key.find('\\') != std::string_view::npos) return false;
+
+                    const char* value = SkipWhitespace(keyEnd, object.end);
+                    if (value >= object.end || *value != ':') return false;
+                    value = SkipWhitespace(value + 1, object.end);
+                    valueEnd = SkipValue(value, object.end);
+                    if (!valueEnd) return false;
+                    members.push_back({ key, { value, valueEnd }, p });
+                }
+
+                p = SkipWhitespace(valueEnd, object.end);
+                if (p < object.end && *p == ',') {
+                    p = SkipWhitespace(p + 1, object.end);
+                } else {
+                    return p + 1 == object.end && *p == '}';
+                }
+            }
+        }
+
+        // Same for arrays
+        static bool ReadArray(Span array, std::pmr::vector<Span>& elements, const std::pmr::vector<Span>* reference) {
+            const char* p = SkipWhitespace(array.begin + 1, array.end);
+            if (p < array.end && *p == ']') {
+                return p + 1 == array.end;
+            }
+            for (;;) {
+                const Span* same = reference && elements.size() < reference->size()
+                    ? &(*reference)[elements.size()] : nullptr;
+                const char* valueEnd = same
+                    ? SkipRepeated(same->begin, same->end, same->begin, p, array.end) : nullptr;
+                if (!valueEnd) {
+                    valueEnd = SkipValue(p, array.end);
+                    if (!valueEnd) return false;
+                }
+                elements.push_back({ p, valueEnd });
+
+                p = SkipWhitespace(valueEnd, array.end);
+                if (p < array.end && *p == ',') {
+                    p = SkipWhitespace(p + 1, array.end);
+                } else {
+                    return p + 1 == array.end && *p == ']';
+                }
+            }
+        }
+
+        // Orders members by key the way json objects do; fails on duplicate keys, where
+        // the parser keeps the last occurrence. Texts written by json::dump are already sorted.
+        static bool SortMembers(std::pmr::vector<Member>& members) {
+            auto less = [](const Member& a, const Member& b) { return a.key < b.key; };
+            auto notGreater = [](const Member& a, const Member& b) { return !(a.key < b.key); };
+            if (std::adjacent_find(members.begin(), members.end(), notGreater) == members.end()) {
+                return true;
+            }
+            std::sort(members.begin(), members.end(), less);
+            return std::adjacent_find(members.begin(), members.end(),
+                [](const Member& a, const Member& b) { return a.key == b.key; }) == members.end();
+        }
+
+    private:
+        static bool IsDelimiter(char c) {
+            return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+    };
+
+    // Compares two texts region by region: containers are split into members with the
+    // scanner, byte-identical members are validated (once, without building values) and
+    // skipped, and only the rest is parsed and handed to the engine. Follows the engine's
+    // rules, so objects always recurse, arrays only in efficient mode, without ObjectHash
+    // and with equal element counts.
+    template<typename BasicJsonType>
+    class RawDiffer {
+    public:
+        using Engine = BasicJsonDiffPatch<BasicJsonType>;
+        using Options = typename Engine::Options;
+
+        RawDiffer(Engine& engine, const Options& options) : _engine(engine), _options(options) {}
+
+        bool Comparable(Span left, Span right) const {
+            return (*left.begin == '{' && *right.begin == '{') ||
+                   (*left.begin == '[' && *right.begin == '[' && ArraysRecurse());
+        }
+
+        BasicJsonType Diff(Span left, Span right) {
+            if (left == right) {
+                Validate(left);
+                return BasicJsonType(nullptr);
+            }
+            if (*left.begin == '{' && *right.begin == '{') {
+                return DiffObjects(left, right);
+            }
+            if (*left.begin == '[' && *right.begin == '[' && ArraysRecurse()) {
+                return DiffArrays(left, right);
+            }
+            return _engine.Diff(Parse(left), Parse(right));
+        }
+
+        static BasicJsonType Parse(Span span) {
+            return BasicJsonType::parse(span.begin, span.end);
+        }
+
+        // Throws the parse error if span is not valid JSON
+        static void Validate(Span span) {
+            if (!BasicJsonType::accept(span.begin, span.end)) {
+                Parse(span);
+            }
+        }
+
+    private:
+        bool ArraysRecurse() const {
+            return _options.ArrayDiff == MODE_EFFICIENT && !_options.ObjectHash;
+        }
+
+        // Keys are taken from the text without decoding (ReadObject refuses escapes), so
+        // only control characters and invalid UTF-8 remain to be rejected
+        static void ValidateKeys(const std::pmr::vector<Member>& members) {
+            for (const Member& member : members) {
+                for (char c : member.key) {
+                    if (static_cast<unsigned char>(c) < 0x20 || static_cast<unsigned char>(c) >= 0x80) {
+                        Validate({ member.key.data() - 1, member.key.data() + member.key.size() + 1 });
+                        break;
+                    }
+                }
+            }
+        }
+
+        static typename BasicJsonType::string_t Key(std::string_view key) {
+            return typename BasicJsonType::string_t(key.data(), key.size());
+        }
+
+        BasicJsonType DiffObjects(Span left, Span right) {
+            std::pmr::vector<Member> leftMembers(Scratch());
+            std::pmr::vector<Member> rightMembers(Scratch());
+            if (!Scanner::ReadObject(left, leftMembers, nullptr) ||
+                !Scanner::ReadObject(right, rightMembers, &leftMembers)) {
+                return _engine.Diff(Parse(left), Parse(right));
+            }
+            ValidateKeys(leftMembers);
+            ValidateKeys(rightMembers);
+            if constexpr (!IsSortedObject<BasicJsonType>) {
+                return DiffOrderedObjects(left, right, leftMembers, rightMembers);
+            }
+            if (!Scanner::SortMembers(leftMembers) || !Scanner::SortMembers(rightMembers)) {
+                return _engine.Diff(Parse(left), Parse(right));
+            }
+
+            BasicJsonType delta = BasicJsonType::object();
+            auto l = leftMembers.begin();
+            auto r = rightMembers.begin();
+            while (l != leftMembers.end() || r != rightMembers.end()) {
+                int order = l == leftMembers.end() ? 1
+                          : r == rightMembers.end() ? -1
+                          : l->key.compare(r->key);
+                if (order < 0) {
+                    delta[Key(l->key)] = BasicJsonType::array({ Parse(l->value), 0, OP_DELETED });
+                    ++l;
+                } else if (order > 0) {
+                    delta[Key(r->key)] = BasicJsonType::array({ Parse(r->value) });
+                    ++r;
+                } else {
+                    BasicJsonType child = Diff(l->value, r->value);
+                    if (!child.is_null()) {
+                        delta[Key(l->key)] = std::move(child);
+                    }
+                    ++l;
+                    ++r;
+                }
+            }
+            return delta.empty() ? BasicJsonType(nullptr) : delta;
+        }
+
+        // Insertion-ordered objects: members in left text order, then the added members in
+        // right text order, as ObjectDiff inserts them. Sorted copies serve the lookups.
+        BasicJsonType DiffOrderedObjects(Span left, Span right, const std::pmr::vector<Member>& leftMembers,
+                                         const std::pmr::vector<Member>& rightMembers) {
+            std::pmr::vector<Member> leftSorted(leftMembers, Scratch());
+            std::pmr::vector<Member> rightSorted(rightMembers, Scratch());
+            if (!Scanner::SortMembers(leftSorted) || !Scanner::SortMembers(rightSorted)) {
+                return _engine.Diff(Parse(left), Parse(right));
+            }
+
+            auto find = [](const std::pmr::vector<Member>& sorted, std::string_view key) -> const Member* {
+                auto it = std::lower_bound(sorted.begin(), sorted.end(), key,
+                    [](const Member& member, std::string_view k) { return member.key < k; });
+                return it != sorted.end() && it->key == key ? &*it : nullptr;
+            };
+
+            BasicJsonType delta = BasicJsonType::object();
+            for (const Member& l : leftMembers) {
+                const Member* r = find(rightSorted, l.key);
+                if (!r) {
+                    delta[Key(l.key)] = BasicJsonType::array({ Parse(l.value), 0, OP_DELETED });
+                    continue;
+                }
+                BasicJsonType child = Diff(l.value, r->value);
+                if (!child.is_null()) {
+                    delta[Key(l.key)] = std::move(child);
+                }
+            }
+            for (const Member& r : rightMembers) {
+                if (!find(leftSorted, r.key)) {
+                    delta[Key(r.key)] = BasicJsonType::array({ Parse(r.value) });
+                }
+            }
+            return delta.empty() ? BasicJsonType(nullptr) : delta;
+        }
+
+        BasicJsonType DiffArrays(Span left, Span right) {
+            std::pmr::vector<Span> leftElements(Scratch());
+            std::pmr::vector<Span> rightElements(Scratch());
+            if (!Scanner::ReadArray(left, leftElements, nullptr) ||
+                !Scanner::ReadArray(right, rightElements, &leftElements) ||
+                leftElements.size() != rightElements.size()) {
+                // Insertions and removals need the LCS over whole elements
+                return _engine.Diff(Parse(left), Parse(right));
+            }
+
+            BasicJsonType delta = BasicJsonType::object();
+            delta["_t"] = "a";
+            for (size_t i = 0; i < leftElements.size(); ++i) {
+                BasicJsonType child = Diff(leftElements[i], rightElements[i]);
+                if (!child.is_null()) {
+                    delta[IndexKey<BasicJsonType>(i)] = std::move(child);
+                }
+            }
+            return delta.size() == 1 ? BasicJsonType(nullptr) : delta;
+        }
+
+        Engine& _engine;
+        const Options& _options;
+    };
+
+    // Trims the text to a top-level object or array. Only the brackets are checked here;
+    // ReadObject/ReadArray verify that the members fill the span exactly.
+    inline bool TopLevelSpan(const char* text, size_t length, Span& span) {
+        const char* begin = Scanner::SkipWhitespace(text, text + length);
+        const char* end = text + length;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\n' || end[-1] == '\r' || end[-1] == '\t')) --end;
+        if (end - begin < 2 || !((*begin == '{' && end[-1] == '}') || (*begin == '[' && end[-1] == ']'))) {
+            return false;
+        }
+        span = { begin, end };
+        return true;
+    }
+
+} // namespace detail
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::DiffText(const char* left, size_t leftLength, const char* right,
+                                                 size_t rightLength, std::string& out) {
+    using detail::Span;
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    out.clear();
+    if (!left || !right || leftLength == 0 || rightLength == 0) {
+        return DiffTo(left && leftLength > 0 ? BasicJsonType::parse(left, left + leftLength) : BasicJsonType(""),
+                      right && rightLength > 0 ? BasicJsonType::parse(right, right + rightLength) : BasicJsonType(""), out);
+    }
+
+    if (leftLength == rightLength && std::memcmp(left, right, leftLength) == 0) {
+        detail::RawDiffer<BasicJsonType>::Validate({ left, left + leftLength });
+        return false;
+    }
+
+    Span leftSpan;
+    Span rightSpan;
+    detail::RawDiffer<BasicJsonType> differ(*this, _options);
+    if (!detail::TopLevelSpan(left, leftLength, leftSpan) || !detail::TopLevelSpan(right, rightLength, rightSpan) ||
+        !differ.Comparable(leftSpan, rightSpan)) {
+        return DiffTo(BasicJsonType::parse(left, left + leftLength), BasicJsonType::parse(right, right + rightLength), out);
+    }
+
+    BasicJsonType delta = differ.Diff(leftSpan, rightSpan);
+    if (delta.is_null()) {
+        return false;
+    }
+    _scratch.BindOutput(out).serializer.dump(delta, false, false, 0);
+    return true;
+}
+
+} // namespace JsonDiffPatch
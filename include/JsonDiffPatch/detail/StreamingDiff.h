@@ -0,0 +1,575 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+#include <istream>
+#include <map>
+#include <stdexcept>
+
+namespace JsonDiffPatch {
+
+namespace detail {
+
+    enum class Event { BeginObject, EndObject, BeginArray, EndArray, Key, Value, End };
+
+    inline bool IsContainer(Event e) {
+        return e == Event::BeginObject || e == Event::BeginArray;
+    }
+
+    // Opens an input again at an offset from where reading started, for looking ahead in an
+    // array and for reading a run of its elements a second time. Memory ranges always can.
+    template<typename InputAdapter>
+    class Rescan {
+    public:
+        Rescan() = default;
+        Rescan(const char* begin, const char* end) : _begin(begin), _end(end) {}
+
+        bool Available() const { return _begin != nullptr; }
+
+        template<typename Read>
+        void Run(size_t offset, Read&& read) {
+            read(InputAdapter(_begin + offset, _end));
+        }
+
+    private:
+        const char* _begin = nullptr;
+        const char* _end = nullptr;
+    };
+
+    // Streams only when they seek. The lexer reads the stream buffer directly, so that is
+    // where the position is taken and restored.
+    template<>
+    class Rescan<nlohmann::detail::input_stream_adapter> {
+    public:
+        Rescan() = default;
+        explicit Rescan(std::istream& stream)
+            : _stream(&stream), _origin(stream.rdbuf()->pubseekoff(0, std::ios::cur, std::ios::in)) {}
+
+        bool Available() const { return _stream && _origin != std::streampos(-1); }
+
+        template<typename Read>
+        void Run(size_t offset, Read&& read) {
+            std::streambuf* buffer = _stream->rdbuf();
+            std::streampos resume = buffer->pubseekoff(0, std::ios::cur, std::ios::in);
+            buffer->pubseekpos(_origin + std::streamoff(offset), std::ios::in);
+            read(nlohmann::detail::input_stream_adapter(*_stream));
+            buffer->pubseekpos(resume, std::ios::in);
+        }
+
+    private:
+        std::istream* _stream = nullptr;
+        std::streampos _origin = std::streampos(-1);
+    };
+
+    // Pull reader on top of nlohmann's lexer (nlohmann::detail, internal to the vendored
+    // header). sax_parse pushes events and cannot be interleaved with a second document on
+    // one thread, so both inputs are tokenized here and walked in lockstep instead.
+    template<typename BasicJsonType, typename InputAdapter>
+    class JsonReader {
+        using Lexer = nlohmann::detail::lexer<BasicJsonType, InputAdapter>;
+        using StringType = typename BasicJsonType::string_t;
+        using Token = typename Lexer::token_type;
+
+    public:
+        explicit JsonReader(InputAdapter&& adapter, Rescan<InputAdapter> rescan = {})
+            : _lexer(std::move(adapter), false), _rescan(rescan) {}
+
+        // Returns the next structural event; Key leaves the name in key(), Value the
+        // scalar in value()
+        Event Next() {
+            Token token = Scan();
+            bool afterComma = false;
+
+            if (_rootDone) {
+                if (token != Token::end_of_input) Fail();
+                return Event::End;
+            }
+
+            if (!_stack.empty() && _afterValue) {
+                if (token == Token::value_separator) {
+                    token = Scan();
+                    afterComma = true;
+                    _afterValue = false;
+                } else if (token == (_stack.back() == '{' ? Token::end_object : Token::end_array)) {
+                    return Close();
+                } else {
+                    Fail();
+                }
+            }
+
+            if (!_stack.empty() && _stack.back() == '{' && !_expectValue) {
+                if (token == Token::end_object && !afterComma) {
+                    return Close();
+                }
+                if (token != Token::value_string) Fail();
+                _key = _lexer.get_string();
+                if (Scan() != Token::name_separator) Fail();
+                _expectValue = true;
+                return Event::Key;
+            }
+
+            if (!_stack.empty() && _stack.back() == '[' && token == Token::end_array && !afterComma) {
+                return Close();
+            }
+
+            _expectValue = false;
+            switch (token) {
+                case Token::begin_object:
+                    _stack.push_back('{');
+                    _afterValue = false;
+                    return Event::BeginObject;
+                case Token::begin_array:
+                    _stack.push_back('[');
+                    _afterValue = false;
+                    return Event::BeginArray;
+                case Token::literal_true: _value = true; break;
+                case Token::literal_false: _value = false; break;
+                case Token::literal_null: _value = nullptr; break;
+                case Token::value_string: _value = _lexer.get_string(); break;
+                case Token::value_unsigned: _value = _lexer.get_number_unsigned(); break;
+                case Token::value_integer: _value = _lexer.get_number_integer(); break;
+                case Token::value_float: _value = _lexer.get_number_float(); break;
+                default: Fail();
+            }
+            ValueDone();
+            return Event::Value;
+        }
+
+        // Builds the value whose first event was already returned by Next()
+        BasicJsonType Read(Event first) {
+            if (first == Event::Value) {
+                return std::move(_value);
+            }
+            if (first == Event::BeginObject) {
+                BasicJsonType result = BasicJsonType::object();
+                for (Event e = Next(); e != Event::EndObject; e = Next()) {
+                    StringType key = std::move(_key);
+                    result[key] = Read(Next());
+                }
+                return result;
+            }
+            if (first == Event::BeginArray) {
+                BasicJsonType result = BasicJsonType::array();
+                for (Event e = Next(); e != Event::EndArray; e = Next()) {
+                    result.push_back(Read(e));
+                }
+                return result;
+            }
+            Fail();
+        }
+
+        const StringType& key() const { return _key; }
+        const BasicJsonType& value() const { return _value; }
+
+        // Characters read so far, up to the end of the last event's token
+        size_t Offset() const { return _lexer.get_position().chars_read_total; }
+        bool CanRescan() const { return _rescan.Available(); }
+
+        // Elements left in the array being read, counting the one whose first event is
+        // current. Lexes ahead on a second pass over the input; the position is kept.
+        size_t CountElements(Event current) {
+            if (current == Event::EndArray) {
+                return 0;
+            }
+            size_t count = 1;
+            size_t depth = IsContainer(current) ? 1 : 0;
+            _rescan.Run(Offset(), [&](InputAdapter&& adapter) {
+                Lexer lexer(std::move(adapter), false);
+                for (;;) {
+                    switch (lexer.scan()) {
+                        case Token::begin_object:
+                        case Token::begin_array:
+                            ++depth;
+                            break;
+                        case Token::end_object:
+                        case Token::end_array:
+                            if (depth == 0) return;
+                            --depth;
+                            break;
+                        case Token::value_separator:
+                            if (depth == 0) ++count;
+                            break;
+                        case Token::parse_error:
+                        case Token::end_of_input:
+                            throw std::runtime_error(std::string("Invalid JSON: ") + lexer.get_error_message());
+                        default:
+                            break;
+                    }
+                }
+            });
+            return count;
+        }
+
+        // Appends count elements of the array being read to out, read again from offset (an
+        // earlier Offset() between two elements; first if no element precedes it)
+        void ReadElements(size_t offset, bool first, size_t count, BasicJsonType& out) {
+            _rescan.Run(offset, [&](InputAdapter&& adapter) {
+                JsonReader reader(std::move(adapter));
+                reader._stack.push_back('[');
+                reader._afterValue = !first;
+                for (size_t i = 0; i < count; ++i) {
+                    out.push_back(reader.Read(reader.Next()));
+                }
+            });
+        }
+
+    private:
+        Token Scan() {
+            Token token = _lexer.scan();
+            if (token == Token::parse_error) Fail();
+            return token;
+        }
+
+        Event Close() {
+            char kind = _stack.back();
+            _stack.pop_back();
+            ValueDone();
+            return kind == '{' ? Event::EndObject : Event::EndArray;
+        }
+
+        void ValueDone() {
+            _afterValue = true;
+            if (_stack.empty()) {
+                _rootDone = true;
+            }
+        }
+
+        [[noreturn]] void Fail() {
+            throw std::runtime_error(std::string("Invalid JSON: ") + _lexer.get_error_message());
+        }
+
+        Lexer _lexer;
+        Rescan<InputAdapter> _rescan;
+        std::vector<char> _stack;
+        StringType _key;
+        BasicJsonType _value;
+        bool _afterValue = false;
+        bool _expectValue = false;
+        bool _rootDone = false;
+    };
+
+    template<typename BasicJsonType, typename InputAdapter>
+    class StreamDiffer {
+    public:
+        using Engine = BasicJsonDiffPatch<BasicJsonType>;
+        using Options = typename Engine::Options;
+
+        StreamDiffer(Engine& engine, const Options& options,
+                     InputAdapter&& left, Rescan<InputAdapter> leftRescan,
+                     InputAdapter&& right, Rescan<InputAdapter> rightRescan,
+                     const typename Engine::DeltaFragmentHandler& onFragment)
+            : _engine(engine), _options(options), _left(std::move(left), leftRescan),
+              _right(std::move(right), rightRescan), _onFragment(onFragment) {}
+
+        bool Run() {
+            _arrayMarkers.push_back(false);
+            DiffValue(_left.Next(), _right.Next());
+            if (_left.Next() != Event::End || _right.Next() != Event::End) {
+                throw std::runtime_error("Invalid JSON: unexpected trailing content");
+            }
+            return _emitted;
+        }
+
+    private:
+        void DiffValue(Event left, Event right) {
+            if (left == Event::BeginObject && right == Event::BeginObject) {
+                DiffObjects();
+                return;
+            }
+            if (left == Event::BeginArray && right == Event::BeginArray &&
+                _options.ArrayDiff == MODE_EFFICIENT && !_options.ObjectHash) {
+                DiffArrays();
+                return;
+            }
+            DiffMaterialized(_left.Read(left), _right.Read(right));
+        }
+
+        void DiffMaterialized(const BasicJsonType& left, const BasicJsonType& right) {
+            BasicJsonType delta = _engine.Diff(left, right);
+            if (!delta.is_null()) {
+                Emit(std::move(delta));
+            }
+        }
+
+        void DiffObjects() {
+            // Keys seen out of order on one side wait here for their counterpart
+            std::map<std::string, BasicJsonType> leftPending;
+            std::map<std::string, BasicJsonType> rightPending;
+            bool leftOpen = true;
+            bool rightOpen = true;
+
+            while (leftOpen || rightOpen) {
+                Event left = leftOpen ? _left.Next() : Event::EndObject;
+                Event right = rightOpen ? _right.Next() : Event::EndObject;
+                leftOpen = left == Event::Key;
+                rightOpen = right == Event::Key;
+
+                if (leftOpen && rightOpen && _left.key() == _right.key()) {
+                    _path.push_back(ToStdString(_left.key()));
+                    _arrayMarkers.push_back(false);
+                    DiffValue(_left.Next(), _right.Next());
+                    _arrayMarkers.pop_back();
+                    _path.pop_back();
+                    continue;
+                }
+
+                if (leftOpen) {
+                    std::string key = ToStdString(_left.key());
+                    BasicJsonType value = _left.Read(_left.Next());
+                    auto match = rightPending.find(key);
+                    if (match != rightPending.end()) {
+                        DiffChild(key, value, match->second);
+                        rightPending.erase(match);
+                    } else {
+                        leftPending.emplace(std::move(key), std::move(value));
+                    }
+                }
+                if (rightOpen) {
+                    std::string key = ToStdString(_right.key());
+                    BasicJsonType value = _right.Read(_right.Next());
+                    auto match = leftPending.find(key);
+                    if (match != leftPending.end()) {
+                        DiffChild(key, match->second, value);
+                        leftPending.erase(match);
+                    } else {
+                        rightPending.emplace(std::move(key), std::move(value));
+                    }
+                }
+            }
+
+            for (auto& entry : leftPending) {
+                EmitChild(entry.first, BasicJsonType::array({ std::move(entry.second), 0, OP_DELETED }));
+            }
+            for (auto& entry : rightPending) {
+                EmitChild(entry.first, BasicJsonType::array({ std::move(entry.second) }));
+            }
+        }
+
+        void DiffArrays() {
+            _arrayMarkers.back() = true;
+            size_t index = 0;
+
+            for (;;) {
+                size_t leftOffset = _left.Offset();
+                Event left = _left.Next();
+                Event right = _right.Next();
+
+                if (left == Event::EndArray && right == Event::EndArray) {
+                    return;
+                }
+
+                // Same rule as the common-head scan in ArrayDiff: containers on the left
+                // match by position, scalars must be equal
+                if (left != Event::EndArray && right != Event::EndArray) {
+                    if (IsContainer(left)) {
+                        DiffElement(index, left, right);
+                        ++index;
+                        continue;
+                    }
+                    if (right == Event::Value && _left.value() == _right.value()) {
+                        ++index;
+                        continue;
+                    }
+                }
+
+                if (!_left.CanRescan() || !_right.CanRescan()) {
+                    DiffArrayTail(index, left, right);
+                    return;
+                }
+                // ArrayDiff depends on both lengths, so count what is left before going on
+                size_t leftCount = index + _left.CountElements(left);
+                size_t rightCount = index + _right.CountElements(right);
+                if (leftCount == rightCount) {
+                    DiffArrayPositions(index, left, right);
+                } else {
+                    DiffArrayWindow(index, leftCount, rightCount, leftOffset, left, right);
+                }
+                return;
+            }
+        }
+
+        void DiffElement(size_t index, Event left, Event right) {
+            _path.push_back(std::to_string(index));
+            _arrayMarkers.push_back(false);
+            DiffValue(left, right);
+            _arrayMarkers.pop_back();
+            _path.pop_back();
+        }
+
+        // Arrays of equal length are diffed position by position, as ArrayDiff does
+        void DiffArrayPositions(size_t index, Event left, Event right) {
+            for (; left != Event::EndArray; left = _left.Next(), right = _right.Next(), ++index) {
+                if (left == Event::Value && right == Event::Value && _left.value() == _right.value()) {
+                    continue;
+                }
+                DiffElement(index, left, right);
+            }
+        }
+
+        // Arrays of different lengths. ArrayDiff leaves the common tail out of the LCS, so the
+        // elements at the same distance from the end are compared as they arrive: a run of
+        // equal ones may be that tail and is only counted, everything else goes into the
+        // window between head and tail, which the regular ArrayDiff then diffs. A run that
+        // turns out not to be the tail is read again from the input.
+        void DiffArrayWindow(size_t head, size_t leftCount, size_t rightCount, size_t leftOffset,
+                             Event left, Event right) {
+            BasicJsonType leftWindow = BasicJsonType::array();
+            BasicJsonType rightWindow = BasicJsonType::array();
+            // The first extra elements of the longer side have no counterpart
+            for (size_t extra = leftCount; extra > rightCount; --extra) {
+                leftWindow.push_back(_left.Read(left));
+                leftOffset = _left.Offset();
+                left = _left.Next();
+            }
+            for (size_t extra = rightCount; extra > leftCount; --extra) {
+                rightWindow.push_back(_right.Read(right));
+                right = _right.Next();
+            }
+
+            size_t index = head + leftWindow.size();   // of the left element being compared
+            size_t runIndex = 0;
+            size_t runOffset = 0;
+            size_t runLength = 0;
+            for (; left != Event::EndArray; ++index) {
+                if (left == Event::Value && right == Event::Value && _left.value() == _right.value()) {
+                    if (runLength++ == 0) {
+                        runIndex = index;
+                        runOffset = leftOffset;
+                    }
+                } else {
+                    if (runLength > 0) {
+                        size_t start = leftWindow.size();
+                        _left.ReadElements(runOffset, runIndex == 0, runLength, leftWindow);
+                        for (size_t i = start; i < leftWindow.size(); ++i) {
+                            rightWindow.push_back(leftWindow[i]);
+                        }
+                        runLength = 0;
+                    }
+                    leftWindow.push_back(_left.Read(left));
+                    rightWindow.push_back(_right.Read(right));
+                }
+                leftOffset = _left.Offset();
+                left = _left.Next();
+                right = _right.Next();
+            }
+
+            EmitShifted(head, _engine.Diff(leftWindow, rightWindow));
+        }
+
+        // Fallback for streams that cannot be read twice: from the first mismatch on, the
+        // remaining elements are materialized and diffed by the regular ArrayDiff
+        void DiffArrayTail(size_t offset, Event left, Event right) {
+            BasicJsonType leftRest = BasicJsonType::array();
+            BasicJsonType rightRest = BasicJsonType::array();
+            for (Event e = left; e != Event::EndArray; e = _left.Next()) {
+                leftRest.push_back(_left.Read(e));
+            }
+            for (Event e = right; e != Event::EndArray; e = _right.Next()) {
+                rightRest.push_back(_right.Read(e));
+            }
+            EmitShifted(offset, _engine.Diff(leftRest, rightRest));
+        }
+
+        // Emits the entries of an array delta over a slice, shifted back to absolute indices
+        void EmitShifted(size_t offset, BasicJsonType&& delta) {
+            if (delta.is_null()) {
+                return;
+            }
+            for (auto it = delta.begin(); it != delta.end(); ++it) {
+                const auto& key = it.key();
+                if (key == "_t") continue;
+                bool removed = key[0] == '_';
+                size_t index = ParseIndex(key, removed ? 1 : 0) + offset;
+                EmitChild((removed ? "_" : "") + std::to_string(index), std::move(it.value()));
+            }
+        }
+
+        void DiffChild(const std::string& key, const BasicJsonType& left, const BasicJsonType& right) {
+            BasicJsonType delta = _engine.Diff(left, right);
+            if (!delta.is_null()) {
+                EmitChild(key, std::move(delta));
+            }
+        }
+
+        void EmitChild(const std::string& key, BasicJsonType&& fragment) {
+            _path.push_back(key);
+            Emit(std::move(fragment));
+            _path.pop_back();
+        }
+
+        void Emit(BasicJsonType&& fragment) {
+            // Announce enclosing array deltas before their first entry
+            for (size_t depth = 0; depth < _path.size(); ++depth) {
+                if (_arrayMarkers[depth]) {
+                    _arrayMarkers[depth] = false;
+                    std::vector<std::string> markerPath(_path.begin(), _path.begin() + depth);
+                    markerPath.push_back("_t");
+                    _onFragment(markerPath, BasicJsonType("a"));
+                }
+            }
+            _onFragment(_path, std::move(fragment));
+            _emitted = true;
+        }
+
+        Engine& _engine;
+        const Options& _options;
+        JsonReader<BasicJsonType, InputAdapter> _left;
+        JsonReader<BasicJsonType, InputAdapter> _right;
+        const typename Engine::DeltaFragmentHandler& _onFragment;
+
+        // _arrayMarkers[d] is set while the container at path depth d is an array whose
+        // "_t" marker has not been emitted yet
+        std::vector<std::string> _path;
+        std::vector<bool> _arrayMarkers;
+        bool _emitted = false;
+    };
+
+} // namespace detail
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::DiffStream(std::istream& left, std::istream& right,
+                                                   const DeltaFragmentHandler& onFragment) {
+    using Adapter = nlohmann::detail::input_stream_adapter;
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    // Taken before either stream is read
+    detail::Rescan<Adapter> leftRescan(left);
+    detail::Rescan<Adapter> rightRescan(right);
+    detail::StreamDiffer<BasicJsonType, Adapter> differ(*this, _options, Adapter(left), leftRescan,
+                                                        Adapter(right), rightRescan, onFragment);
+    return differ.Run();
+}
+
+template<typename BasicJsonType>
+bool BasicJsonDiffPatch<BasicJsonType>::DiffStream(const char* left, size_t leftLength, const char* right,
+                                                   size_t rightLength, const DeltaFragmentHandler& onFragment) {
+    using Adapter = nlohmann::detail::iterator_input_adapter<const char*>;
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    detail::StreamDiffer<BasicJsonType, Adapter> differ(
+        *this, _options, Adapter(left, left + leftLength), detail::Rescan<Adapter>(left, left + leftLength),
+        Adapter(right, right + rightLength), detail::Rescan<Adapter>(right, right + rightLength), onFragment);
+    return differ.Run();
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::DiffStream(std::istream& left, std::istream& right) {
+    BasicJsonType delta;
+    DiffStream(left, right, [&delta](const std::vector<std::string>& path, BasicJsonType&& fragment) {
+        ApplyFragment(delta, path, std::move(fragment));
+    });
+    return delta;
+}
+
+template<typename BasicJsonType>
+void BasicJsonDiffPatch<BasicJsonType>::ApplyFragment(BasicJsonType& delta, const std::vector<std::string>& path,
+                                                      BasicJsonType&& fragment) {
+    BasicJsonType* node = &delta;
+    for (const auto& key : path) {
+        if (!node->is_object()) {
+            *node = BasicJsonType::object();
+        }
+        node = &(*node)[typename BasicJsonType::string_t(key.data(), key.size())];
+    }
+    *node = std::move(fragment);
+}
+
+} // namespace JsonDiffPatch
@@ -0,0 +1,243 @@
+#pragma once
+
+// Part of JsonDiffPatchImpl.h
+
+namespace JsonDiffPatch {
+
+// The member or element of value named by token, or nullptr if there is none
+template<typename BasicJsonType>
+const BasicJsonType* BasicTrackedDocument<BasicJsonType>::Child(const BasicJsonType& value, const string_t& token) {
+    if (value.is_object()) {
+        auto it = value.find(token);
+        return it != value.end() ? &*it : nullptr;
+    }
+    size_t index;
+    if (value.is_array() && detail::PointerIndex(token, index) && index < value.size()) {
+        return &value[index];
+    }
+    return nullptr;
+}
+
+// The container holding the value the last token names
+template<typename BasicJsonType>
+BasicJsonType& BasicTrackedDocument<BasicJsonType>::Parent(const std::vector<string_t>& tokens) {
+    const BasicJsonType* value = &_value;
+    for (size_t i = 0; i + 1 < tokens.size() && value; ++i) {
+        value = Child(*value, tokens[i]);
+    }
+    if (!value || !value->is_structured()) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+    return const_cast<BasicJsonType&>(*value);
+}
+
+// Records the value at the first count tokens as changed, keeping its snapshot value, unless
+// it or one of its ancestors already is. Called before the value is changed.
+template<typename BasicJsonType>
+void BasicTrackedDocument<BasicJsonType>::Capture(const std::vector<string_t>& tokens, size_t count) {
+    Node* node = &_root;
+    const BasicJsonType* value = &_value;
+    for (size_t i = 0; i < count && !node->captured; ++i) {
+        // Callers validated the path, so array indices are canonical keys
+        auto& child = node->children[tokens[i]];
+        if (!child) {
+            child = std::make_unique<Node>();
+        }
+        node = child.get();
+        value = value ? Child(*value, tokens[i]) : nullptr;
+    }
+    if (node->captured) {
+        return;
+    }
+
+    node->existed = value != nullptr;
+    if (value) {
+        node->original = *value;
+        Restore(node->original, *node);
+    }
+    node->children.clear();
+    node->captured = true;
+}
+
+// Puts the snapshot values recorded below node back into value, its current counterpart
+template<typename BasicJsonType>
+void BasicTrackedDocument<BasicJsonType>::Restore(BasicJsonType& value, const Node& node) {
+    for (const auto& entry : node.children) {
+        const string_t& key = entry.first;
+        const Node& child = *entry.second;
+        if (!child.captured) {
+            if (const BasicJsonType* current = Child(value, key)) {
+                Restore(const_cast<BasicJsonType&>(*current), child);
+            }
+        } else if (!child.existed) {
+            value.erase(key);
+        } else if (value.is_array()) {
+            value[detail::ParseIndex(key, 0)] = child.original;
+        } else {
+            value[key] = child.original;
+        }
+    }
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicTrackedDocument<BasicJsonType>::Snapshot() const {
+    if (_root.captured) {
+        return _root.original;
+    }
+    BasicJsonType snapshot = _value;
+    Restore(snapshot, _root);
+    return snapshot;
+}
+
+template<typename BasicJsonType>
+void BasicTrackedDocument<BasicJsonType>::Set(const json_pointer& path, BasicJsonType value) {
+    std::vector<string_t> tokens = detail::PointerTokens<BasicJsonType>(path);
+    if (tokens.empty()) {
+        Capture(tokens, 0);
+        _value = std::move(value);
+        return;
+    }
+
+    BasicJsonType& parent = Parent(tokens);
+    if (parent.is_object()) {
+        Capture(tokens, tokens.size());
+        parent[tokens.back()] = std::move(value);
+        return;
+    }
+
+    size_t index;
+    if (!detail::PointerIndex(tokens.back(), index) || index >= parent.size()) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+    Capture(tokens, tokens.size());
+    parent[index] = std::move(value);
+}
+
+template<typename BasicJsonType>
+bool BasicTrackedDocument<BasicJsonType>::Erase(const json_pointer& path) {
+    std::vector<string_t> tokens = detail::PointerTokens<BasicJsonType>(path);
+    if (tokens.empty()) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+
+    BasicJsonType& parent = Parent(tokens);
+    if (parent.is_object()) {
+        if (!parent.contains(tokens.back())) {
+            return false;
+        }
+        Capture(tokens, tokens.size());
+        parent.erase(tokens.back());
+        return true;
+    }
+
+    size_t index;
+    if (!detail::PointerIndex(tokens.back(), index) || index >= parent.size()) {
+        return false;
+    }
+    Capture(tokens, tokens.size() - 1);
+    parent.erase(index);
+    return true;
+}
+
+template<typename BasicJsonType>
+void BasicTrackedDocument<BasicJsonType>::Insert(const json_pointer& path, BasicJsonType value) {
+    std::vector<string_t> tokens = detail::PointerTokens<BasicJsonType>(path);
+    if (tokens.empty()) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+
+    BasicJsonType& parent = Parent(tokens);
+    size_t index = parent.size();
+    if (!parent.is_array() || (tokens.back() != "-" && (!detail::PointerIndex(tokens.back(), index) || index > parent.size()))) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+    Capture(tokens, tokens.size() - 1);
+    parent.insert(parent.begin() + static_cast<std::ptrdiff_t>(index), std::move(value));
+}
+
+template<typename BasicJsonType>
+BasicJsonType& BasicTrackedDocument<BasicJsonType>::Edit(const json_pointer& path) {
+    std::vector<string_t> tokens = detail::PointerTokens<BasicJsonType>(path);
+    if (tokens.empty()) {
+        Capture(tokens, 0);
+        return _value;
+    }
+
+    BasicJsonType& parent = Parent(tokens);
+    if (parent.is_object()) {
+        Capture(tokens, tokens.size());
+        return parent[tokens.back()];
+    }
+
+    size_t index;
+    if (!detail::PointerIndex(tokens.back(), index) || index >= parent.size()) {
+        throw std::invalid_argument("Invalid tracked document path");
+    }
+    Capture(tokens, tokens.size());
+    return parent[index];
+}
+
+// Delta of one trie node. Captured nodes are diffed like ObjectDiff treats a member; the
+// others are walked, since only their changed children can differ. Arrays whose elements
+// the engine does not diff one by one (simple mode, ObjectHash) are diffed whole.
+template<typename BasicJsonType>
+BasicJsonType BasicTrackedDocument<BasicJsonType>::DiffNode(BasicJsonDiffPatch<BasicJsonType>& engine,
+                                                            const Node& node, const BasicJsonType* current) {
+    if (node.captured) {
+        if (!node.existed) {
+            return current ? BasicJsonType::array({ *current }) : BasicJsonType(nullptr);
+        }
+        if (!current) {
+            return BasicJsonType::array({ node.original, 0, OP_DELETED });
+        }
+        return engine.Diff(node.original, *current);
+    }
+
+    if (node.children.empty()) {
+        return BasicJsonType(nullptr);
+    }
+
+    if (current->is_array() && (engine._options.ArrayDiff != MODE_EFFICIENT || engine._options.ObjectHash)) {
+        BasicJsonType snapshot = *current;
+        Restore(snapshot, node);
+        return engine.Diff(snapshot, *current);
+    }
+
+    BasicJsonType delta;
+    if (current->is_array()) {
+        // Indices in ascending order, as ArrayDiff writes them
+        std::vector<std::pair<size_t, const Node*>> children;
+        for (const auto& entry : node.children) {
+            children.emplace_back(detail::ParseIndex(entry.first, 0), entry.second.get());
+        }
+        std::sort(children.begin(), children.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& child : children) {
+            BasicJsonType childDelta = DiffNode(engine, *child.second, &(*current)[child.first]);
+            if (!childDelta.is_null()) {
+                if (delta.is_null()) {
+                    delta["_t"] = "a";
+                }
+                delta[detail::IndexKey<BasicJsonType>(child.first)] = std::move(childDelta);
+            }
+        }
+        return delta;
+    }
+
+    for (const auto& entry : node.children) {
+        BasicJsonType childDelta = DiffNode(engine, *entry.second, Child(*current, entry.first));
+        if (!childDelta.is_null()) {
+            delta[entry.first] = std::move(childDelta);
+        }
+    }
+    return delta;
+}
+
+template<typename BasicJsonType>
+BasicJsonType BasicJsonDiffPatch<BasicJsonType>::Diff(const BasicTrackedDocument<BasicJsonType>& document) {
+    detail::ScratchScope scratch(_options.ScratchResource);
+    detail::StatsScope stats(_stats.stats, &DiffStats::DiffNs);
+    return BasicTrackedDocument<BasicJsonType>::DiffNode(*this, document._root, &document._value);
+}
+
+} // namespace JsonDiffPatch
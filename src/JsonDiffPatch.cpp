@@ -1,35 +1,16 @@
-#include "../include/JsonDiffPatch/JsonDiffPatch.h"
+#include "../include/JsonDiffPatch/JsonDiffPatchImpl.h"
+#include "WorkerPool.h"
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <cctype>
+#include <chrono>
+#include <unordered_map>
 
 namespace JsonDiffPatch {
 
-// ItemMatch implementation
-bool ItemMatch::Match(const json& obj1, const json& obj2) const {
-    if (ObjectHash && obj1.is_object()) {
-        std::string hash1 = ObjectHash(obj1);
-        std::string hash2 = ObjectHash(obj2);
-        return !hash1.empty() && !hash2.empty() && hash1 == hash2;
-    }
-    return obj1 == obj2;
-}
-
-bool ItemMatch::MatchArrayElement(const json& obj1, int index1, const json& obj2, int index2) const {
-    if (ObjectHash) {
-        return Match(obj1, obj2);
-    }
-    
-    if (!obj1.is_object() && !obj1.is_array()) {
-        return obj1 == obj2;
-    }
-    
-    return index1 == index2;
-}
-
 // SimpleTextDiff implementation
 std::vector<TextDiff> SimpleTextDiff::ComputeDiff(const std::string& text1, const std::string& text2) {
     std::vector<TextDiff> diffs;
@@ -213,764 +194,927 @@ std::pair<std::string, std::vector<bool>> SimpleTextDiff::ApplyPatches(const std
     return std::make_pair(result, results);
 }
 
-// LCS implementation
-LcsResult JsonDiffPatch::ComputeLcs(const std::vector<json>& left, const std::vector<json>& right, const ItemMatch& match) {
-    size_t m = left.size();
-    size_t n = right.size();
-    
-    // Create LCS matrix
-    std::vector<std::vector<int>> matrix(m + 1, std::vector<int>(n + 1, 0));
-    
-    for (size_t i = 1; i <= m; ++i) {
-        for (size_t j = 1; j <= n; ++j) {
-            if (match.MatchArrayElement(left[i-1], static_cast<int>(i-1), right[j-1], static_cast<int>(j-1))) {
-                matrix[i][j] = matrix[i-1][j-1] + 1;
-            } else {
-                matrix[i][j] = (std::max)(matrix[i-1][j], matrix[i][j-1]);
-            }
-        }
-    }
-    
-    // Backtrack to find the LCS
-    LcsResult result;
-    int i = static_cast<int>(m), j = static_cast<int>(n);
-    
-    while (i > 0 && j > 0) {
-        if (match.Match(left[i-1], right[j-1])) {
-            result.Sequence.insert(result.Sequence.begin(), left[i-1]);
-            result.Indices1.insert(result.Indices1.begin(), i-1);
-            result.Indices2.insert(result.Indices2.begin(), j-1);
-            --i;
-            --j;
-        } else if (matrix[i][j-1] > matrix[i-1][j]) {
-            --j;
-        } else {
-            --i;
-        }
-    }
-    
-    return result;
+DiffStats& DiffStats::operator+=(const DiffStats& other) {
+    NodesVisited += other.NodesVisited;
+    LcsArrays += other.LcsArrays;
+    LcsCells += other.LcsCells;
+    HashCalls += other.HashCalls;
+    TextDiffs += other.TextDiffs;
+    ValuesCopied += other.ValuesCopied;
+    ScratchGrowths += other.ScratchGrowths;
+    ParseNs += other.ParseNs;
+    DiffNs += other.DiffNs;
+    TextDiffNs += other.TextDiffNs;
+    PatchNs += other.PatchNs;
+    SerializeNs += other.SerializeNs;
+    return *this;
 }
 
-// JsonDiffPatch main implementation
-json JsonDiffPatch::Diff(const json& left, const json& right) {
-    ItemMatch itemMatch(_options.ObjectHash);
-    
-    json leftValue = left.is_null() ? json("") : left;
-    json rightValue = right.is_null() ? json("") : right;
-    
-    if (leftValue.is_object() && rightValue.is_object()) {
-        return ObjectDiff(leftValue, rightValue);
-    }
-    
-    if (_options.ArrayDiff == MODE_EFFICIENT && 
-        leftValue.is_array() && rightValue.is_array()) {
-        return ArrayDiff(leftValue, rightValue);
+// Engine instantiations; the definitions live in JsonDiffPatchImpl.h
+template class BasicItemMatch<nlohmann::json>;
+template class BasicItemMatch<nlohmann::ordered_json>;
+template class BasicBinaryDelta<nlohmann::json>;
+template class BasicBinaryDelta<nlohmann::ordered_json>;
+template class BasicDeltaView<nlohmann::json>;
+template class BasicDeltaView<nlohmann::ordered_json>;
+template class BasicJsonDiffPatch<nlohmann::json>;
+template class BasicJsonDiffPatch<nlohmann::ordered_json>;
+template class BasicDiffSession<nlohmann::json>;
+template class BasicDiffSession<nlohmann::ordered_json>;
+template class BasicTrackedDocument<nlohmann::json>;
+template class BasicTrackedDocument<nlohmann::ordered_json>;
+template class BasicDeltaCache<nlohmann::json>;
+template class BasicDeltaCache<nlohmann::ordered_json>;
+
+} // namespace JsonDiffPatch
+
+struct JDP_Instance {
+    JsonDiffPatch::JsonDiffPatch engine;
+    std::string result;
+    JsonDiffPatch::DiffStats stats;   // of the last call, see JDP_GetLastStats
+
+    // Batch scratch, kept between calls
+    std::vector<JsonDiffPatch::JsonDiffPatch> workers;
+    std::vector<JsonDiffPatch::DiffStats> workerStats;   // one sink per worker, added to stats
+    std::vector<std::string> batchResults;
+    std::vector<int> batchStatuses;
+    size_t batchCount = 0;
+    bool batchRetained = false;       // the last batch did not fit its arena, see JDP_TakeBatchResults
+
+    explicit JDP_Instance(const JsonDiffPatch::Options& options) : engine(options) {
+        engine.SetStats(&stats);
     }
-    
-    if (_options.TextDiff == TEXTDIFF_EFFICIENT &&
-        leftValue.is_string() && rightValue.is_string()) {
-        std::string leftStr = leftValue.get<std::string>();
-        std::string rightStr = rightValue.get<std::string>();
-        
-        if (leftStr.length() > _options.MinEfficientTextDiffLength || 
-            rightStr.length() > _options.MinEfficientTextDiffLength) {
-            auto patches = SimpleTextDiff::CreatePatches(leftStr, rightStr);
-            if (!patches.empty()) {
-                json result = json::array();
-                result.push_back(SimpleTextDiff::PatchesToText(patches));
-                result.push_back(0);
-                result.push_back(OP_TEXTDIFF);
-                return result;
-            }
+
+    JDP_Instance(const JDP_Instance&) = delete;
+    JDP_Instance& operator=(const JDP_Instance&) = delete;
+};
+
+namespace {
+
+    // Resolves a handle (NULL: the calling thread's default instance, whose engine keeps its
+    // scratch buffers between calls) and clears the statistics of its previous call
+    JDP_Instance& StartCall(JDP_Handle handle);
+
+}
+
+// C API implementation
+extern "C" {
+
+    static thread_local std::string g_lastResult;
+
+    const char* JDP_Diff(const char* json_left, const char* json_right)
+    {
+        try {
+            StartCall(nullptr).engine.DiffText(json_left, json_left ? std::strlen(json_left) : 0,
+                                               json_right, json_right ? std::strlen(json_right) : 0, g_lastResult);
+            // always return at least ""
+            return g_lastResult.c_str();
+        }
+        catch (...) {
+            g_lastResult.clear();
+            return g_lastResult.c_str();
         }
     }
-    
-    if (!itemMatch.Match(leftValue, rightValue)) {
-        json result = json::array();
-        result.push_back(leftValue);
-        result.push_back(rightValue);
-        return result;
-    }
-    
-    return json(nullptr);
-}
 
-json JsonDiffPatch::ObjectDiff(const json& left, const json& right) {
-    json diffPatch = json::object();
-    
-    // Find properties modified or deleted
-    for (auto it = left.begin(); it != left.end(); ++it) {
-        const std::string& key = it.key();
-        const json& leftValue = it.value();
-        
-        if (right.contains(key)) {
-            json d = Diff(leftValue, right[key]);
-            if (!d.is_null()) {
-                diffPatch[key] = d;
-            }
-        } else {
-            // Property deleted
-            json deleteArray = json::array();
-            deleteArray.push_back(leftValue);
-            deleteArray.push_back(0);
-            deleteArray.push_back(OP_DELETED);
-            diffPatch[key] = deleteArray;
+    const char* JDP_Patch(const char* json_left, const char* patch_json)
+    {
+        try {
+            g_lastResult = StartCall(nullptr).engine.Patch(
+                json_left ? std::string(json_left) : std::string(),
+                patch_json ? std::string(patch_json) : std::string());
+            return g_lastResult.c_str();
+        }
+        catch (...) {
+            g_lastResult.clear();
+            return g_lastResult.c_str();
         }
     }
-    
-    // Find properties that were added
-    for (auto it = right.begin(); it != right.end(); ++it) {
-        const std::string& key = it.key();
-        const json& rightValue = it.value();
-        
-        if (!left.contains(key)) {
-            json addArray = json::array();
-            addArray.push_back(rightValue);
-            diffPatch[key] = addArray;
+
+    const char* JDP_Unpatch(const char* json_right, const char* patch_json)
+    {
+        try {
+            g_lastResult = StartCall(nullptr).engine.Unpatch(
+                json_right ? std::string(json_right) : std::string(),
+                patch_json ? std::string(patch_json) : std::string());
+            return g_lastResult.c_str();
+        }
+        catch (...) {
+            g_lastResult.clear();
+            return g_lastResult.c_str();
         }
     }
-    
-    return diffPatch.empty() ? json(nullptr) : diffPatch;
+
+    void JDP_FreeString(const char*) {}
+
 }
 
-json JsonDiffPatch::ArrayDiff(const json& left, const json& right) {
-    ItemMatch itemMatch(_options.ObjectHash);
-    json result = json::object();
-    result["_t"] = "a";
-    
-    if (left == right) {
-        return json(nullptr);
+namespace {
+
+    using JsonDiffPatch::DiffStats;
+    using JsonDiffPatch::Options;
+
+    int ParseModeOption(const json& value, int simple, int efficient) {
+        if (value.is_string()) {
+            const std::string& mode = value.get_ref<const std::string&>();
+            if (mode == "simple") return simple;
+            if (mode == "efficient") return efficient;
+            throw std::runtime_error("Invalid mode option");
+        }
+        return value.get<int>() == simple ? simple : efficient;
     }
-    
-    std::vector<json> leftVec = left.get<std::vector<json>>();
-    std::vector<json> rightVec = right.get<std::vector<json>>();
-    
-    // Handle case where arrays have same length - check for simple replacements first
-    if (leftVec.size() == rightVec.size()) {
-        bool hasChanges = false;
-        
-        for (size_t i = 0; i < leftVec.size(); ++i) {
-            if (!itemMatch.Match(leftVec[i], rightVec[i])) {
-                // Check if this is a simple replacement vs nested change
-                json childDiff = Diff(leftVec[i], rightVec[i]);
-                if (!childDiff.is_null()) {
-                    if (childDiff.is_array() && childDiff.size() == 2) {
-                        // Simple replacement: [old_value, new_value]
-                        result[std::to_string(i)] = childDiff;
-                    } else {
-                        // Nested change (object diff, etc.)
-                        result[std::to_string(i)] = childDiff;
-                    }
-                    hasChanges = true;
-                }
-            }
+
+    Options ParseOptions(const char* options_json) {
+        Options options;
+        if (!options_json || !*options_json) {
+            return options;
         }
-        
-        if (!hasChanges) {
-            return json(nullptr);
+
+        json config = json::parse(options_json);
+        if (config.is_null()) {
+            return options;
         }
-        
-        // Check if result is empty (only contains "_t")
-        if (result.size() == 1 && result.contains("_t")) {
-            return json(nullptr);
+        if (!config.is_object()) {
+            throw std::runtime_error("Options must be an object");
         }
-        
-        return result;
-    }
-    
-    // For different length arrays, use the existing LCS-based approach
-    size_t commonHead = 0;
-    size_t commonTail = 0;
-    
-    // Find common head
-    while (commonHead < leftVec.size() && commonHead < rightVec.size() &&
-           itemMatch.MatchArrayElement(leftVec[commonHead], static_cast<int>(commonHead), 
-                                     rightVec[commonHead], static_cast<int>(commonHead))) {
-        json child = Diff(leftVec[commonHead], rightVec[commonHead]);
-        if (!child.is_null()) {
-            result[std::to_string(commonHead)] = child;
+
+        if (config.contains("arrayDiff")) {
+            options.ArrayDiff = ParseModeOption(config["arrayDiff"],
+                JsonDiffPatch::MODE_SIMPLE, JsonDiffPatch::MODE_EFFICIENT);
         }
-        commonHead++;
-    }
-    
-    // Find common tail
-    while (commonTail + commonHead < leftVec.size() && 
-           commonTail + commonHead < rightVec.size() &&
-           itemMatch.MatchArrayElement(leftVec[leftVec.size() - 1 - commonTail], 
-                                     static_cast<int>(leftVec.size() - 1 - commonTail),
-                                     rightVec[rightVec.size() - 1 - commonTail], 
-                                     static_cast<int>(rightVec.size() - 1 - commonTail))) {
-        size_t index1 = leftVec.size() - 1 - commonTail;
-        size_t index2 = rightVec.size() - 1 - commonTail;
-        json child = Diff(leftVec[index1], rightVec[index2]);
-        if (!child.is_null()) {
-            result[std::to_string(index2)] = child;
-        }
-        commonTail++;
-    }
-    
-    // Handle simple cases
-    if (commonHead + commonTail == leftVec.size()) {
-        // Block was added
-        for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
-            json addArray = json::array();
-            addArray.push_back(rightVec[index]);
-            result[std::to_string(index)] = addArray;
+        if (config.contains("textDiff")) {
+            options.TextDiff = ParseModeOption(config["textDiff"],
+                JsonDiffPatch::TEXTDIFF_SIMPLE, JsonDiffPatch::TEXTDIFF_EFFICIENT);
         }
-        return result;
-    }
-    
-    if (commonHead + commonTail == rightVec.size()) {
-        // Block was removed
-        for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
-            json deleteArray = json::array();
-            deleteArray.push_back(leftVec[index]);
-            deleteArray.push_back(0);
-            deleteArray.push_back(OP_DELETED);
-            result["_" + std::to_string(index)] = deleteArray;
+        if (config.contains("minEfficientTextDiffLength")) {
+            options.MinEfficientTextDiffLength = config["minEfficientTextDiffLength"].get<size_t>();
         }
-        return result;
-    }
-    
-    // Complex diff using LCS
-    std::vector<json> trimmedLeft(leftVec.begin() + commonHead, leftVec.end() - commonTail);
-    std::vector<json> trimmedRight(rightVec.begin() + commonHead, rightVec.end() - commonTail);
-    
-    LcsResult lcs = ComputeLcs(trimmedLeft, trimmedRight, itemMatch);
-    
-    // Mark deletions
-    for (size_t index = commonHead; index < leftVec.size() - commonTail; ++index) {
-        bool found = false;
-        for (int lcsIndex : lcs.Indices1) {
-            if (lcsIndex == static_cast<int>(index - commonHead)) {
-                found = true;
-                break;
-            }
+        if (config.contains("detectMove")) {
+            options.DiffArrayOptions.DetectMove = config["detectMove"].get<bool>();
         }
-        
-        if (!found) {
-            json deleteArray = json::array();
-            deleteArray.push_back(leftVec[index]);
-            deleteArray.push_back(0);
-            deleteArray.push_back(OP_DELETED);
-            result["_" + std::to_string(index)] = deleteArray;
+        if (config.contains("includeValueOnMove")) {
+            options.DiffArrayOptions.IncludeValueOnMove = config["includeValueOnMove"].get<bool>();
         }
-    }
-    
-    // Mark additions and modifications
-    for (size_t index = commonHead; index < rightVec.size() - commonTail; ++index) {
-        auto it = std::find(lcs.Indices2.begin(), lcs.Indices2.end(), 
-                           static_cast<int>(index - commonHead));
-        
-        if (it == lcs.Indices2.end()) {
-            // Added
-            json addArray = json::array();
-            addArray.push_back(rightVec[index]);
-            result[std::to_string(index)] = addArray;
-        } else {
-            // Potentially modified
-            size_t lcsIdx = std::distance(lcs.Indices2.begin(), it);
-            size_t leftIndex = lcs.Indices1[lcsIdx] + commonHead;
-            
-            json diff = Diff(leftVec[leftIndex], rightVec[index]);
-            if (!diff.is_null()) {
-                result[std::to_string(index)] = diff;
+        if (config.contains("scratchArena") && config["scratchArena"].get<bool>()) {
+            options.ScratchResource = std::pmr::new_delete_resource();
+        }
+        if (config.contains("objectHash")) {
+            // FFI callers cannot pass a callback, so the hash is built from the
+            // values of the listed properties (empty if none of them is present)
+            std::vector<std::string> keys;
+            const json& hashKeys = config["objectHash"];
+            if (hashKeys.is_string()) {
+                keys.push_back(hashKeys.get<std::string>());
+            } else {
+                keys = hashKeys.get<std::vector<std::string>>();
+            }
+            if (!keys.empty()) {
+                options.ObjectHash = [keys](const json& obj) {
+                    std::string hash;
+                    for (const auto& key : keys) {
+                        auto it = obj.find(key);
+                        if (it != obj.end()) {
+                            hash += key;
+                            hash += '=';
+                            hash += it->dump();
+                            hash += ';';
+                        }
+                    }
+                    return hash;
+                };
             }
         }
+
+        return options;
     }
-    
-    // Check if result is empty (only contains "_t")
-    if (result.size() == 1 && result.contains("_t")) {
-        return json(nullptr);
+
+    // stats, if given, receives the time as ParseNs / SerializeNs
+    json ParseInput(const char* text, const json& fallback, DiffStats* stats = nullptr) {
+        JsonDiffPatch::detail::StatsScope scope(stats, &DiffStats::ParseNs);
+        return (text && *text) ? json::parse(text) : fallback;
     }
-    
-    return result;
-}
 
-json JsonDiffPatch::Patch(const json& left, const json& patch) {
-    if (patch.is_null()) {
-        return left;
+    json ParseInput(const char* text, size_t length, const json& fallback, DiffStats* stats = nullptr) {
+        JsonDiffPatch::detail::StatsScope scope(stats, &DiffStats::ParseNs);
+        return (text && length > 0) ? json::parse(text, text + length) : fallback;
     }
-    
-    if (patch.is_object()) {
-        if (left.is_array() && patch.contains("_t") && 
-            patch["_t"].is_string() && patch["_t"].get<std::string>() == "a") {
-            return ArrayPatch(left, patch);
+
+    // Serializes into an existing buffer so its capacity is reused between calls
+    void DumpInto(const json& value, std::string& out, DiffStats* stats = nullptr) {
+        JsonDiffPatch::detail::StatsScope scope(stats, &DiffStats::SerializeNs);
+        out.clear();
+        if (value.is_null()) {
+            return;
         }
-        return ObjectPatch(left, patch);
+        nlohmann::detail::serializer<json> serializer(
+            nlohmann::detail::output_adapter<char>(out), ' ');
+        serializer.dump(value, false, false, 0);
     }
-    
-    if (patch.is_array()) {
-        json patchArray = patch;
-        
-        if (patchArray.size() == 1) {
-            // Add
-            return patchArray[0];
-        }
-        
-        if (patchArray.size() == 2) {
-            // Replace
-            return patchArray[1];
-        }
-        
-        if (patchArray.size() == 3) {
-            // Delete, Move or TextDiff
-            if (!patchArray[2].is_number_integer()) {
-                throw std::runtime_error("Invalid patch object");
-            }
-            
-            int op = patchArray[2].get<int>();
-            
-            if (op == 0) {
-                return json(nullptr);
+
+    // Output adapter writing into a fixed caller buffer; keeps counting past the
+    // end so the required size is known even when the buffer is too small
+    class SpanOutputAdapter : public nlohmann::detail::output_adapter_protocol<char> {
+    public:
+        SpanOutputAdapter(char* out, size_t cap) : _out(out), _cap(cap) {}
+
+        void write_character(char c) override {
+            if (_size < _cap) {
+                _out[_size] = c;
             }
-            
-            if (op == OP_TEXTDIFF) {
-                if (!left.is_string()) {
-                    throw std::runtime_error("Invalid patch object");
-                }
-                
-                std::string patchText = patchArray[0].get<std::string>();
-                auto patches = SimpleTextDiff::PatchesFromText(patchText);
-                
-                if (patches.empty()) {
-                    throw std::runtime_error("Invalid textline");
-                }
-                
-                auto result = SimpleTextDiff::ApplyPatches(patches, left.get<std::string>());
-                
-                for (size_t i = 0; i < result.second.size(); ++i) {
-                    bool success = result.second[i];
-                    if (!success) {
-                        throw std::runtime_error("Text patch failed");
-                    }
-                }
-                
-                return json(result.first);
+            ++_size;
+        }
+
+        void write_characters(const char* s, std::size_t length) override {
+            if (_size < _cap) {
+                std::memcpy(_out + _size, s, (std::min)(length, _cap - _size));
             }
-            
-            throw std::runtime_error("Invalid patch object");
+            _size += length;
         }
-        
-        throw std::runtime_error("Invalid patch object");
+
+        size_t size() const { return _size; }
+
+    private:
+        char* _out;
+        size_t _cap;
+        size_t _size = 0;
+    };
+
+    int DumpInto(const json& value, char* out, size_t cap, size_t* needed, DiffStats* stats = nullptr) {
+        JsonDiffPatch::detail::StatsScope scope(stats, &DiffStats::SerializeNs);
+        size_t length = 0;
+        if (!value.is_null()) {
+            auto adapter = std::make_shared<SpanOutputAdapter>(out, cap);
+            nlohmann::detail::serializer<json> serializer(adapter, ' ');
+            serializer.dump(value, false, false, 0);
+            length = adapter->size();
+        }
+
+        if (needed) *needed = length;
+        if (!out || cap <= length) {
+            return JDP_ERROR_BUFFER_TOO_SMALL;
+        }
+        out[length] = '\0';
+        return JDP_OK;
     }
-    
-    return json(nullptr);
+
+    int FailInto(char* out, size_t cap, size_t* needed) {
+        if (needed) *needed = 0;
+        if (out && cap > 0) out[0] = '\0';
+        return JDP_ERROR;
+    }
+
 }
 
-json JsonDiffPatch::ObjectPatch(const json& obj, const json& patch) {
-    json target = obj.is_null() ? json::object() : obj;
-    
-    if (patch.is_null()) {
-        return target;
+struct JDP_Document {
+    json value;
+    std::string text;
+    bool hasText = false;
+
+    explicit JDP_Document(json documentValue) : value(std::move(documentValue)) {}
+};
+
+// The session points into left and right, so they are declared first and the struct stays put
+struct JDP_DiffSession {
+    json left;
+    json right;
+    JsonDiffPatch::DiffSession session;
+    json delta;
+    bool finished = false;
+
+    JDP_DiffSession(JsonDiffPatch::JsonDiffPatch& engine, json leftValue, json rightValue)
+        : left(std::move(leftValue)), right(std::move(rightValue)), session(engine.BeginDiff(left, right)) {}
+
+    JDP_DiffSession(const JDP_DiffSession&) = delete;
+    JDP_DiffSession& operator=(const JDP_DiffSession&) = delete;
+};
+
+namespace {
+
+    enum class Operation { Diff, Patch, Unpatch };
+
+    json Run(JsonDiffPatch::JsonDiffPatch& engine, Operation op,
+             const char* first, size_t firstLen, const char* second, size_t secondLen) {
+        json firstJson = ParseInput(first, firstLen, json(""), engine.Stats());
+        json secondJson = ParseInput(second, secondLen, op == Operation::Diff ? json("") : json(nullptr), engine.Stats());
+        switch (op) {
+            case Operation::Diff: return engine.Diff(firstJson, secondJson);
+            case Operation::Patch: return engine.Patch(firstJson, secondJson);
+            default: return engine.Unpatch(firstJson, secondJson);
+        }
     }
-    
-    for (auto it = patch.begin(); it != patch.end(); ++it) {
-        const std::string& key = it.key();
-        const json& patchValue = it.value();
-        
-        // Check for deletion
-        if (patchValue.is_array() && patchValue.size() == 3 && 
-            patchValue[2].is_number_integer() && patchValue[2].get<int>() == 0) {
-            target.erase(key);
-        } else {
-            if (target.contains(key)) {
-                target[key] = Patch(target[key], patchValue);
-            } else {
-                target[key] = Patch(json(nullptr), patchValue);
-            }
+
+    JDP_Instance& ResolveInstance(JDP_Handle handle) {
+        static thread_local JDP_Instance defaults{ Options() };
+        return handle ? *handle : defaults;
+    }
+
+    JDP_Instance& StartCall(JDP_Handle handle) {
+        JDP_Instance& instance = ResolveInstance(handle);
+        instance.stats.Reset();
+        return instance;
+    }
+
+    // Lays the results of the instance's last batch out back to back, each followed by a NUL.
+    // Results that do not fit are kept for JDP_TakeBatchResults.
+    int CopyBatchResults(JDP_Instance& instance, char* arena, size_t arenaCap, size_t* offsets,
+                         size_t* lengths, int* statuses, size_t* needed) {
+        const auto& results = instance.batchResults;
+        size_t total = 0;
+        for (size_t i = 0; i < instance.batchCount; ++i) {
+            offsets[i] = total;
+            lengths[i] = results[i].size();
+            if (statuses) statuses[i] = instance.batchStatuses[i];
+            total += results[i].size() + 1;
+        }
+        if (needed) *needed = total;
+        instance.batchRetained = !arena || arenaCap < total;
+        if (instance.batchRetained) {
+            return JDP_ERROR_BUFFER_TOO_SMALL;
         }
+        for (size_t i = 0; i < instance.batchCount; ++i) {
+            std::memcpy(arena + offsets[i], results[i].data(), lengths[i]);
+            arena[offsets[i] + lengths[i]] = '\0';
+        }
+        return JDP_OK;
     }
-    
-    return target;
-}
 
-json JsonDiffPatch::ArrayPatch(const json& left, const json& patch) {
-    // Expect: patch has "_t":"a"
-    std::vector<json> arr = left.get<std::vector<json>>();
-
-    struct Removal { size_t index; bool isMove; size_t moveTarget; };
-    struct Modification { size_t index; json value; };
-    struct Insertion { size_t index; json value; bool isMove; };
-
-    std::vector<Removal> removals;
-    std::vector<Modification> modifications;
-    std::vector<Insertion> insertions;
-
-    // Classify ops
-    for (auto it = patch.begin(); it != patch.end(); ++it) {
-        const std::string& key = it.key();
-        if (key == "_t") continue;
-
-        const json& v = it.value();
-        if (!key.empty() && key[0] == '_') {
-            // deletion or move-out
-            size_t idx = std::stoul(key.substr(1));
-            if (v.is_array() && v.size() == 3) {
-                int op = v[2].get<int>();
-                if (op == OP_DELETED) {
-                    removals.push_back({ idx, false, 0 });
-                }
-                else if (op == OP_ARRAYMOVE) {
-                    // jsondiffpatch encodes move as ["<val>", toIndex, 3]
-                    size_t to = v[1].get<size_t>();
-                    removals.push_back({ idx, true, to });
+    int RunBatch(JDP_Handle handle, Operation op, const JDP_Span* first, const JDP_Span* second,
+                 size_t count, char* arena, size_t arenaCap, size_t* offsets, size_t* lengths,
+                 int* statuses, size_t* needed, int parallel) {
+        if (count > 0 && (!first || !second || !offsets || !lengths)) {
+            return JDP_ERROR;
+        }
+
+        JDP_Instance& instance = StartCall(handle);
+        auto& results = instance.batchResults;
+        auto& itemStatuses = instance.batchStatuses;
+        if (results.size() < count) results.resize(count);
+        itemStatuses.assign(count, JDP_OK);
+
+        auto runItem = [&](size_t i, JsonDiffPatch::JsonDiffPatch& engine) {
+            try {
+                DumpInto(Run(engine, op, first[i].data, first[i].size, second[i].data, second[i].size),
+                         results[i], engine.Stats());
+            }
+            catch (...) {
+                results[i].clear();
+                itemStatuses[i] = JDP_ERROR;
+            }
+        };
+
+        if (parallel && count > 1) {
+            auto& pool = JsonDiffPatch::detail::WorkerPool::Shared();
+            if (instance.workers.size() + 1 < pool.MaxSlots()) {
+                instance.workers.assign(pool.MaxSlots() - 1, instance.engine);
+                // Copies of an engine start without a sink
+                instance.workerStats.assign(instance.workers.size(), JsonDiffPatch::DiffStats());
+                for (size_t w = 0; w < instance.workers.size(); ++w) {
+                    instance.workers[w].SetStats(&instance.workerStats[w]);
                 }
             }
-        }
-        else {
-            // addition or modification
-            size_t idx = std::stoul(key);
-            if (v.is_array() && v.size() == 1) {
-                insertions.push_back({ idx, v[0], false });
+            for (auto& stats : instance.workerStats) {
+                stats.Reset();
             }
-            else if (v.is_array() && v.size() == 3 && v[2].is_number_integer()
-                && v[2].get<int>() == OP_ARRAYMOVE) {
-                // (rare form) move encoded on positive key
-                size_t to = v[1].get<size_t>();
-                // treat as: remove from '_' + fromIndex and insert at to
-                // if you ever generate this form, you’d need the "from"; most diffs use the '_' key form.
-                insertions.push_back({ to, v[0], true });
+            pool.ParallelFor(count, [&](size_t i, size_t slot) {
+                runItem(i, slot == 0 ? instance.engine : instance.workers[slot - 1]);
+            });
+            for (const auto& stats : instance.workerStats) {
+                instance.stats += stats;
             }
-            else {
-                modifications.push_back({ idx, v });
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                runItem(i, instance.engine);
             }
         }
+
+        instance.batchCount = count;
+        return CopyBatchResults(instance, arena, arenaCap, offsets, lengths, statuses, needed);
     }
 
-    // 1) Apply removals (including move extraction) in DESC order
-    std::sort(removals.begin(), removals.end(),
-        [](const Removal& a, const Removal& b) { return a.index > b.index; });
+    // A queued asynchronous request; the job owns copies of its inputs
+    struct AsyncJob {
+        std::mutex mutex;
+        std::condition_variable done;
+        int status = JDP_PENDING;
+        std::string result;
+    };
 
-    // Keep a temporary store for values we move so we can reinsert later using fresh indices
-    struct PendingMove { size_t target; json value; };
-    std::vector<PendingMove> pendingMoves;
+    class AsyncJobs {
+    public:
+        JDP_Ticket Submit(JDP_Handle handle, Operation op, const char* first, size_t firstLen,
+                          const char* second, size_t secondLen) {
+            auto job = std::make_shared<AsyncJob>();
+            JsonDiffPatch::JsonDiffPatch engine = ResolveInstance(handle).engine;
+            std::string firstText = first ? std::string(first, firstLen) : std::string();
+            std::string secondText = second ? std::string(second, secondLen) : std::string();
 
-    for (const auto& r : removals) {
-        if (arr.empty()) continue;
-        size_t idx = (r.index < arr.size()) ? r.index : (arr.size() - 1);
-        json taken = arr[idx];
-        arr.erase(arr.begin() + idx);
-        if (r.isMove) {
-            pendingMoves.push_back({ r.moveTarget, taken });
+            JDP_Ticket ticket;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                ticket = ++_lastTicket;
+                _jobs.emplace(ticket, job);
+            }
+
+            bool queued = _pool.TrySubmit(
+                [job, op, engine = std::move(engine), firstText = std::move(firstText),
+                 secondText = std::move(secondText)]() mutable {
+                    std::string result;
+                    int status = JDP_OK;
+                    try {
+                        DumpInto(Run(engine, op, firstText.data(), firstText.size(),
+                                     secondText.data(), secondText.size()), result);
+                    }
+                    catch (...) {
+                        result.clear();
+                        status = JDP_ERROR;
+                    }
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->result = std::move(result);
+                    job->status = status;
+                    job->done.notify_all();
+                });
+
+            if (!queued) {
+                Erase(ticket);
+                return 0;
+            }
+            return ticket;
+        }
+
+        std::shared_ptr<AsyncJob> Find(JDP_Ticket ticket) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _jobs.find(ticket);
+            return it == _jobs.end() ? nullptr : it->second;
+        }
+
+        void Erase(JDP_Ticket ticket) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.erase(ticket);
+        }
+
+        static AsyncJobs& Instance() {
+            static AsyncJobs jobs;
+            return jobs;
+        }
+
+    private:
+        AsyncJobs()
+            : _pool((std::min)((std::max)(std::thread::hardware_concurrency(), 1u), 4u), 256) {}
+
+        std::mutex _mutex;
+        std::unordered_map<JDP_Ticket, std::shared_ptr<AsyncJob>> _jobs;
+        JDP_Ticket _lastTicket = 0;
+        JsonDiffPatch::detail::WorkerPool _pool;
+    };
+
+}
+
+extern "C" {
+
+    JDP_Handle JDP_Create(const char* options_json)
+    {
+        try {
+            return new JDP_Instance(ParseOptions(options_json));
+        }
+        catch (...) {
+            return nullptr;
         }
     }
 
-    // 2) Apply modifications in ASC order (only if index still exists)
-    std::sort(modifications.begin(), modifications.end(),
-        [](const Modification& a, const Modification& b) { return a.index < b.index; });
+    void JDP_Destroy(JDP_Handle handle)
+    {
+        delete handle;
+    }
 
-    for (const auto& m : modifications) {
-        if (m.index < arr.size()) {
-            arr[m.index] = Patch(arr[m.index], m.value);
+    const char* JDP_DiffH(JDP_Handle handle, const char* json_left, const char* json_right)
+    {
+        if (!handle) return "";
+        try {
+            StartCall(handle).engine.DiffText(json_left, json_left ? std::strlen(json_left) : 0,
+                                              json_right, json_right ? std::strlen(json_right) : 0, handle->result);
         }
+        catch (...) {
+            handle->result.clear();
+        }
+        return handle->result.c_str();
     }
 
-    // 3) Apply move insertions first (ASC), then regular insertions (ASC)
-    std::sort(pendingMoves.begin(), pendingMoves.end(),
-        [](const PendingMove& a, const PendingMove& b) { return a.target < b.target; });
+    const char* JDP_PatchH(JDP_Handle handle, const char* json_left, const char* patch_json)
+    {
+        if (!handle) return "";
+        try {
+            DiffStats* stats = &StartCall(handle).stats;
+            json leftJson = ParseInput(json_left, json(""), stats);
+            json patchJson = ParseInput(patch_json, json(nullptr), stats);
+            DumpInto(handle->engine.Patch(leftJson, patchJson), handle->result, stats);
+        }
+        catch (...) {
+            handle->result.clear();
+        }
+        return handle->result.c_str();
+    }
 
-    for (const auto& mv : pendingMoves) {
-        size_t pos = (mv.target <= arr.size()) ? mv.target : arr.size();
-        arr.insert(arr.begin() + pos, mv.value);
+    const char* JDP_UnpatchH(JDP_Handle handle, const char* json_right, const char* patch_json)
+    {
+        if (!handle) return "";
+        try {
+            DiffStats* stats = &StartCall(handle).stats;
+            json rightJson = ParseInput(json_right, json(""), stats);
+            json patchJson = ParseInput(patch_json, json(nullptr), stats);
+            DumpInto(handle->engine.Unpatch(rightJson, patchJson), handle->result, stats);
+        }
+        catch (...) {
+            handle->result.clear();
+        }
+        return handle->result.c_str();
     }
 
-    std::sort(insertions.begin(), insertions.end(),
-        [](const Insertion& a, const Insertion& b) { return a.index < b.index; });
+    int JDP_DiffN(const char* json_left, size_t left_len,
+                  const char* json_right, size_t right_len,
+                  char* out, size_t cap, size_t* needed)
+    {
+        try {
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(nullptr).engine;
+            return DumpInto(Run(engine, Operation::Diff, json_left, left_len, json_right, right_len),
+                            out, cap, needed, engine.Stats());
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
+    }
 
-    for (const auto& ins : insertions) {
-        size_t pos = (ins.index <= arr.size()) ? ins.index : arr.size();
-        arr.insert(arr.begin() + pos, ins.value);
+    int JDP_PatchN(const char* json_left, size_t left_len,
+                   const char* patch_json, size_t patch_len,
+                   char* out, size_t cap, size_t* needed)
+    {
+        try {
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(nullptr).engine;
+            return DumpInto(Run(engine, Operation::Patch, json_left, left_len, patch_json, patch_len),
+                            out, cap, needed, engine.Stats());
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
     }
 
-    return json(arr);
-}
+    int JDP_UnpatchN(const char* json_right, size_t right_len,
+                     const char* patch_json, size_t patch_len,
+                     char* out, size_t cap, size_t* needed)
+    {
+        try {
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(nullptr).engine;
+            return DumpInto(Run(engine, Operation::Unpatch, json_right, right_len, patch_json, patch_len),
+                            out, cap, needed, engine.Stats());
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
+    }
 
-json JsonDiffPatch::Unpatch(const json& right, const json& patch) {
-    if (patch.is_null()) {
-        return right;
+    int JDP_DiffBatch(JDP_Handle handle, const JDP_Span* lefts, const JDP_Span* rights,
+                      size_t count, char* arena, size_t arena_cap,
+                      size_t* offsets, size_t* lengths, int* statuses,
+                      size_t* needed, int parallel)
+    {
+        try {
+            return RunBatch(handle, Operation::Diff, lefts, rights, count, arena, arena_cap,
+                            offsets, lengths, statuses, needed, parallel);
+        }
+        catch (...) {
+            return JDP_ERROR;
+        }
     }
-    
-    if (patch.is_object()) {
-        if (right.is_array() && patch.contains("_t") && 
-            patch["_t"].is_string() && patch["_t"].get<std::string>() == "a") {
-            return ArrayUnpatch(right, patch);
+
+    int JDP_PatchBatch(JDP_Handle handle, const JDP_Span* lefts, const JDP_Span* patches,
+                       size_t count, char* arena, size_t arena_cap,
+                       size_t* offsets, size_t* lengths, int* statuses,
+                       size_t* needed, int parallel)
+    {
+        try {
+            return RunBatch(handle, Operation::Patch, lefts, patches, count, arena, arena_cap,
+                            offsets, lengths, statuses, needed, parallel);
+        }
+        catch (...) {
+            return JDP_ERROR;
         }
-        return ObjectUnpatch(right, patch);
     }
-    
-    if (patch.is_array()) {
-        json patchArray = patch;
-        
-        if (patchArray.size() == 1) {
-            // Add (we need to remove)
-            return json(nullptr);
-        }
-        
-        if (patchArray.size() == 2) {
-            // Replace
-            return patchArray[0];
-        }
-        
-        if (patchArray.size() == 3) {
-            if (!patchArray[2].is_number_integer()) {
-                throw std::runtime_error("Invalid patch object");
-            }
-            
-            int op = patchArray[2].get<int>();
-            
-            if (op == 0) {
-                return patchArray[0];
-            }
-            
-            if (op == OP_TEXTDIFF) {
-                if (!right.is_string()) {
-                    throw std::runtime_error("Invalid patch object");
-                }
-                
-                // For unpatch, we need to reverse the text diff
-                std::string patchText = patchArray[0].get<std::string>();
-                auto patches = SimpleTextDiff::PatchesFromText(patchText);
-                
-                // Create reverse patches
-                std::vector<TextPatch> reversePatches;
-                for (size_t i = 0; i < patches.size(); ++i) {
-                    TextPatch& patchItem = patches[i];
-                    TextPatch reversePatch = patchItem;
-                    reversePatch.diffs.clear();
-                    
-                    for (const auto& diff : patchItem.diffs) {
-                        if (diff.operation == DIFF_DELETE) {
-                            reversePatch.diffs.emplace_back(DIFF_INSERT, diff.text);
-                        } else if (diff.operation == DIFF_INSERT) {
-                            reversePatch.diffs.emplace_back(DIFF_DELETE, diff.text);
-                        } else {
-                            reversePatch.diffs.push_back(diff);
-                        }
-                    }
-                    reversePatches.push_back(reversePatch);
-                }
-                
-                auto result = SimpleTextDiff::ApplyPatches(reversePatches, right.get<std::string>());
-                
-                for (size_t i = 0; i < result.second.size(); ++i) {
-                    bool success = result.second[i];
-                    if (!success) {
-                        throw std::runtime_error("Text patch failed");
-                    }
-                }
-                
-                return json(result.first);
+
+    int JDP_UnpatchBatch(JDP_Handle handle, const JDP_Span* rights, const JDP_Span* patches,
+                         size_t count, char* arena, size_t arena_cap,
+                         size_t* offsets, size_t* lengths, int* statuses,
+                         size_t* needed, int parallel)
+    {
+        try {
+            return RunBatch(handle, Operation::Unpatch, rights, patches, count, arena, arena_cap,
+                            offsets, lengths, statuses, needed, parallel);
+        }
+        catch (...) {
+            return JDP_ERROR;
+        }
+    }
+
+    int JDP_TakeBatchResults(JDP_Handle handle, char* arena, size_t arena_cap,
+                             size_t* offsets, size_t* lengths, int* statuses, size_t* needed)
+    {
+        try {
+            JDP_Instance& instance = ResolveInstance(handle);
+            if (!instance.batchRetained || (instance.batchCount > 0 && (!offsets || !lengths))) {
+                return JDP_ERROR;
             }
-            
-            throw std::runtime_error("Invalid patch object");
+            return CopyBatchResults(instance, arena, arena_cap, offsets, lengths, statuses, needed);
+        }
+        catch (...) {
+            return JDP_ERROR;
         }
-        
-        throw std::runtime_error("Invalid patch object");
     }
-    
-    return json(nullptr);
-}
 
-json JsonDiffPatch::ObjectUnpatch(const json& obj, const json& patch) {
-    json target = obj.is_null() ? json::object() : obj;
-    
-    if (patch.is_null()) {
-        return target;
+    JDP_Ticket JDP_DiffAsync(JDP_Handle handle, const char* json_left, size_t left_len,
+                             const char* json_right, size_t right_len)
+    {
+        try {
+            return AsyncJobs::Instance().Submit(handle, Operation::Diff, json_left, left_len,
+                                                json_right, right_len);
+        }
+        catch (...) {
+            return 0;
+        }
     }
-    
-    for (auto it = patch.begin(); it != patch.end(); ++it) {
-        const std::string& key = it.key();
-        const json& patchValue = it.value();
-        
-        // Check for addition (which we need to undo by removing)
-        if (patchValue.is_array() && patchValue.size() == 1) {
-            target.erase(key);
+
+    JDP_Ticket JDP_PatchAsync(JDP_Handle handle, const char* json_left, size_t left_len,
+                              const char* patch_json, size_t patch_len)
+    {
+        try {
+            return AsyncJobs::Instance().Submit(handle, Operation::Patch, json_left, left_len,
+                                                patch_json, patch_len);
+        }
+        catch (...) {
+            return 0;
+        }
+    }
+
+    JDP_Ticket JDP_UnpatchAsync(JDP_Handle handle, const char* json_right, size_t right_len,
+                                const char* patch_json, size_t patch_len)
+    {
+        try {
+            return AsyncJobs::Instance().Submit(handle, Operation::Unpatch, json_right, right_len,
+                                                patch_json, patch_len);
+        }
+        catch (...) {
+            return 0;
+        }
+    }
+
+    int JDP_Poll(JDP_Ticket ticket)
+    {
+        auto job = AsyncJobs::Instance().Find(ticket);
+        if (!job) return JDP_ERROR_UNKNOWN_TICKET;
+        std::lock_guard<std::mutex> lock(job->mutex);
+        return job->status;
+    }
+
+    int JDP_Wait(JDP_Ticket ticket, int timeout_ms)
+    {
+        auto job = AsyncJobs::Instance().Find(ticket);
+        if (!job) return JDP_ERROR_UNKNOWN_TICKET;
+        std::unique_lock<std::mutex> lock(job->mutex);
+        auto finished = [&] { return job->status != JDP_PENDING; };
+        if (timeout_ms < 0) {
+            job->done.wait(lock, finished);
         } else {
-            if (target.contains(key)) {
-                target[key] = Unpatch(target[key], patchValue);
-            } else {
-                target[key] = Unpatch(json(nullptr), patchValue);
-            }
+            job->done.wait_for(lock, std::chrono::milliseconds(timeout_ms), finished);
         }
+        return job->status;
     }
-    
-    return target;
-}
 
-json JsonDiffPatch::ArrayUnpatch(const json& right, const json& patch) {
-    std::vector<json> arr = right.get<std::vector<json>>();
-
-    struct AddWas { size_t index; };                  // positive key, size==1 → remove
-    struct DelWas { size_t index; json value; };      // "_i": [value,0,0] → insert back
-    struct ModWas { size_t index; json value; };      // positive key with object → unpatch
-    struct MoveBack { size_t from; size_t to; };      // moved to "to" from "from" → move back
-
-    std::vector<AddWas> adds;         // will remove these
-    std::vector<DelWas> dels;         // will reinsert these
-    std::vector<ModWas> mods;         // will unpatch these
-    std::vector<MoveBack> moves;      // will move back
-
-    for (auto it = patch.begin(); it != patch.end(); ++it) {
-        const std::string& key = it.key();
-        if (key == "_t") continue;
-        const json& v = it.value();
-
-        if (!key.empty() && key[0] == '_') {
-            size_t idx = std::stoul(key.substr(1));
-            if (v.is_array() && v.size() == 3) {
-                int op = v[2].get<int>();
-                if (op == OP_DELETED) {
-                    dels.push_back({ idx, v[0] });
-                }
-                else if (op == OP_ARRAYMOVE) {
-                    // original: moved from idx to v[1]
-                    size_t to = v[1].get<size_t>();
-                    moves.push_back({ to, idx }); // move back from "to" to "idx"
-                }
-            }
+    int JDP_TakeResult(JDP_Ticket ticket, char* out, size_t cap, size_t* needed)
+    {
+        auto job = AsyncJobs::Instance().Find(ticket);
+        if (!job) return JDP_ERROR_UNKNOWN_TICKET;
+
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (job->status == JDP_PENDING) {
+            return JDP_PENDING;
         }
-        else {
-            size_t idx = std::stoul(key);
-            if (v.is_array() && v.size() == 1) {
-                adds.push_back({ idx });
-            }
-            else {
-                mods.push_back({ idx, v });
+
+        int status = job->status;
+        size_t length = job->result.size();
+        if (needed) *needed = length;
+        if (status == JDP_OK) {
+            if (!out || cap <= length) {
+                return JDP_ERROR_BUFFER_TOO_SMALL;
             }
+            std::memcpy(out, job->result.data(), length);
+            out[length] = '\0';
+        } else if (out && cap > 0) {
+            out[0] = '\0';
         }
+
+        AsyncJobs::Instance().Erase(ticket);
+        return status;
+    }
+
+    JDP_Doc JDP_LoadDocument(const char* json_text)
+    {
+        return JDP_LoadDocumentN(json_text, json_text ? std::strlen(json_text) : 0);
     }
 
-    // 1) Undo additions: remove at index (DESC to keep indices stable)
-    std::sort(adds.begin(), adds.end(),
-        [](const AddWas& a, const AddWas& b) { return a.index > b.index; });
-    for (const auto& a : adds) {
-        if (arr.empty()) continue;
-        if (a.index < arr.size()) {
-            arr.erase(arr.begin() + a.index);
+    JDP_Doc JDP_LoadDocumentN(const char* json_text, size_t len)
+    {
+        try {
+            return new JDP_Document(ParseInput(json_text, len, json(nullptr)));
         }
-        else {
-            // if out of range, remove last (best-effort)
-            arr.pop_back();
+        catch (...) {
+            return nullptr;
         }
     }
 
-    // 2) Undo moves: move from 'from' back to 'to' (ASC by target)
-    std::sort(moves.begin(), moves.end(),
-        [](const MoveBack& x, const MoveBack& y) { return x.to < y.to; });
-    for (const auto& mv : moves) {
-        if (arr.empty()) continue;
-        size_t from = (mv.from < arr.size()) ? mv.from : (arr.size() - 1);
-        json val = arr[from];
-        arr.erase(arr.begin() + from);
-        size_t to = (mv.to <= arr.size()) ? mv.to : arr.size();
-        arr.insert(arr.begin() + to, val);
+    void JDP_ReleaseDocument(JDP_Doc doc)
+    {
+        delete doc;
     }
 
-    // 3) Undo modifications (ASC)
-    std::sort(mods.begin(), mods.end(),
-        [](const ModWas& a, const ModWas& b) { return a.index < b.index; });
-    for (const auto& m : mods) {
-        if (m.index < arr.size()) {
-            arr[m.index] = Unpatch(arr[m.index], m.value);
+    JDP_Doc JDP_DiffDocs(JDP_Handle handle, JDP_Doc left, JDP_Doc right)
+    {
+        if (!left || !right) return nullptr;
+        try {
+            return new JDP_Document(StartCall(handle).engine.Diff(left->value, right->value));
+        }
+        catch (...) {
+            return nullptr;
         }
     }
 
-    // 4) Reinsert deletions (ASC)
-    std::sort(dels.begin(), dels.end(),
-        [](const DelWas& a, const DelWas& b) { return a.index < b.index; });
-    for (const auto& d : dels) {
-        size_t pos = (d.index <= arr.size()) ? d.index : arr.size();
-        arr.insert(arr.begin() + pos, d.value);
+    JDP_Doc JDP_PatchDoc(JDP_Handle handle, JDP_Doc left, JDP_Doc delta)
+    {
+        if (!left || !delta) return nullptr;
+        try {
+            return new JDP_Document(StartCall(handle).engine.Patch(left->value, delta->value));
+        }
+        catch (...) {
+            return nullptr;
+        }
     }
 
-    return json(arr);
-}
-
-std::string JsonDiffPatch::Diff(const std::string& left, const std::string& right) {
-    try {
-        json leftJson = left.empty() ? json("") : json::parse(left);
-        json rightJson = right.empty() ? json("") : json::parse(right);
-        json result = Diff(leftJson, rightJson);
-        return result.is_null() ? "" : result.dump();
-    } catch (const std::exception&) {
-        return "";
+    JDP_Doc JDP_UnpatchDoc(JDP_Handle handle, JDP_Doc right, JDP_Doc delta)
+    {
+        if (!right || !delta) return nullptr;
+        try {
+            return new JDP_Document(StartCall(handle).engine.Unpatch(right->value, delta->value));
+        }
+        catch (...) {
+            return nullptr;
+        }
     }
-}
 
-std::string JsonDiffPatch::Patch(const std::string& left, const std::string& patch) {
-    try {
-        json leftJson = left.empty() ? json("") : json::parse(left);
-        json patchJson = patch.empty() ? json(nullptr) : json::parse(patch);
-        json result = Patch(leftJson, patchJson);
-        return result.is_null() ? "" : result.dump();
-    } catch (const std::exception&) {
-        return "";
+    const char* JDP_DocumentText(JDP_Doc doc)
+    {
+        if (!doc) return "";
+        try {
+            if (!doc->hasText) {
+                DumpInto(doc->value, doc->text);
+                doc->hasText = true;
+            }
+        }
+        catch (...) {
+            doc->text.clear();
+        }
+        return doc->text.c_str();
     }
-}
 
-std::string JsonDiffPatch::Unpatch(const std::string& right, const std::string& patch) {
-    try {
-        json rightJson = right.empty() ? json("") : json::parse(right);
-        json patchJson = patch.empty() ? json(nullptr) : json::parse(patch);
-        json result = Unpatch(rightJson, patchJson);
-        return result.is_null() ? "" : result.dump();
-    } catch (const std::exception&) {
-        return "";
+    int JDP_SerializeDocument(JDP_Doc doc, char* out, size_t cap, size_t* needed)
+    {
+        if (!doc) return FailInto(out, cap, needed);
+        try {
+            return DumpInto(doc->value, out, cap, needed);
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
     }
-}
 
-} // namespace JsonDiffPatch
+    int JDP_DiffBinary(JDP_Handle handle, const char* json_left, size_t left_len,
+                       const char* json_right, size_t right_len, int format,
+                       unsigned char* out, size_t cap, size_t* needed)
+    {
+        try {
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(handle).engine;
+            json leftJson = ParseInput(json_left, left_len, json(""), engine.Stats());
+            json rightJson = ParseInput(json_right, right_len, json(""), engine.Stats());
+            std::vector<uint8_t> delta = engine.DiffBinary(leftJson, rightJson, format);
 
-// C API implementation
-extern "C" {
+            if (needed) *needed = delta.size();
+            if (delta.size() > cap || (!out && !delta.empty())) {
+                return JDP_ERROR_BUFFER_TOO_SMALL;
+            }
+            if (!delta.empty()) {
+                std::memcpy(out, delta.data(), delta.size());
+            }
+            return JDP_OK;
+        }
+        catch (...) {
+            if (needed) *needed = 0;
+            return JDP_ERROR;
+        }
+    }
 
-    static JsonDiffPatch::JsonDiffPatch g_diffPatch;
-    static thread_local std::string g_lastResult;
+    int JDP_PatchBinary(JDP_Handle handle, const char* json_left, size_t left_len,
+                        const unsigned char* delta, size_t delta_len,
+                        char* out, size_t cap, size_t* needed)
+    {
+        try {
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(handle).engine;
+            json leftJson = ParseInput(json_left, left_len, json(""), engine.Stats());
+            json patch;
+            {
+                JsonDiffPatch::detail::StatsScope scope(engine.Stats(), &DiffStats::ParseNs);
+                patch = JsonDiffPatch::BinaryDelta::Decode(delta, delta_len);
+            }
+            return DumpInto(engine.Patch(leftJson, patch), out, cap, needed, engine.Stats());
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
+    }
 
-    const char* JDP_Diff(const char* json_left, const char* json_right)
+    int JDP_UnpatchBinary(JDP_Handle handle, const char* json_right, size_t right_len,
+                          const unsigned char* delta, size_t delta_len,
+                          char* out, size_t cap, size_t* needed)
     {
         try {
-            g_lastResult = g_diffPatch.Diff(
-                json_left ? std::string(json_left) : std::string(),
-                json_right ? std::string(json_right) : std::string());
-            // always return at least ""
-            return g_lastResult.c_str();
+            JsonDiffPatch::JsonDiffPatch& engine = StartCall(handle).engine;
+            json rightJson = ParseInput(json_right, right_len, json(""), engine.Stats());
+            json patch;
+            {
+                JsonDiffPatch::detail::StatsScope scope(engine.Stats(), &DiffStats::ParseNs);
+                patch = JsonDiffPatch::BinaryDelta::Decode(delta, delta_len);
+            }
+            return DumpInto(engine.Unpatch(rightJson, patch), out, cap, needed, engine.Stats());
         }
         catch (...) {
-            g_lastResult.clear();
-            return g_lastResult.c_str();
+            return FailInto(out, cap, needed);
         }
     }
 
-    const char* JDP_Patch(const char* json_left, const char* patch_json)
+    JDP_Session JDP_BeginDiff(JDP_Handle handle, const char* json_left, size_t left_len,
+                              const char* json_right, size_t right_len)
     {
         try {
-            g_lastResult = g_diffPatch.Patch(
-                json_left ? std::string(json_left) : std::string(),
-                patch_json ? std::string(patch_json) : std::string());
-            return g_lastResult.c_str();
+            // A detached copy, like the asynchronous calls: the session records no statistics
+            JsonDiffPatch::JsonDiffPatch engine = ResolveInstance(handle).engine;
+            return new JDP_DiffSession(engine, ParseInput(json_left, left_len, json("")),
+                                       ParseInput(json_right, right_len, json("")));
         }
         catch (...) {
-            g_lastResult.clear();
-            return g_lastResult.c_str();
+            return nullptr;
         }
     }
 
-    const char* JDP_Unpatch(const char* json_right, const char* patch_json)
+    int JDP_DiffStep(JDP_Session session, size_t budget)
     {
+        if (!session) return JDP_ERROR;
         try {
-            g_lastResult = g_diffPatch.Unpatch(
-                json_right ? std::string(json_right) : std::string(),
-                patch_json ? std::string(patch_json) : std::string());
-            return g_lastResult.c_str();
+            return session->finished || session->session.Step(budget) ? JDP_OK : JDP_PENDING;
         }
         catch (...) {
-            g_lastResult.clear();
-            return g_lastResult.c_str();
+            return JDP_ERROR;
         }
     }
 
-    void JDP_FreeString(const char*) {}
-}
\ No newline at end of file
+    int JDP_FinishDiff(JDP_Session session, char* out, size_t cap, size_t* needed)
+    {
+        if (!session) return FailInto(out, cap, needed);
+        try {
+            if (!session->finished) {
+                session->delta = session->session.Finish();
+                session->finished = true;
+            }
+            return DumpInto(session->delta, out, cap, needed);
+        }
+        catch (...) {
+            return FailInto(out, cap, needed);
+        }
+    }
+
+    void JDP_EndDiff(JDP_Session session)
+    {
+        delete session;
+    }
+
+    int JDP_GetLastStats(JDP_Handle handle, JDP_Stats* out)
+    {
+        if (!out) return JDP_ERROR;
+        const DiffStats& stats = ResolveInstance(handle).stats;
+        out->nodes_visited = stats.NodesVisited;
+        out->lcs_arrays = stats.LcsArrays;
+        out->lcs_cells = stats.LcsCells;
+        out->hash_calls = stats.HashCalls;
+        out->text_diffs = stats.TextDiffs;
+        out->values_copied = stats.ValuesCopied;
+        out->scratch_growths = stats.ScratchGrowths;
+        out->parse_ns = stats.ParseNs;
+        out->diff_ns = stats.DiffNs;
+        out->text_diff_ns = stats.TextDiffNs;
+        out->patch_ns = stats.PatchNs;
+        out->serialize_ns = stats.SerializeNs;
+        return JDP_OK;
+    }
+}
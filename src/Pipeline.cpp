@@ -0,0 +1,176 @@
+#include "../include/JsonDiffPatch/JsonDiffPatch.h"
+#include "SpscQueue.h"
+#include <algorithm>
+#include <cctype>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+namespace JsonDiffPatch {
+
+namespace {
+
+    struct PipelineItem {
+        std::string text;     // input line, later the output line
+        json record;
+        json result;
+        std::string error;
+        bool end = false;
+    };
+
+    using Queue = detail::SpscQueue<PipelineItem>;
+
+    // One lane runs parse -> diff/patch -> dump on three threads. Records are dealt to
+    // the lanes round-robin and collected in the same order, which preserves output order.
+    class Lane {
+    public:
+        Lane(const Options& options, const PipelineOptions& pipelineOptions)
+            : _engine(options), _unpatch(pipelineOptions.Unpatch),
+              _input(pipelineOptions.QueueCapacity), _parsed(pipelineOptions.QueueCapacity),
+              _processed(pipelineOptions.QueueCapacity), _output(pipelineOptions.QueueCapacity) {}
+
+        void Start() {
+            _threads.emplace_back([this] { Stage(_input, _parsed, [](PipelineItem& item) { Parse(item); }); });
+            _threads.emplace_back([this] { Stage(_parsed, _processed, [this](PipelineItem& item) { Process(item); }); });
+            _threads.emplace_back([this] { Stage(_processed, _output, [](PipelineItem& item) { Dump(item); }); });
+        }
+
+        void Join() {
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        Queue& input() { return _input; }
+        Queue& output() { return _output; }
+
+    private:
+        template<typename Work>
+        static void Stage(Queue& from, Queue& to, Work work) {
+            for (;;) {
+                PipelineItem item;
+                from.Pop(item);
+                if (!item.end && item.error.empty()) {
+                    try {
+                        work(item);
+                    } catch (const std::exception& e) {
+                        item.error = e.what();
+                    }
+                }
+                bool end = item.end;
+                to.Push(std::move(item));
+                if (end) {
+                    return;
+                }
+            }
+        }
+
+        static void Parse(PipelineItem& item) {
+            item.record = json::parse(item.text);
+            item.text.clear();
+        }
+
+        void Process(PipelineItem& item) {
+            const json& record = item.record;
+            if (!record.is_object()) {
+                throw std::runtime_error("record is not an object");
+            }
+
+            auto left = record.find("left");
+            auto right = record.find("right");
+            if (left != record.end() && right != record.end()) {
+                item.result = _engine.Diff(*left, *right);
+                return;
+            }
+
+            auto doc = record.find("doc");
+            auto delta = record.find("delta");
+            if (doc != record.end() && delta != record.end()) {
+                item.result = _unpatch ? _engine.Unpatch(*doc, *delta) : _engine.Patch(*doc, *delta);
+                return;
+            }
+
+            throw std::runtime_error("record needs \"left\"/\"right\" or \"doc\"/\"delta\"");
+        }
+
+        static void Dump(PipelineItem& item) {
+            item.text = item.result.dump();
+            item.record = json();
+            item.result = json();
+        }
+
+        JsonDiffPatch _engine;
+        bool _unpatch;
+        Queue _input;
+        Queue _parsed;
+        Queue _processed;
+        Queue _output;
+        std::vector<std::thread> _threads;
+    };
+
+    bool IsBlank(const std::string& line) {
+        return std::all_of(line.begin(), line.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); });
+    }
+
+} // namespace
+
+size_t RunNdjsonPipeline(std::istream& in, std::ostream& out,
+                         const Options& options, const PipelineOptions& pipelineOptions) {
+    size_t laneCount = pipelineOptions.Lanes;
+    if (laneCount == 0) {
+        laneCount = (std::max)(std::thread::hardware_concurrency() / 3, 1u);
+    }
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    for (size_t i = 0; i < laneCount; ++i) {
+        lanes.push_back(std::make_unique<Lane>(options, pipelineOptions));
+        lanes.back()->Start();
+    }
+
+    // Writer: drains the lanes in the same round-robin order the reader fills them
+    std::thread writer([&] {
+        size_t lane = 0;
+        size_t finished = 0;
+        while (finished < lanes.size()) {
+            PipelineItem item;
+            lanes[lane]->output().Pop(item);
+            if (item.end) {
+                ++finished;
+            } else if (item.error.empty()) {
+                out << item.text << '\n';
+            } else {
+                out << json({ { "error", item.error } }).dump() << '\n';
+            }
+            lane = (lane + 1) % lanes.size();
+        }
+        out.flush();
+    });
+
+    size_t records = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (IsBlank(line)) {
+            continue;
+        }
+        PipelineItem item;
+        item.text = std::move(line);
+        lanes[records % laneCount]->input().Push(std::move(item));
+        ++records;
+    }
+
+    // End markers continue the round-robin sequence so the writer meets them in order
+    for (size_t i = 0; i < laneCount; ++i) {
+        PipelineItem end;
+        end.end = true;
+        lanes[(records + i) % laneCount]->input().Push(std::move(end));
+    }
+
+    writer.join();
+    for (auto& lane : lanes) {
+        lane->Join();
+    }
+    return records;
+}
+
+} // namespace JsonDiffPatch
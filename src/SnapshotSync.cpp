@@ -0,0 +1,72 @@
+#include "../include/JsonDiffPatch/JsonDiffPatch.h"
+#include <algorithm>
+
+namespace JsonDiffPatch {
+
+SnapshotSync::SnapshotSync(size_t capacity, const Options& options)
+    : _capacity((std::max)(capacity, size_t(1))), _engine(options) {}
+
+uint64_t SnapshotSync::Push(json state) {
+    if (_snapshots.size() == _capacity) {
+        _snapshots.pop_front();
+    }
+    _snapshots.emplace_back(++_latest, std::move(state));
+    _deltas.clear();
+    return _latest;
+}
+
+// Sequence numbers in the ring are consecutive
+const json* SnapshotSync::Find(uint64_t sequence) const {
+    if (_snapshots.empty() || sequence < _snapshots.front().first || sequence > _latest) {
+        return nullptr;
+    }
+    return &_snapshots[static_cast<size_t>(sequence - _snapshots.front().first)].second;
+}
+
+bool SnapshotSync::Ack(ClientId client, uint64_t sequence) {
+    if (!Find(sequence) || sequence <= Baseline(client)) {
+        return false;
+    }
+    _baselines[client] = sequence;
+    return true;
+}
+
+uint64_t SnapshotSync::Baseline(ClientId client) const {
+    auto it = _baselines.find(client);
+    return it != _baselines.end() && Find(it->second) ? it->second : 0;
+}
+
+const json& SnapshotSync::Value(uint64_t sequence) const {
+    static const json empty;
+    const json* value = Find(sequence);
+    return value ? *value : empty;
+}
+
+const json& SnapshotSync::DeltaFor(ClientId client) {
+    uint64_t baseline = Baseline(client);
+    CachedDelta& cached = _deltas[baseline];
+    if (!cached.hasDelta) {
+        cached.delta = _engine.Diff(Value(baseline), Value(_latest));
+        cached.hasDelta = true;
+        ++_diffCount;
+    }
+    return cached.delta;
+}
+
+// Serialized from the cached delta when there is one, else written directly without a tree
+const std::string& SnapshotSync::DeltaTextFor(ClientId client) {
+    uint64_t baseline = Baseline(client);
+    CachedDelta& cached = _deltas[baseline];
+    if (!cached.hasText) {
+        if (cached.hasDelta) {
+            cached.text = cached.delta.is_null() ? std::string() : cached.delta.dump();
+        } else {
+            _engine.DiffTo(Value(baseline), Value(_latest), cached.text);
+            ++_diffCount;
+        }
+        cached.hasText = true;
+    }
+    return cached.text;
+}
+
+} // namespace JsonDiffPatch
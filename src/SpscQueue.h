@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace JsonDiffPatch {
+namespace detail {
+
+    // Bounded lock-free single-producer/single-consumer ring buffer. Push and Pop block
+    // by spinning, then yielding, then briefly sleeping while the queue is full/empty.
+    template<typename T>
+    class SpscQueue {
+    public:
+        explicit SpscQueue(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity + 1) size <<= 1;
+            _slots.resize(size);
+            _mask = size - 1;
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        void Push(T&& value) {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t next = (tail + 1) & _mask;
+            for (unsigned spins = 0; next == _head.load(std::memory_order_acquire); ++spins) {
+                Backoff(spins);
+            }
+            _slots[tail] = std::move(value);
+            _tail.store(next, std::memory_order_release);
+        }
+
+        void Pop(T& value) {
+            size_t head = _head.load(std::memory_order_relaxed);
+            for (unsigned spins = 0; head == _tail.load(std::memory_order_acquire); ++spins) {
+                Backoff(spins);
+            }
+            value = std::move(_slots[head]);
+            _head.store((head + 1) & _mask, std::memory_order_release);
+        }
+
+    private:
+        static void Backoff(unsigned spins) {
+            if (spins < 64) {
+                return;
+            }
+            if (spins < 256) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        std::vector<T> _slots;
+        size_t _mask;
+        alignas(64) std::atomic<size_t> _head{ 0 };
+        alignas(64) std::atomic<size_t> _tail{ 0 };
+    };
+
+} // namespace detail
+} // namespace JsonDiffPatch
@@ -0,0 +1,91 @@
+#include "../include/JsonDiffPatch/JsonDiffPatch.h"
+#include <atomic>
+#include <cstdio>
+#include <ostream>
+
+namespace JsonDiffPatch {
+
+namespace {
+
+    // Small stable thread numbers for the "tid" field
+    int TraceThreadId() {
+        static std::atomic<int> next{ 1 };
+        static thread_local int id = next++;
+        return id;
+    }
+
+    // Microseconds with nanosecond precision, the unit of "ts" and "dur"
+    void AppendMicroseconds(std::string& out, uint64_t ns) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%llu.%03u",
+                                   static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+        out.append(buffer, static_cast<size_t>(length));
+    }
+
+} // namespace
+
+const char* TraceOperationName(int operation) {
+    switch (operation) {
+        case TRACE_OBJECT_DIFF: return "ObjectDiff";
+        case TRACE_ARRAY_DIFF: return "ArrayDiff";
+        case TRACE_OBJECT_PATCH: return "ObjectPatch";
+        case TRACE_ARRAY_PATCH: return "ArrayPatch";
+        case TRACE_OBJECT_UNPATCH: return "ObjectUnpatch";
+        case TRACE_ARRAY_UNPATCH: return "ArrayUnpatch";
+        default: return "Unknown";
+    }
+}
+
+ChromeTraceWriter::ChromeTraceWriter(std::ostream& out)
+    : _out(out), _origin(std::chrono::steady_clock::now()) {
+    _out << '[';
+}
+
+ChromeTraceWriter::~ChromeTraceWriter() {
+    Finish();
+}
+
+void ChromeTraceWriter::Exit(int operation, const std::string& path, size_t leftCount, size_t rightCount,
+                             uint64_t elapsedNs) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t end = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - _origin).count());
+    uint64_t start = end > elapsedNs ? end - elapsedNs : 0;
+
+    // Built outside the lock; paths may hold any bytes, so invalid UTF-8 is replaced
+    std::string event = "{\"name\":\"";
+    event += TraceOperationName(operation);
+    event += "\",\"cat\":\"jsondiffpatch\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+    event += std::to_string(TraceThreadId());
+    event += ",\"ts\":";
+    AppendMicroseconds(event, start);
+    event += ",\"dur\":";
+    AppendMicroseconds(event, elapsedNs);
+    event += ",\"args\":{\"path\":";
+    event += json(path).dump(-1, ' ', false, json::error_handler_t::replace);
+    event += ",\"left\":";
+    event += std::to_string(leftCount);
+    event += ",\"right\":";
+    event += std::to_string(rightCount);
+    event += "}}";
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_finished) {
+        return;
+    }
+    if (!_first) {
+        _out << ",\n";
+    }
+    _first = false;
+    _out << event;
+}
+
+void ChromeTraceWriter::Finish() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_finished) {
+        _out << "]\n";
+        _out.flush();
+        _finished = true;
+    }
+}
+
+} // namespace JsonDiffPatch
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace JsonDiffPatch {
+namespace detail {
+
+    // Small fixed-size thread pool used by the batch and async C APIs
+    class WorkerPool {
+    public:
+        explicit WorkerPool(size_t threads, size_t maxQueued = 1024)
+            : _maxQueued(maxQueued) {
+            threads = (std::max)(threads, static_cast<size_t>(1));
+            for (size_t i = 0; i < threads; ++i) {
+                _threads.emplace_back([this] { Run(); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        size_t Size() const { return _threads.size(); }
+
+        // Queues a task; returns false if the queue is full
+        bool TrySubmit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_stopping || _tasks.size() >= _maxQueued) {
+                    return false;
+                }
+                _tasks.push_back(std::move(task));
+            }
+            _wake.notify_one();
+            return true;
+        }
+
+        // Runs body(index, slot) for every index in [0, count). The calling thread takes
+        // part; slot identifies the participant (0 is the caller) so callers can keep
+        // per-participant state such as an engine copy in a vector of maxSlots() entries.
+        void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& body) {
+            struct State {
+                std::atomic<size_t> next{ 0 };
+                std::atomic<size_t> slots{ 1 };
+                size_t remaining = 0;
+                std::mutex mutex;
+                std::condition_variable done;
+                const std::function<void(size_t, size_t)>* body = nullptr;
+            };
+
+            if (count == 0) return;
+
+            auto state = std::make_shared<State>();
+            state->remaining = count;
+            state->body = &body;
+
+            auto work = [state, count](size_t slot) {
+                size_t finished = 0;
+                for (size_t i = state->next++; i < count; i = state->next++) {
+                    (*state->body)(i, slot);
+                    ++finished;
+                }
+                if (finished > 0) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->remaining -= finished;
+                    if (state->remaining == 0) {
+                        state->done.notify_all();
+                    }
+                }
+            };
+
+            size_t helpers = (std::min)(count - 1, Size());
+            for (size_t i = 0; i < helpers; ++i) {
+                TrySubmit([state, work] { work(state->slots++); });
+            }
+
+            work(0);
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->done.wait(lock, [&] { return state->remaining == 0; });
+        }
+
+        size_t MaxSlots() const { return Size() + 1; }
+
+        // Process-wide pool sized to the hardware, created on first use
+        static WorkerPool& Shared() {
+            static WorkerPool pool((std::max)(std::thread::hardware_concurrency(), 2u) - 1);
+            return pool;
+        }
+
+    private:
+        void Run() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _wake.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+                    if (_tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> _threads;
+        std::deque<std::function<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        size_t _maxQueued;
+        bool _stopping = false;
+    };
+
+} // namespace detail
+} // namespace JsonDiffPatch
@@ -0,0 +1,50 @@
+#pragma once
+
+// Heap allocation counting for the tests and benchmarks. Replaces the global operator
+// new/delete, so it must be included by exactly one translation unit of a program
+// (run_all_tests.cpp and bench.cpp are each compiled as one). Counts are kept per thread:
+// work on other threads, such as the C API worker pool, does not show up in a Scope.
+// Only operator new is counted; the library does not call malloc directly.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace AllocationCounter {
+
+    struct Counts {
+        size_t allocations = 0;
+        size_t bytes = 0;
+    };
+
+    inline thread_local Counts t_counts;
+
+    inline void* Allocate(size_t size) {
+        ++t_counts.allocations;
+        t_counts.bytes += size;
+        if (void* p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    // Allocations made by the calling thread since construction
+    class Scope {
+    public:
+        Scope() : _start(t_counts) {}
+
+        size_t Allocations() const { return t_counts.allocations - _start.allocations; }
+        size_t Bytes() const { return t_counts.bytes - _start.bytes; }
+
+    private:
+        Counts _start;
+    };
+
+} // namespace AllocationCounter
+
+void* operator new(size_t size) { return AllocationCounter::Allocate(size); }
+void* operator new[](size_t size) { return AllocationCounter::Allocate(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
@@ -0,0 +1,61 @@
+# Drives the jdp executable end to end; run through CTest with
+#   -DJDP=<path to jdp> -DDATA=<tests/data> -DWORK=<scratch directory>
+
+function(run_jdp expected_code output_var)
+    execute_process(COMMAND ${JDP} ${ARGN}
+        RESULT_VARIABLE code
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE err)
+    if(NOT code EQUAL expected_code)
+        message(FATAL_ERROR "jdp ${ARGN}: expected exit code ${expected_code}, got ${code}\n${err}")
+    endif()
+    set(${output_var} "${out}" PARENT_SCOPE)
+endfunction()
+
+file(MAKE_DIRECTORY ${WORK})
+
+run_jdp(0 out diff ${DATA}/left.json ${DATA}/left.json)
+if(NOT out STREQUAL "")
+    message(FATAL_ERROR "diff of equal files printed '${out}'")
+endif()
+
+foreach(mode "" "--stream")
+    run_jdp(1 delta diff ${DATA}/left.json ${DATA}/right.json ${mode})
+    file(WRITE ${WORK}/delta.json "${delta}")
+
+    run_jdp(0 patched patch ${DATA}/left.json ${WORK}/delta.json)
+    file(WRITE ${WORK}/patched.json "${patched}")
+    run_jdp(0 out diff ${WORK}/patched.json ${DATA}/right.json)
+
+    run_jdp(0 unpatched unpatch ${DATA}/right.json ${WORK}/delta.json --stats)
+    file(WRITE ${WORK}/unpatched.json "${unpatched}")
+    run_jdp(0 out diff ${WORK}/unpatched.json ${DATA}/left.json)
+endforeach()
+
+# Binary deltas contain NUL bytes, so they go straight to a file
+execute_process(COMMAND ${JDP} diff ${DATA}/left.json ${DATA}/right.json --binary
+    RESULT_VARIABLE code
+    OUTPUT_FILE ${WORK}/delta.bin)
+if(NOT code EQUAL 1)
+    message(FATAL_ERROR "binary diff: expected exit code 1, got ${code}")
+endif()
+run_jdp(0 patched patch ${DATA}/left.json ${WORK}/delta.bin --binary)
+file(WRITE ${WORK}/patched.json "${patched}")
+run_jdp(0 out diff ${WORK}/patched.json ${DATA}/right.json)
+
+run_jdp(2 out diff ${DATA}/left.json ${WORK}/missing.json)
+run_jdp(2 out frobnicate ${DATA}/left.json ${DATA}/right.json)
+
+# Pipeline mode: one output line per record, in input order
+file(WRITE ${WORK}/records.ndjson
+    "{\"left\":{\"a\":1},\"right\":{\"a\":2}}\n"
+    "\n"
+    "{\"left\":[1,2],\"right\":[1,2]}\n"
+    "{\"doc\":{\"a\":1},\"delta\":{\"a\":[1,2]}}\n"
+    "not json\n")
+run_jdp(0 out pipeline ${WORK}/records.ndjson --lanes 2)
+set(expected "{\"a\":[1,2]}\nnull\n{\"a\":2}\n")
+string(FIND "${out}" "${expected}" position)
+if(NOT position EQUAL 0 OR NOT out MATCHES "\n{\"error\":[^\n]*}\n$")
+    message(FATAL_ERROR "unexpected pipeline output '${out}'")
+endif()
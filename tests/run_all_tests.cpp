@@ -3,6 +3,7 @@
 // Include all test files
 #include "test_jsondiffpatch.cpp"
 #include "test_edge_cases.cpp"
+#include "test_allocations.cpp"
 
 // The test runner is defined in test_jsondiffpatch.cpp
 // All tests are automatically registered via static constructors
\ No newline at end of file
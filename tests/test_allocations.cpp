@@ -0,0 +1,106 @@
+#include "test_framework.h"
+#include "../include/JsonDiffPatch/JsonDiffPatch.h"
+
+using json = nlohmann::json;
+
+extern TestRunner globalTestRunner;
+
+// Steady-state allocation budgets: every engine is warmed up first, so its kept scratch
+// buffers are in place. Budgets are expressed in copies of documents and deltas, which is
+// what the results themselves have to allocate.
+
+namespace {
+
+    json TickState() {
+        return json::parse(R"({"player":{"name":"hero","hp":100,"pos":{"x":1.5,"y":2.5},"inventory":[1,2,3,4,5]},"tick":42,"entities":[{"id":1,"v":1},{"id":2,"v":2}],"motd":"a message of the day that is longer than the small string buffer"})");
+    }
+
+    // Copying and destroying value; destroying a container allocates its work stack too
+    size_t CopyAllocations(const json& value) {
+        AllocationCounter::Scope scope;
+        {
+            json copy = value;
+        }
+        return scope.Allocations();
+    }
+
+} // namespace
+
+// Test diffing an unchanged document allocates nothing
+TEST(AllocationsUnchangedDocument) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    json doc = TickState();
+    json same = doc;
+    std::string out;
+    jdp.Diff(doc, same);
+    jdp.DiffTo(doc, same, out);
+
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.Diff(doc, same));
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.DiffTo(doc, same, out));
+    ASSERT_ALLOCATIONS_AT_MOST(CopyAllocations(doc), jdp.Patch(doc, json()));
+}
+
+// Test one scalar change allocates only the delta, and the patched copy plus the changed path
+TEST(AllocationsScalarChange) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    json left = TickState();
+    json right = left;
+    right["player"]["hp"] = 99;
+    std::string out;
+    json delta = jdp.Diff(left, right);
+    jdp.DiffTo(left, right, out);
+    jdp.Patch(left, delta);
+    jdp.Unpatch(right, delta);
+
+    ASSERT_ALLOCATIONS_AT_MOST(CopyAllocations(delta), jdp.Diff(left, right));
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.DiffTo(left, right, out));
+
+    size_t patchBudget = CopyAllocations(left) + CopyAllocations(left["player"]);
+    ASSERT_ALLOCATIONS_AT_MOST(patchBudget, jdp.Patch(left, delta));
+    ASSERT_ALLOCATIONS_AT_MOST(patchBudget, jdp.Unpatch(right, delta));
+}
+
+// Test a small array insert allocates only the delta, and the patched copy plus the changed path
+TEST(AllocationsSmallArrayInsert) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    json left = TickState();
+    json right = left;
+    auto& inventory = right["player"]["inventory"];
+    inventory.insert(inventory.begin() + 2, 9);
+    std::string out;
+    json delta = jdp.Diff(left, right);
+    jdp.DiffTo(left, right, out);
+    jdp.Patch(left, delta);
+    jdp.Unpatch(right, delta);
+
+    ASSERT_ALLOCATIONS_AT_MOST(CopyAllocations(delta), jdp.Diff(left, right));
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.DiffTo(left, right, out));
+
+    // Plus the insertion into (or removal from) the copied array, which regrows it
+    size_t patchBudget = CopyAllocations(left) + CopyAllocations(left["player"]) +
+                         CopyAllocations(left["player"]["inventory"]) + 3;
+    ASSERT_ALLOCATIONS_AT_MOST(patchBudget, jdp.Patch(left, delta));
+    ASSERT_ALLOCATIONS_AT_MOST(patchBudget, jdp.Unpatch(right, delta));
+}
+
+// Test a delta cache hit allocates only the copy of the cached delta, and DiffTo nothing
+TEST(AllocationsDeltaCacheHit) {
+    JsonDiffPatch::DeltaCache cache;
+    JsonDiffPatch::Options options;
+    options.DeltaCache = &cache;
+    JsonDiffPatch::JsonDiffPatch jdp(options);
+    json left = TickState();
+    json right = left;
+    right["player"]["hp"] = 99;
+    right["entities"][1]["v"] = 3;
+    std::string out;
+    json delta = jdp.Diff(left, right);
+    jdp.DiffTo(left, right, out);
+
+    ASSERT_ALLOCATIONS_AT_MOST(CopyAllocations(delta), jdp.Diff(left, right));
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.DiffTo(left, right, out));
+    JsonDiffPatch::DocumentHash leftHash = JsonDiffPatch::DeltaCache::Hash(left);
+    JsonDiffPatch::DocumentHash rightHash = JsonDiffPatch::DeltaCache::Hash(right);
+    ASSERT_ALLOCATIONS_AT_MOST(0, jdp.DiffTo(left, right, leftHash, rightHash, out));
+    ASSERT_EQ(cache.Stats().Misses, size_t(1));
+}
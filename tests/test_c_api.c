@@ -0,0 +1,133 @@
+/* Plain C test harness for the JsonDiffPatch C API (JsonDiffPatchC.h) */
+
+#include "../include/JsonDiffPatch/JsonDiffPatchC.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int passed = 0;
+static int failed = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s at line %d\n", #condition, __LINE__); \
+            failed++; \
+            return; \
+        } \
+    } while (0)
+
+static void test_sync_api(void) {
+    const char* left = "{\"x\":1,\"y\":2}";
+    const char* right = "{\"x\":1,\"y\":3}";
+    char out[64];
+    size_t needed = 0;
+
+    CHECK(strcmp(JDP_Diff(left, right), "{\"y\":[2,3]}") == 0);
+    CHECK(JDP_DiffN(left, strlen(left), right, strlen(right), out, sizeof(out), &needed) == JDP_OK);
+    CHECK(strcmp(out, "{\"y\":[2,3]}") == 0);
+    passed++;
+}
+
+static void test_async_diff(void) {
+    const char* left = "{\"x\":1,\"y\":2}";
+    const char* right = "{\"x\":1,\"y\":3}";
+    char out[64];
+    size_t needed = 0;
+    int status;
+
+    JDP_Ticket ticket = JDP_DiffAsync(NULL, left, strlen(left), right, strlen(right));
+    CHECK(ticket != 0);
+
+    status = JDP_Poll(ticket);
+    CHECK(status == JDP_PENDING || status == JDP_OK);
+    CHECK(JDP_Wait(ticket, -1) == JDP_OK);
+    CHECK(JDP_Poll(ticket) == JDP_OK);
+
+    CHECK(JDP_TakeResult(ticket, out, 4, &needed) == JDP_ERROR_BUFFER_TOO_SMALL);
+    CHECK(needed == strlen("{\"y\":[2,3]}"));
+    CHECK(JDP_TakeResult(ticket, out, sizeof(out), &needed) == JDP_OK);
+    CHECK(strcmp(out, "{\"y\":[2,3]}") == 0);
+
+    /* The ticket is released once its result was taken */
+    CHECK(JDP_Poll(ticket) == JDP_ERROR_UNKNOWN_TICKET);
+    passed++;
+}
+
+static void test_async_many(void) {
+    enum { COUNT = 64 };
+    JDP_Ticket tickets[COUNT];
+    char lefts[COUNT][32];
+    char rights[COUNT][32];
+    char out[64];
+    char expected[64];
+    size_t needed = 0;
+    int i;
+
+    JDP_Handle handle = JDP_Create("{\"textDiff\":\"simple\"}");
+    CHECK(handle != NULL);
+
+    for (i = 0; i < COUNT; ++i) {
+        sprintf(lefts[i], "{\"hp\":%d}", i);
+        sprintf(rights[i], "{\"hp\":%d}", i + 1);
+        tickets[i] = JDP_DiffAsync(handle, lefts[i], strlen(lefts[i]), rights[i], strlen(rights[i]));
+        CHECK(tickets[i] != 0);
+    }
+
+    /* The handle's options were captured at submission time */
+    JDP_Destroy(handle);
+
+    for (i = 0; i < COUNT; ++i) {
+        CHECK(JDP_Wait(tickets[i], 10000) == JDP_OK);
+        CHECK(JDP_TakeResult(tickets[i], out, sizeof(out), &needed) == JDP_OK);
+        sprintf(expected, "{\"hp\":[%d,%d]}", i, i + 1);
+        CHECK(strcmp(out, expected) == 0);
+    }
+    passed++;
+}
+
+static void test_async_patch_unpatch(void) {
+    const char* left = "{\"items\":[1,2,3]}";
+    const char* right = "{\"items\":[1,2,3,4]}";
+    char diff[64];
+    char out[64];
+    size_t needed = 0;
+    JDP_Ticket ticket;
+
+    CHECK(JDP_DiffN(left, strlen(left), right, strlen(right), diff, sizeof(diff), &needed) == JDP_OK);
+
+    ticket = JDP_PatchAsync(NULL, left, strlen(left), diff, needed);
+    CHECK(JDP_Wait(ticket, -1) == JDP_OK);
+    CHECK(JDP_TakeResult(ticket, out, sizeof(out), NULL) == JDP_OK);
+    CHECK(strcmp(out, right) == 0);
+
+    ticket = JDP_UnpatchAsync(NULL, right, strlen(right), diff, strlen(diff));
+    CHECK(JDP_Wait(ticket, -1) == JDP_OK);
+    CHECK(JDP_TakeResult(ticket, out, sizeof(out), NULL) == JDP_OK);
+    CHECK(strcmp(out, left) == 0);
+    passed++;
+}
+
+static void test_async_errors(void) {
+    const char* invalid = "{invalid json}";
+    char out[16];
+    JDP_Ticket ticket = JDP_DiffAsync(NULL, invalid, strlen(invalid), "{}", 2);
+
+    CHECK(ticket != 0);
+    CHECK(JDP_Wait(ticket, -1) == JDP_ERROR);
+    CHECK(JDP_TakeResult(ticket, out, sizeof(out), NULL) == JDP_ERROR);
+    CHECK(JDP_Poll(ticket) == JDP_ERROR_UNKNOWN_TICKET);
+    CHECK(JDP_Wait(12345678, 0) == JDP_ERROR_UNKNOWN_TICKET);
+    passed++;
+}
+
+int main(void) {
+    test_sync_api();
+    test_async_diff();
+    test_async_many();
+    test_async_patch_unpatch();
+    test_async_errors();
+
+    printf("C API tests: %d passed, %d failed\n", passed, failed);
+    return failed;
+}
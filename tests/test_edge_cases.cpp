@@ -1,5 +1,7 @@
 #include "test_framework.h"
 #include "../include/JsonDiffPatch/JsonDiffPatch.h"
+#include "../include/JsonDiffPatch/JsonDiffPatchImpl.h"
+#include <sstream>
 
 using json = nlohmann::json;
 
@@ -25,6 +27,12 @@ TEST(TextDiffIdentical) {
     ASSERT_EQ(diffs.size(), 1);
     ASSERT_EQ(diffs[0].operation, JsonDiffPatch::DIFF_EQUAL);
     ASSERT_EQ(diffs[0].text, "Hello");
+    
+    // Identical strings above MinEfficientTextDiffLength have no delta either
+    std::string text(80, 'x');
+    JsonDiffPatch::JsonDiffPatch jdp;
+    ASSERT_TRUE(jdp.Diff(json(text), json(text)).is_null());
+    ASSERT_TRUE(jdp.Diff(json{ { "note", text } }, json{ { "note", text } }).is_null());
 }
 
 // Test text diff with empty strings
@@ -272,4 +280,1045 @@ TEST(OptionsConfiguration) {
     json patched = jdp.Patch(left, diff);
     
     ASSERT_EQ(patched, right);
-}
\ No newline at end of file
+}
+
+// Test binary delta round trip in both formats
+TEST(BinaryDeltaRoundTrip) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    
+    json left = {
+        {"name", "player"},
+        {"removed", true},
+        {"items", json::array({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12})},
+        {"bio", std::string(80, 'a')}
+    };
+    json right = {
+        {"name", "player2"},
+        {"added", {{"x", 1}}},
+        {"items", json::array({1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13})},
+        {"bio", std::string(80, 'a') + "b"}
+    };
+    
+    json delta = jdp.Diff(left, right);
+    
+    for (int format : {JsonDiffPatch::BINARY_CBOR, JsonDiffPatch::BINARY_MSGPACK}) {
+        std::vector<uint8_t> binary = jdp.DiffBinary(left, right, format);
+        ASSERT_EQ(binary[0], format);
+        ASSERT_TRUE(binary.size() < delta.dump().size());
+        
+        ASSERT_EQ(JsonDiffPatch::BinaryDelta::Decode(binary), delta);
+        ASSERT_EQ(jdp.Patch(left, binary), right);
+        ASSERT_EQ(jdp.Unpatch(right, binary), left);
+    }
+    
+    // No difference encodes as an empty buffer
+    ASSERT_TRUE(jdp.DiffBinary(left, left).empty());
+    ASSERT_EQ(jdp.Patch(left, std::vector<uint8_t>()), left);
+}
+
+// Test binary delta through the C API
+TEST(C_API_BinaryDelta) {
+    std::string left = "{\"pos\":[1,2,3],\"hp\":100}";
+    std::string right = "{\"pos\":[1,2,4],\"hp\":90}";
+    
+    unsigned char delta[64];
+    size_t deltaSize = 0;
+    ASSERT_EQ(JDP_DiffBinary(nullptr, left.data(), left.size(), right.data(), right.size(),
+                             JDP_BINARY_MSGPACK, delta, sizeof(delta), &deltaSize), JDP_OK);
+    ASSERT_TRUE(deltaSize > 0);
+    ASSERT_EQ(JDP_DiffBinary(nullptr, left.data(), left.size(), right.data(), right.size(),
+                             JDP_BINARY_MSGPACK, delta, 2, &deltaSize), JDP_ERROR_BUFFER_TOO_SMALL);
+    
+    char out[64];
+    size_t needed = 0;
+    ASSERT_EQ(JDP_PatchBinary(nullptr, left.data(), left.size(), delta, deltaSize, out, sizeof(out), &needed), JDP_OK);
+    ASSERT_EQ(json::parse(out), json::parse(right));
+    
+    ASSERT_EQ(JDP_UnpatchBinary(nullptr, right.data(), right.size(), delta, deltaSize, out, sizeof(out), &needed), JDP_OK);
+    ASSERT_EQ(json::parse(out), json::parse(left));
+    
+    unsigned char garbage[] = {9, 1, 2};
+    ASSERT_EQ(JDP_PatchBinary(nullptr, left.data(), left.size(), garbage, sizeof(garbage), out, sizeof(out), &needed), JDP_ERROR);
+}
+
+// Test that the streaming diff produces the same delta as the DOM diff
+TEST(StreamingDiffMatchesDiff) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    
+    std::vector<std::pair<json, json>> cases = {
+        {{{"a", 1}, {"b", 2}}, {{"a", 1}, {"b", 3}}},
+        {{{"a", 1}, {"b", {{"c", 1}, {"d", 2}}}}, {{"b", {{"d", 2}, {"c", 5}}}, {"e", true}}},
+        {json::array({1, 2, 3, 4, 5}), json::array({1, 2, 9, 4, 5})},
+        {json::array({1, 2, 3, 4, 5}), json::array({0, 1, 2, 3, 4, 5, 6})},
+        {json::array({{{"id", 1}}, {{"id", 2}}, 7}), json::array({{{"id", 1}, {"x", 1}}, {{"id", 3}}, 7, 8})},
+        {{{"list", json::array({{{"v", 1}}, {{"v", 2}}})}}, {{"list", json::array({{{"v", 1}}, {{"v", 3}}})}}},
+        {{{"text", std::string(60, 'x')}}, {{"text", std::string(60, 'x') + "y"}}},
+        {{{"type", json::array({1})}}, {{"type", {{"k", 1}}}}},
+        {json(1), json("one")},
+        {nullptr, ""},
+        {{{"same", json::array({1, {{"deep", json::array({1, 2})}}})}}, {{"same", json::array({1, {{"deep", json::array({1, 2})}}})}}},
+        {json::array({1, 2, 3, 4, 5, 6, 7}), json::array({9, 1, 2, 3, 8, 5, 6, 7, 0})},
+        {json::array({0, 1, 2, {{"a", 1}}, 3}), json::array({9, 0, 1, 2, {{"a", 1}}, 3})},
+        {json::array({1, {{"a", 1}}, 2, 3, 4}), json::array({1, {{"a", 2}}, 5, 3, 4, 6})},
+        {json::array({1, 2, json::array({3}), 4}), json::array({1, 7, json::array({3, 4}), 5})}
+    };
+    
+    for (const auto& c : cases) {
+        std::istringstream left(c.first.dump());
+        std::istringstream right(c.second.dump(2));
+        json streamed = jdp.DiffStream(left, right);
+        ASSERT_EQ(streamed, jdp.Diff(c.first, c.second));
+        
+        if (!streamed.is_null()) {
+            ASSERT_EQ(jdp.Patch(c.first, streamed), c.second);
+        }
+    }
+}
+
+// Stream buffer over a string that cannot seek, like a pipe
+class PipeBuffer : public std::streambuf {
+public:
+    explicit PipeBuffer(std::string text) : _text(std::move(text)) {
+        setg(&_text[0], &_text[0], &_text[0] + _text.size());
+    }
+
+private:
+    std::string _text;
+};
+
+// Test that long arrays only materialize the window between common head and tail
+TEST(StreamingDiffArrayWindow) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    json base = json::array();
+    for (int i = 0; i < 20000; ++i) {
+        base.push_back(i % 100);
+    }
+    json changed = base;
+    changed[5] = -1;
+    json inserted = base;
+    inserted.insert(inserted.begin(), -1);
+    json removed = base;
+    removed.erase(removed.begin() + 10000);
+    removed[10010] = -1;
+    
+    for (const json& right : { changed, inserted, removed }) {
+        json left = {{"values", base}};
+        json other = {{"values", right}};
+        std::string leftText = left.dump();
+        std::string rightText = other.dump();
+        json expected = jdp.Diff(left, other);
+        
+        JsonDiffPatch::DiffStats stats;
+        jdp.SetStats(&stats);
+        json streamed;
+        jdp.DiffStream(leftText.data(), leftText.size(), rightText.data(), rightText.size(),
+            [&](const std::vector<std::string>& path, json&& fragment) {
+                JsonDiffPatch::JsonDiffPatch::ApplyFragment(streamed, path, std::move(fragment));
+            });
+        jdp.SetStats(nullptr);
+        ASSERT_EQ(streamed, expected);
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+        ASSERT_TRUE(stats.NodesVisited < 100);
+#endif
+        
+        std::istringstream leftStream(leftText);
+        std::istringstream rightStream(rightText);
+        ASSERT_EQ(jdp.DiffStream(leftStream, rightStream), expected);
+        
+        // Streams that cannot seek fall back to materializing the rest of the array
+        PipeBuffer leftPipe(leftText);
+        PipeBuffer rightPipe(rightText);
+        std::istream leftPiped(&leftPipe);
+        std::istream rightPiped(&rightPipe);
+        ASSERT_EQ(jdp.DiffStream(leftPiped, rightPiped), expected);
+    }
+}
+
+// Test that streamed fragments arrive incrementally with array markers
+TEST(StreamingDiffFragments) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    std::string left = "{\"players\":[{\"hp\":10},{\"hp\":20}],\"tick\":1}";
+    std::string right = "{\"players\":[{\"hp\":10},{\"hp\":25}],\"tick\":2}";
+    
+    std::vector<std::string> paths;
+    bool changed = jdp.DiffStream(left.data(), left.size(), right.data(), right.size(),
+        [&](const std::vector<std::string>& path, json&&) {
+            std::string joined;
+            for (const auto& key : path) joined += "/" + key;
+            paths.push_back(joined);
+        });
+    
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(paths.size(), 3);
+    ASSERT_EQ(paths[0], "/players/_t");
+    ASSERT_EQ(paths[1], "/players/1/hp");
+    ASSERT_EQ(paths[2], "/tick");
+    
+    ASSERT_FALSE(jdp.DiffStream(left.data(), left.size(), left.data(), left.size(),
+                                [](const std::vector<std::string>&, json&&) {}));
+    
+    bool threw = false;
+    try {
+        jdp.DiffStream(left.data(), left.size(), "{\"players\":[}", 14,
+                       [](const std::vector<std::string>&, json&&) {});
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+// Test the NDJSON pipeline keeps record order across lanes
+TEST(NdjsonPipeline) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    std::ostringstream input;
+    for (int i = 0; i < 500; ++i) {
+        if (i % 3 == 0) {
+            input << json({ { "doc", { { "hp", i } } }, { "delta", { { "hp", json::array({ i, i + 1 }) } } } }).dump() << "\n";
+        } else {
+            input << json({ { "left", { { "hp", i } } }, { "right", { { "hp", i * 2 } } } }).dump() << "\n";
+        }
+    }
+    input << "[1,2,3]\n";
+    
+    JsonDiffPatch::PipelineOptions pipelineOptions;
+    pipelineOptions.Lanes = 3;
+    pipelineOptions.QueueCapacity = 4;
+    std::istringstream in(input.str());
+    std::ostringstream out;
+    ASSERT_EQ(JsonDiffPatch::RunNdjsonPipeline(in, out, JsonDiffPatch::Options(), pipelineOptions), 501);
+    
+    std::istringstream lines(out.str());
+    std::string line;
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_TRUE(static_cast<bool>(std::getline(lines, line)));
+        json expected = i % 3 == 0 ? json({ { "hp", i + 1 } })
+                                   : jdp.Diff(json({ { "hp", i } }), json({ { "hp", i * 2 } }));
+        ASSERT_EQ(json::parse(line), expected);
+    }
+    ASSERT_TRUE(static_cast<bool>(std::getline(lines, line)));
+    ASSERT_TRUE(json::parse(line).contains("error"));
+    ASSERT_FALSE(static_cast<bool>(std::getline(lines, line)));
+    
+    // Unpatch direction
+    std::istringstream reverse("{\"doc\":{\"hp\":2},\"delta\":{\"hp\":[1,2]}}\n");
+    std::ostringstream reversed;
+    pipelineOptions.Unpatch = true;
+    JsonDiffPatch::RunNdjsonPipeline(reverse, reversed, JsonDiffPatch::Options(), pipelineOptions);
+    ASSERT_EQ(reversed.str(), "{\"hp\":1}\n");
+}
+
+// Test the direct delta writer produces the same text as dumping Diff()
+TEST(DiffToMatchesDump) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    std::vector<std::pair<json, json>> cases = {
+        { json::parse(R"({"a":1,"b":[1,2,3],"c":"x"})"), json::parse(R"({"a":2,"b":[1,3,4,5],"d":null})") },
+        { json::parse(R"([{"id":1},{"id":2},3])"), json::parse(R"([{"id":1,"x":true},3])") },
+        { json::parse(R"({"quote\"key":"é\n","n":1.5})"), json::parse(R"({"quote\"key":"é\t","n":2.5})") },
+        { json(std::string(80, 'a')), json(std::string(40, 'a') + "b" + std::string(39, 'a')) },
+        { json::parse(R"([0,1,2,3,4,5,6,7,8,9,10,11])"), json::parse(R"([0,1,2,3,4,5,6,7,8,9,10,12])") },
+        { json(nullptr), json(1) },
+        { json::parse(R"({"same":[1,{"x":2}]})"), json::parse(R"({"same":[1,{"x":2}]})") }
+    };
+    
+    std::string buffer;
+    for (const auto& c : cases) {
+        json delta = jdp.Diff(c.first, c.second);
+        ASSERT_EQ(jdp.DiffTo(c.first, c.second, buffer), !delta.is_null());
+        ASSERT_EQ(buffer, delta.is_null() ? std::string() : delta.dump());
+    }
+    
+    // The buffer is reused: a smaller delta needs no new storage
+    jdp.DiffTo(cases[0].first, cases[0].second, buffer);
+    const char* storage = buffer.data();
+    jdp.DiffTo(json::parse(R"({"a":1})"), json::parse(R"({"a":2})"), buffer);
+    ASSERT_EQ(buffer, "{\"a\":[1,2]}");
+    ASSERT_TRUE(buffer.data() == storage);
+}
+
+// Test the raw-text diff agrees with parsing both texts and diffing them
+TEST(DiffTextMatchesDiff) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    std::vector<std::pair<std::string, std::string>> cases = {
+        { R"({"a":1,"b":{"c":[1,2,3],"d":"x"},"e":true})", R"({"a":1,"b":{"c":[1,2,4],"d":"x"},"e":true})" },
+        { R"({"a":1,"b":2})", "{\n  \"b\": 2,\n  \"a\": 1\n}" },
+        { R"({"a":[1,2,3]})", R"({"a":[1,2,3,4]})" },
+        { R"({"a":1,"a":2})", R"({"a":1,"a":3})" },
+        { R"({"a":1,"b":2})", R"({"a":1,"b":3})" },
+        { R"({"n":1.0,"s":"é"})", R"({"n":1,"s":"é"})" },
+        { R"({"a":12,"b":1})", R"({"a":1,"b":1})" },
+        { R"([{"id":1},{"id":2}])", R"([{"id":1},{"id":3}])" },
+        { R"("text")", R"("other")" },
+        { R"({"a":1})", R"([1])" }
+    };
+    
+    std::string buffer;
+    for (const auto& c : cases) {
+        json delta = jdp.Diff(json::parse(c.first), json::parse(c.second));
+        ASSERT_EQ(jdp.DiffText(c.first.data(), c.first.size(), c.second.data(), c.second.size(), buffer),
+                  !delta.is_null());
+        ASSERT_EQ(buffer, delta.is_null() ? std::string() : delta.dump());
+        ASSERT_EQ(jdp.Diff(c.first, c.second), buffer);
+    }
+    
+    // Invalid differing regions are still rejected
+    std::string left = R"({"a":1,"b":[1,2]})";
+    std::string right = R"({"a":1,"b":[1,2}})";
+    bool threw = false;
+    try {
+        jdp.DiffText(left.data(), left.size(), right.data(), right.size(), buffer);
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQ(jdp.Diff(left, right), "");
+    
+    // So are invalid regions that are byte-identical on both sides, and identical invalid texts
+    std::vector<std::string> invalid = { "tru", "01", "[1,,2]", "NaN", "\"a\x01b\"", "\"\xff\"", "{\"\xc3\":1}" };
+    for (const auto& value : invalid) {
+        std::vector<std::pair<std::string, std::string>> pairs = {
+            { "{\"a\":" + value + ",\"b\":[1,2]}", "{\"a\":" + value + ",\"b\":[1,3]}" },
+            { "[" + value + ",1]", "[" + value + ",2]" },
+            { "{\"a\":" + value + "}", "{\"a\":" + value + "}" },
+        };
+        for (const auto& p : pairs) {
+            threw = false;
+            try {
+                jdp.DiffText(p.first.data(), p.first.size(), p.second.data(), p.second.size(), buffer);
+            } catch (const std::exception&) {
+                threw = true;
+            }
+            ASSERT_TRUE(threw);
+            ASSERT_EQ(jdp.Diff(p.first, p.second), "");
+            ASSERT_EQ(std::string(JDP_Diff(p.first.c_str(), p.second.c_str())), "");
+            char out[64];
+            ASSERT_EQ(JDP_DiffN(p.first.data(), p.first.size(), p.second.data(), p.second.size(), out, sizeof(out), nullptr),
+                      JDP_ERROR);
+        }
+    }
+    std::string garbage = "garbage";
+    threw = false;
+    try {
+        jdp.DiffText(garbage.data(), garbage.size(), garbage.data(), garbage.size(), buffer);
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+// Test ordered_json documents diff without conversion and keep their member order
+TEST(OrderedJsonDiff) {
+    using ordered_json = nlohmann::ordered_json;
+    JsonDiffPatch::OrderedJsonDiffPatch jdp;
+    
+    ordered_json left = ordered_json::parse(R"({"z":1,"b":{"y":true,"a":[1,2,3]},"m":"keep","gone":0})");
+    ordered_json right = ordered_json::parse(R"({"z":2,"b":{"y":false,"a":[1,2,4]},"m":"keep","new":[]})");
+    
+    ordered_json delta = jdp.Diff(left, right);
+    ASSERT_EQ(delta.dump(),
+              R"({"z":[1,2],"b":{"y":[true,false],"a":{"_t":"a","2":[3,4]}},"gone":[0,0,0],"new":[[]]})");
+    ASSERT_EQ(jdp.Patch(left, delta).dump(), right.dump());
+    ASSERT_EQ(jdp.Unpatch(right, delta).dump(), left.dump());
+    
+    std::string buffer;
+    ASSERT_TRUE(jdp.DiffTo(left, right, buffer));
+    ASSERT_EQ(buffer, delta.dump());
+    std::string leftText = left.dump();
+    std::string rightText = right.dump();
+    ASSERT_TRUE(jdp.DiffText(leftText.data(), leftText.size(), rightText.data(), rightText.size(), buffer));
+    ASSERT_EQ(buffer, delta.dump());
+    
+    ASSERT_EQ(jdp.Patch(left, jdp.DiffBinary(left, right)).dump(), right.dump());
+}
+
+// Minimal stateless allocator standing in for an application allocator
+template<typename T>
+struct TestAllocator {
+    using value_type = T;
+    
+    TestAllocator() = default;
+    template<typename U> TestAllocator(const TestAllocator<U>&) {}
+    
+    T* allocate(size_t n) { return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+    
+    template<typename U> bool operator==(const TestAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const TestAllocator<U>&) const { return false; }
+};
+
+// Test a basic_json with its own allocator and number types through JsonDiffPatchImpl.h
+TEST(CustomBasicJsonDiff) {
+    using custom_json = nlohmann::basic_json<std::map, std::vector, std::string, bool,
+                                             std::int32_t, std::uint32_t, float, TestAllocator>;
+    JsonDiffPatch::BasicJsonDiffPatch<custom_json> jdp;
+    
+    custom_json left = custom_json::parse(R"({"a":[1,2,3],"b":"x","c":[1,{"q":2}]})");
+    custom_json right = custom_json::parse(R"({"a":[1,2],"b":"y","c":[1,{"q":3}]})");
+    
+    custom_json delta = jdp.Diff(left, right);
+    ASSERT_EQ(delta.dump(), R"({"a":{"_2":[3,0,0],"_t":"a"},"b":["x","y"],"c":{"1":{"q":[2,3]},"_t":"a"}})");
+    ASSERT_TRUE(jdp.Patch(left, delta) == right);
+    ASSERT_TRUE(jdp.Unpatch(right, delta) == left);
+    
+    std::string buffer;
+    ASSERT_TRUE(jdp.DiffTo(left, right, buffer));
+    ASSERT_EQ(buffer, delta.dump());
+}
+
+// Test a delta view points into the inputs and materializes to the Diff result
+TEST(DeltaViewMaterialize) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    
+    json left = json::parse(R"({"big":{"a":[1,2,3]},"gone":[1],"n":null,"list":[1,2,3,4,5],"text":"x","same":1})");
+    json right = json::parse(R"({"big":[0],"n":2,"list":[0,1,3,5,6],"text":"y","same":1,"new":{"b":2}})");
+    left["long"] = std::string(80, 'a');
+    right["long"] = std::string(80, 'a') + "b";
+    
+    JsonDiffPatch::DeltaView view = jdp.DiffView(left, right);
+    ASSERT_FALSE(view.Empty());
+    ASSERT_EQ(view.Materialize().dump(), jdp.Diff(left, right).dump());
+    
+    // Replaced subtrees are referenced, not copied
+    const auto& root = view.Root();
+    ASSERT_EQ(root.Kind, JsonDiffPatch::DELTA_OBJECT);
+    const JsonDiffPatch::DeltaView::Node* big = nullptr;
+    for (const auto& member : root.Children) {
+        if (*member.Key == "big") big = &member;
+    }
+    ASSERT_TRUE(big != nullptr);
+    ASSERT_EQ(big->Kind, JsonDiffPatch::DELTA_MODIFIED);
+    ASSERT_TRUE(big->Left == &left["big"]);
+    ASSERT_TRUE(big->Right == &right["big"]);
+    
+    ASSERT_TRUE(jdp.DiffView(left, left).Empty());
+    ASSERT_TRUE(jdp.DiffView(left, left).Materialize().is_null());
+    
+    JsonDiffPatch::OrderedJsonDiffPatch ordered;
+    nlohmann::ordered_json orderedLeft = nlohmann::ordered_json::parse(R"({"z":[1,2,3],"a":1})");
+    nlohmann::ordered_json orderedRight = nlohmann::ordered_json::parse(R"({"z":[3,1],"b":2})");
+    ASSERT_EQ(ordered.DiffView(orderedLeft, orderedRight).Materialize().dump(),
+              ordered.Diff(orderedLeft, orderedRight).dump());
+}
+
+// Test views apply directly and read json deltas, including array moves
+TEST(DeltaViewPatch) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    
+    json left = json::parse(R"({"a":[1,2,3,4,5],"b":{"c":1,"d":"x"},"gone":true})");
+    json right = json::parse(R"({"a":[0,2,4,5,6],"b":{"c":2,"e":[1]},"new":null})");
+    
+    JsonDiffPatch::DeltaView view = jdp.DiffView(left, right);
+    ASSERT_EQ(jdp.Patch(left, view).dump(), jdp.Patch(left, jdp.Diff(left, right)).dump());
+    ASSERT_EQ(jdp.Unpatch(right, view).dump(), jdp.Unpatch(right, jdp.Diff(left, right)).dump());
+    
+    json delta = json::parse(R"({"list":{"_t":"a","_0":["",3,3],"_2":["",0,0],"1":[9]},"s":["x","y"]})");
+    json doc = json::parse(R"({"list":[1,2,3,4,5],"s":"x"})");
+    JsonDiffPatch::DeltaView parsed = JsonDiffPatch::DeltaView::FromJson(delta);
+    ASSERT_EQ(parsed.Materialize().dump(), delta.dump());
+    json patched = jdp.Patch(doc, parsed);
+    ASSERT_EQ(patched.dump(), jdp.Patch(doc, delta).dump());
+    ASSERT_EQ(jdp.Unpatch(patched, parsed).dump(), jdp.Unpatch(patched, delta).dump());
+    
+    json noDelta;
+    ASSERT_TRUE(JsonDiffPatch::DeltaView::FromJson(noDelta).Empty());
+    
+    // A move built in C++ has a signed target; only negative targets are invalid
+    json built = { { "_t", "a" }, { "_0", json::array({ "", 2, 3 }) } };
+    json letters = json::array({ "a", "b", "c" });
+    ASSERT_TRUE(built["_0"][1].is_number_integer() && !built["_0"][1].is_number_unsigned());
+    ASSERT_EQ(jdp.Patch(letters, JsonDiffPatch::DeltaView::FromJson(built)).dump(), std::string(R"(["b","c","a"])"));
+    ASSERT_EQ(jdp.Patch(letters, built).dump(), std::string(R"(["b","c","a"])"));
+    built["_0"][1] = -1;
+    bool negativeThrew = false;
+    try {
+        JsonDiffPatch::DeltaView::FromJson(built);
+    } catch (const std::exception&) {
+        negativeThrew = true;
+    }
+    ASSERT_TRUE(negativeThrew);
+    
+    // Malformed deltas are rejected when read, array deltas on non-arrays when applied
+    json malformed = json::parse(R"({"a":[1,2,3,4]})");
+    bool threw = false;
+    try {
+        JsonDiffPatch::DeltaView::FromJson(malformed);
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    
+    threw = false;
+    try {
+        jdp.Patch(json(1), JsonDiffPatch::DeltaView::FromJson(delta["list"]));
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+// Memory resource that counts what passes through it
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t allocated = 0;
+    size_t outstanding = 0;
+    
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocated;
+        ++outstanding;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        --outstanding;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Test transient memory comes from the scratch arena and is released when the call returns
+TEST(ScratchArena) {
+    CountingResource upstream;
+    JsonDiffPatch::Options options;
+    options.ScratchResource = &upstream;
+    JsonDiffPatch::JsonDiffPatch jdp(options);
+    JsonDiffPatch::JsonDiffPatch plain;
+    
+    json left = json::parse(R"({"list":[1,2,3,4,5,6,7,8],"items":[{"a":1},{"b":[3,4,5]}],"s":"x"})");
+    json right = json::parse(R"({"list":[0,1,3,4,9,6,8],"items":[{"a":2},{"b":[5,4]},7],"s":"y"})");
+    
+    json delta = jdp.Diff(left, right);
+    ASSERT_EQ(delta.dump(), plain.Diff(left, right).dump());
+    ASSERT_EQ(jdp.Patch(left, delta).dump(), right.dump());
+    ASSERT_EQ(jdp.Unpatch(right, delta).dump(), left.dump());
+    ASSERT_EQ(upstream.outstanding, size_t(0));
+    
+    std::string buffer;
+    jdp.DiffTo(left, right, buffer);
+    ASSERT_EQ(buffer, delta.dump());
+    ASSERT_TRUE(upstream.allocated > 0);
+    ASSERT_EQ(upstream.outstanding, size_t(0));
+}
+
+// Test scratch buffers are reused between calls and survive nested arrays and ShrinkScratch
+TEST(ScratchReuse) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    JsonDiffPatch::JsonDiffPatch fresh;
+    
+    json left = json::parse(R"([1,[1,2,3,[4,5,6]],{"a":[7,8,9]},10,11])");
+    json right = json::parse(R"([0,1,[2,3,[5,6],9],{"a":[8,9,7,7]},11])");
+    std::string expected = fresh.Diff(left, right).dump();
+    
+    for (int i = 0; i < 3; ++i) {
+        json delta = jdp.Diff(left, right);
+        ASSERT_EQ(delta.dump(), expected);
+        ASSERT_EQ(jdp.Patch(left, delta).dump(), right.dump());
+        ASSERT_EQ(jdp.Unpatch(right, delta).dump(), left.dump());
+        jdp.ShrinkScratch();
+    }
+    
+    // A smaller array after a larger one reads no stale table cells
+    jdp.Diff(left, right);
+    json small = jdp.Diff(json::parse("[1,2,3]"), json::parse("[3,1]"));
+    ASSERT_EQ(small.dump(), fresh.Diff(json::parse("[1,2,3]"), json::parse("[3,1]")).dump());
+}
+
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+static std::string HashById(const json& item) {
+    return item.is_object() && item.contains("id") ? item["id"].dump() : item.dump();
+}
+
+// Test work counters and phase timings collected through an attached DiffStats
+TEST(DiffStats) {
+    JsonDiffPatch::DiffStats stats;
+    JsonDiffPatch::Options options;
+    options.ObjectHash = HashById;
+    JsonDiffPatch::JsonDiffPatch jdp(options);
+    jdp.SetStats(&stats);
+    
+    std::string longText(80, 'a');
+    json left = json::parse(R"({"items":[{"id":1},{"id":2},{"id":3}],"n":1})");
+    json right = json::parse(R"({"items":[{"id":3},{"id":1},{"id":4},{"id":5}],"n":2})");
+    left["text"] = longText;
+    right["text"] = longText + "b";
+    
+    json delta = jdp.Diff(left, right);
+    ASSERT_TRUE(stats.NodesVisited > 0);
+    ASSERT_EQ(stats.LcsArrays, size_t(1));
+    ASSERT_TRUE(stats.LcsCells > 0);
+    ASSERT_TRUE(stats.HashCalls > 0);
+    ASSERT_EQ(stats.TextDiffs, size_t(1));
+    ASSERT_TRUE(stats.ValuesCopied > 0);
+    ASSERT_TRUE(stats.DiffNs >= stats.TextDiffNs);
+    ASSERT_EQ(stats.PatchNs, uint64_t(0));
+    
+    // Patch counts into the same sink; the text diff is applied once more
+    ASSERT_EQ(jdp.Patch(left, delta).dump(), right.dump());
+    ASSERT_EQ(stats.TextDiffs, size_t(2));
+    
+    // Copies of the engine are detached, so they can run on other threads
+    JsonDiffPatch::JsonDiffPatch copy = jdp;
+    ASSERT_TRUE(copy.Stats() == nullptr);
+    stats.Reset();
+    copy.Diff(left, right);
+    ASSERT_EQ(stats.NodesVisited, size_t(0));
+    
+    // String overloads also time parsing and serialization
+    jdp.Patch(left.dump(), delta.dump());
+    ASSERT_TRUE(stats.NodesVisited > 0);
+    ASSERT_EQ(stats.LcsCells, size_t(0));
+    
+    jdp.SetStats(nullptr);
+    stats.Reset();
+    jdp.Diff(left, right);
+    ASSERT_EQ(stats.NodesVisited, size_t(0));
+}
+#endif
+
+// Records the steps a tracer sees, in exit order
+class RecordingTracer : public JsonDiffPatch::DiffTracer {
+public:
+    void Enter(int, const std::string&, size_t, size_t) override { ++depth; }
+    void Exit(int operation, const std::string& path, size_t leftCount, size_t rightCount, uint64_t) override {
+        --depth;
+        steps.push_back(std::string(JsonDiffPatch::TraceOperationName(operation)) + " " + path + " " +
+                        std::to_string(leftCount) + "/" + std::to_string(rightCount));
+    }
+
+    int depth = 0;
+    std::vector<std::string> steps;
+};
+
+// Test tracer callbacks carry the JSON pointer and counts of every object/array step
+TEST(DiffTracer) {
+    RecordingTracer tracer;
+    JsonDiffPatch::Options options;
+    options.Tracer = &tracer;
+    JsonDiffPatch::JsonDiffPatch jdp(options);
+    
+    json left = json::parse(R"({"a":{"b":[1,2,3]},"c/d":{"x":1},"e":[{"y":1}]})");
+    json right = json::parse(R"({"a":{"b":[1,3]},"c/d":{"x":2},"e":[{"y":2}]})");
+    json delta = jdp.Diff(left, right);
+    ASSERT_EQ(tracer.depth, 0);
+    std::vector<std::string> expected = {
+        "ArrayDiff /a/b 3/2", "ObjectDiff /a 1/1", "ObjectDiff /c~1d 1/1",
+        "ObjectDiff /e/0 1/1", "ArrayDiff /e 1/1", "ObjectDiff  3/3" };
+    ASSERT_EQ(json(tracer.steps).dump(), json(expected).dump());
+    
+    tracer.steps.clear();
+    ASSERT_EQ(jdp.Patch(left, delta).dump(), right.dump());
+    expected = {
+        "ArrayPatch /a/b 3/1", "ObjectPatch /a 1/1", "ObjectPatch /c~1d 1/1",
+        "ObjectPatch /e/0 1/1", "ArrayPatch /e 1/1", "ObjectPatch  3/3" };
+    ASSERT_EQ(json(tracer.steps).dump(), json(expected).dump());
+    
+    tracer.steps.clear();
+    ASSERT_EQ(jdp.Unpatch(right, delta).dump(), left.dump());
+    ASSERT_EQ(tracer.steps.back(), "ObjectUnpatch  3/3");
+    ASSERT_EQ(tracer.depth, 0);
+    
+    // The Chrome writer produces a JSON array of complete events
+    std::ostringstream out;
+    {
+        JsonDiffPatch::ChromeTraceWriter writer(out);
+        options.Tracer = &writer;
+        JsonDiffPatch::JsonDiffPatch traced(options);
+        traced.Diff(left, right);
+    }
+    json trace = json::parse(out.str());
+    ASSERT_EQ(trace.size(), size_t(6));
+    ASSERT_EQ(trace[0]["name"], "ArrayDiff");
+    ASSERT_EQ(trace[0]["ph"], "X");
+    ASSERT_EQ(trace[0]["args"]["path"], "/a/b");
+    ASSERT_EQ(trace[5]["args"]["path"], "");
+    ASSERT_TRUE(trace[5]["dur"].get<double>() >= trace[0]["dur"].get<double>());
+}
+
+// Test a diff session gives the Diff result whatever the step budget, over several steps
+TEST(DiffSessionMatchesDiff) {
+    JsonDiffPatch::Options hashed;
+    hashed.ObjectHash = [](const json& item) { return item.contains("id") ? item["id"].dump() : item.dump(); };
+    JsonDiffPatch::Options simple;
+    simple.ArrayDiff = JsonDiffPatch::MODE_SIMPLE;
+    
+    std::string longText(80, 'a');
+    std::vector<std::pair<std::string, std::string>> pairs = {
+        { R"({"a":1,"b":{"c":[1,2,3],"d":"x"},"gone":true})", R"({"a":2,"b":{"c":[1,3],"d":"x"},"new":[1]})" },
+        { R"([1,2,3,4,5,6,7,8,9])", R"([0,1,3,4,"x",6,8,9,10,11])" },
+        { R"([[1,2],[3,4],{"k":[5,6,7]}])", R"([[1,2],[3,4,5],{"k":[5,7]},8])" },
+        { R"([{"id":1,"v":1},{"id":2,"v":2},{"id":3,"v":3}])", R"([{"id":3,"v":3},{"id":1,"v":9},{"id":4,"v":4}])" },
+        { R"({"t":")" + longText + R"("})", R"({"t":")" + longText + R"(b"})" },
+        { R"([1,2,3])", R"([1,2,3,4,5])" },
+        { R"([1,2,3,4,5])", R"([1,5])" },
+        { R"({"same":[1,{"x":2}]})", R"({"same":[1,{"x":2}]})" },
+        { R"(null)", R"("")" },
+        { R"(1)", R"("1")" },
+    };
+    
+    for (const auto& options : { JsonDiffPatch::Options(), hashed, simple }) {
+        JsonDiffPatch::JsonDiffPatch jdp(options);
+        for (const auto& pair : pairs) {
+            json left = json::parse(pair.first);
+            json right = json::parse(pair.second);
+            json expected = jdp.Diff(left, right);
+            for (size_t budget : { 1, 2, 7, 1000 }) {
+                JsonDiffPatch::DiffSession session = jdp.BeginDiff(left, right);
+                size_t steps = 0;
+                while (!session.Step(budget)) {
+                    ++steps;
+                    ASSERT_TRUE(steps < 1000);
+                }
+                ASSERT_TRUE(session.Done());
+                ASSERT_EQ(session.Finish().dump(), expected.dump());
+            }
+            
+            // Finish does whatever is left
+            JsonDiffPatch::DiffSession session = jdp.BeginDiff(left, right);
+            session.Step(3);
+            ASSERT_EQ(session.Finish().dump(), expected.dump());
+        }
+    }
+    
+    // Member order of ordered_json deltas is kept
+    using ordered_json = nlohmann::ordered_json;
+    JsonDiffPatch::OrderedJsonDiffPatch ordered;
+    ordered_json left = ordered_json::parse(R"({"z":1,"b":{"y":true,"a":[1,2,3]},"gone":0})");
+    ordered_json right = ordered_json::parse(R"({"z":2,"b":{"y":false,"a":[1,2,4]},"new":[]})");
+    auto session = ordered.BeginDiff(left, right);
+    while (!session.Step(1)) {}
+    ASSERT_EQ(session.Finish().dump(), ordered.Diff(left, right).dump());
+}
+
+// Test a large LCS is spread over steps that each stay near the budget
+TEST(DiffSessionBoundedSteps) {
+    json left = json::array();
+    json right = json::array();
+    for (int i = 0; i < 300; ++i) {
+        left.push_back(i);
+        right.push_back(i % 7 == 0 ? -i : i);
+    }
+    right.push_back(1000);
+    right.push_back(1001);
+    right.erase(right.begin());
+    
+    JsonDiffPatch::DiffStats diffStats;
+    JsonDiffPatch::DiffStats sessionStats;
+    JsonDiffPatch::JsonDiffPatch jdp;
+    jdp.SetStats(&diffStats);
+    json expected = jdp.Diff(left, right);
+    jdp.SetStats(&sessionStats);
+    
+    JsonDiffPatch::DiffSession session = jdp.BeginDiff(left, right);
+    size_t steps = 1;
+    while (!session.Step(5000)) {
+        ++steps;
+    }
+    ASSERT_TRUE(steps >= 299 * 300 / 5000);
+    ASSERT_EQ(session.Finish().dump(), expected.dump());
+    
+    // The engine was free for other calls meanwhile, and the session counted like Diff
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+    ASSERT_EQ(sessionStats.NodesVisited, diffStats.NodesVisited);
+    ASSERT_EQ(sessionStats.LcsCells, diffStats.LcsCells);
+    ASSERT_EQ(sessionStats.ValuesCopied, diffStats.ValuesCopied);
+#endif
+}
+
+// Test that nested containers are walked across steps rather than compared in one
+TEST(DiffSessionNestedSteps) {
+    json left = json::array();
+    for (int i = 0; i < 200; ++i) {
+        left.push_back({ { "id", i }, { "tags", { i, i + 1, i + 2 } }, { "meta", { { "a", i }, { "b", { { { "c", i } } } } } } });
+    }
+    json right = left;
+    size_t nodes = 200 * 13;
+    const size_t budget = 50;
+    
+    JsonDiffPatch::JsonDiffPatch jdp;
+    for (int pass = 0; pass < 2; ++pass) {
+        // An equal pair once, then one differing deep inside the last element
+        if (pass == 1) {
+            right[199]["meta"]["b"][0]["c"] = -1;
+        }
+        JsonDiffPatch::DiffSession session = jdp.BeginDiff(left, right);
+        size_t steps = 1;
+        while (!session.Step(budget)) {
+            ++steps;
+        }
+        ASSERT_TRUE(steps >= nodes / (2 * budget));
+        ASSERT_EQ(session.Finish().dump(), jdp.Diff(left, right).dump());
+    }
+    
+    // The same for objects nested in objects
+    json deep = json::object();
+    json* cursor = &deep;
+    for (int i = 0; i < 400; ++i) {
+        (*cursor)["v"] = i;
+        cursor = &(*cursor)["next"];
+    }
+    JsonDiffPatch::DiffSession session = jdp.BeginDiff(deep, deep);
+    size_t steps = 1;
+    while (!session.Step(budget)) {
+        ++steps;
+    }
+    ASSERT_TRUE(steps >= 800 / (2 * budget));
+    ASSERT_TRUE(session.Finish().is_null());
+}
+
+// Test the C API session steps to the JDP_DiffN result
+TEST(C_API_DiffSession) {
+    std::string left = R"({"a":[1,2,3,4,5,6],"b":{"c":"x"}})";
+    std::string right = R"({"a":[2,3,9,5,6,7],"b":{"c":"y"}})";
+    char expected[256];
+    char out[256];
+    size_t needed = 0;
+    ASSERT_EQ(JDP_DiffN(left.data(), left.size(), right.data(), right.size(), expected, sizeof(expected), &needed), JDP_OK);
+    
+    JDP_Session session = JDP_BeginDiff(nullptr, left.data(), left.size(), right.data(), right.size());
+    ASSERT_TRUE(session != nullptr);
+    int status;
+    int steps = 0;
+    while ((status = JDP_DiffStep(session, 2)) == JDP_PENDING) {
+        ++steps;
+    }
+    ASSERT_EQ(status, JDP_OK);
+    ASSERT_TRUE(steps > 1);
+    ASSERT_EQ(JDP_FinishDiff(session, out, 4, &needed), JDP_ERROR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(JDP_FinishDiff(session, out, sizeof(out), &needed), JDP_OK);
+    ASSERT_EQ(std::string(out), std::string(expected));
+    ASSERT_EQ(JDP_DiffStep(session, 1), JDP_OK);
+    JDP_EndDiff(session);
+    
+    ASSERT_TRUE(JDP_BeginDiff(nullptr, "{bad", 4, "{}", 2) == nullptr);
+    ASSERT_EQ(JDP_DiffStep(nullptr, 1), JDP_ERROR);
+}
+
+// Test a tracked document diffs only its changed paths and matches a full Diff
+TEST(TrackedDocumentDiff) {
+    json base = json::parse(R"({"players":{"1":{"hp":100,"pos":[1,2]},"2":{"hp":80,"pos":[3,4]}},"log":["a","b"],"tick":1})");
+    JsonDiffPatch::TrackedDocument doc(base);
+    JsonDiffPatch::JsonDiffPatch jdp;
+    ASSERT_FALSE(doc.Dirty());
+    ASSERT_TRUE(jdp.Diff(doc).is_null());
+    
+    doc.Set("/players/1/hp"_json_pointer, 90);
+    doc.Set("/players/2/pos/1"_json_pointer, 5);
+    doc.Insert("/log/-"_json_pointer, "c");
+    doc.Erase("/tick"_json_pointer);
+    doc.Set("/players/3"_json_pointer, json::parse(R"({"hp":100})"));
+    doc.Edit("/players/2"_json_pointer)["hp"] = 70;
+    ASSERT_TRUE(doc.Dirty());
+    ASSERT_EQ(doc.Snapshot().dump(), base.dump());
+    
+    json delta = jdp.Diff(doc);
+    ASSERT_EQ(delta.dump(), jdp.Diff(base, doc.Value()).dump());
+    ASSERT_EQ(jdp.Patch(base, delta).dump(), doc.Value().dump());
+    
+    // Setting a value back leaves no difference for that path
+    doc.Commit();
+    ASSERT_FALSE(doc.Dirty());
+    json committed = doc.Value();
+    doc.Set("/players/1/hp"_json_pointer, 1);
+    doc.Set("/players/1/hp"_json_pointer, 90);
+    ASSERT_TRUE(jdp.Diff(doc).is_null());
+    ASSERT_EQ(doc.Snapshot().dump(), committed.dump());
+    
+    ASSERT_FALSE(doc.Erase("/missing"_json_pointer));
+    bool threw = false;
+    try {
+        doc.Set("/nowhere/x"_json_pointer, 1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+// Test a few changes in a large document do not make the diff visit all of it
+TEST(TrackedDocumentVisitsChangesOnly) {
+    json base;
+    for (int i = 0; i < 5000; ++i) {
+        base["entities"][std::to_string(i)] = { { "hp", 100 }, { "pos", { i, i } } };
+    }
+    JsonDiffPatch::TrackedDocument doc(base);
+    for (int i = 0; i < 10; ++i) {
+        doc.Set(json::json_pointer("/entities/" + std::to_string(i * 100) + "/hp"), 50);
+    }
+    
+    JsonDiffPatch::DiffStats stats;
+    JsonDiffPatch::JsonDiffPatch jdp;
+    jdp.SetStats(&stats);
+    json delta = jdp.Diff(doc);
+    ASSERT_EQ(delta["entities"].size(), size_t(10));
+    ASSERT_EQ(stats.NodesVisited, size_t(10));
+    ASSERT_EQ(delta.dump(), JsonDiffPatch::JsonDiffPatch().Diff(base, doc.Value()).dump());
+}
+#endif
+
+// Test hinted diffs compare only the hinted subtrees
+TEST(DiffWithHints) {
+    JsonDiffPatch::JsonDiffPatch jdp;
+    json left = json::parse(R"({"players":[{"hp":100},{"hp":80}],"world":{"time":1,"weather":"sun"},"items":[1,2]})");
+    json right = json::parse(R"({"players":[{"hp":100},{"hp":75}],"world":{"time":2,"weather":"sun"},"items":[1,2,3],"new":true})");
+    
+    std::vector<json::json_pointer> hints = {
+        "/players/1/hp"_json_pointer, "/world/time"_json_pointer, "/items/0"_json_pointer, "/new"_json_pointer };
+    ASSERT_EQ(jdp.Diff(left, right, hints).dump(), jdp.Diff(left, right).dump());
+    
+    // Everything outside the hints is taken as equal
+    ASSERT_EQ(jdp.Diff(left, right, { "/world"_json_pointer }).dump(), R"({"world":{"time":[1,2]}})");
+    ASSERT_TRUE(jdp.Diff(left, right, {}).is_null());
+    ASSERT_TRUE(jdp.Diff(left, right, { "/missing/path"_json_pointer }).is_null());
+    ASSERT_EQ(jdp.Diff(left, right, { ""_json_pointer }).dump(), jdp.Diff(left, right).dump());
+}
+
+// Test snapshot sync computes one delta per distinct client baseline and falls back to the
+// whole state when a baseline leaves the ring
+TEST(SnapshotSyncSharesDeltas) {
+    JsonDiffPatch::SnapshotSync sync(4);
+    JsonDiffPatch::JsonDiffPatch jdp;
+    auto state = [](int tick) {
+        return json{ { "tick", tick }, { "players", { { "1", { { "x", tick } } }, { "2", { { "x", 0 } } } } } };
+    };
+    
+    ASSERT_EQ(sync.Push(state(1)), uint64_t(1));
+    ASSERT_EQ(sync.Push(state(2)), uint64_t(2));
+    ASSERT_EQ(sync.Push(state(3)), uint64_t(3));
+    
+    // 64 clients spread over three baselines (and none)
+    for (uint64_t client = 0; client < 64; ++client) {
+        if (client % 4 != 0) {
+            ASSERT_TRUE(sync.Ack(client, client % 4));
+        }
+    }
+    for (uint64_t client = 0; client < 64; ++client) {
+        json baseline = client % 4 == 0 ? json() : state(static_cast<int>(client % 4));
+        ASSERT_EQ(sync.Baseline(client), client % 4);
+        ASSERT_EQ(jdp.Patch(baseline, sync.DeltaFor(client)).dump(), state(3).dump());
+    }
+    ASSERT_EQ(sync.DiffCount(), size_t(4));
+    ASSERT_TRUE(sync.DeltaFor(3).is_null());
+    ASSERT_EQ(sync.DeltaTextFor(1), sync.DeltaFor(1).dump());
+    ASSERT_EQ(sync.DiffCount(), size_t(4));
+    
+    // Older or unknown acks are ignored
+    ASSERT_FALSE(sync.Ack(3, 2));
+    ASSERT_FALSE(sync.Ack(3, 9));
+    
+    // Snapshot 1 and 2 leave the ring of four; their clients get the whole state again
+    sync.Push(state(4));
+    sync.Push(state(5));
+    sync.Push(state(6));
+    ASSERT_TRUE(sync.Find(2) == nullptr);
+    ASSERT_EQ(sync.Baseline(1), uint64_t(0));
+    ASSERT_EQ(sync.Baseline(3), uint64_t(3));
+    ASSERT_EQ(jdp.Patch(json(), sync.DeltaFor(1)).dump(), state(6).dump());
+    ASSERT_EQ(jdp.Patch(state(3), sync.DeltaFor(3)).dump(), state(6).dump());
+    ASSERT_EQ(sync.DiffCount(), size_t(6));
+}
+
+// Test the delta cache answers repeated pairs, tells options apart and stays under its cap
+TEST(DeltaCacheLookups) {
+    JsonDiffPatch::DeltaCache cache;
+    JsonDiffPatch::Options options;
+    options.DeltaCache = &cache;
+    JsonDiffPatch::JsonDiffPatch cached(options);
+    JsonDiffPatch::JsonDiffPatch plain;
+    
+    json left = json::parse(R"({"players":{"1":{"hp":100,"pos":[1,2]},"2":{"hp":90}},"tick":1})");
+    json right = json::parse(R"({"players":{"1":{"hp":95,"pos":[1,3]},"2":{"hp":90}},"tick":2})");
+    json expected = plain.Diff(left, right);
+    
+    // Nested diffs are not looked up on their own
+    ASSERT_EQ(cached.Diff(left, right).dump(), expected.dump());
+    ASSERT_EQ(cache.Stats().Misses, size_t(1));
+    ASSERT_EQ(cache.Stats().Entries, size_t(1));
+    
+    ASSERT_EQ(cached.Diff(left, right).dump(), expected.dump());
+    std::string text;
+    ASSERT_TRUE(cached.DiffTo(left, right, text));
+    ASSERT_EQ(text, expected.dump());
+    ASSERT_FALSE(cached.DiffTo(left, left, text));
+    ASSERT_TRUE(text.empty());
+    ASSERT_EQ(cache.Stats().Hits, size_t(2));
+    ASSERT_EQ(cache.Stats().Misses, size_t(2));
+    
+    // Same contents under other types or orders, and other options, are other keys
+    ASSERT_EQ(cached.Diff(json{ { "a", 1 } }, json{ { "a", "1" } }).dump(), plain.Diff(json{ { "a", 1 } }, json{ { "a", "1" } }).dump());
+    ASSERT_EQ(cached.Diff(json{ 1, 2 }, json{ 2, 1 }).dump(), plain.Diff(json{ 1, 2 }, json{ 2, 1 }).dump());
+    ASSERT_EQ(cached.Diff(json{ 2, 1 }, json{ 1, 2 }).dump(), plain.Diff(json{ 2, 1 }, json{ 1, 2 }).dump());
+    JsonDiffPatch::Options simpleOptions = options;
+    simpleOptions.ArrayDiff = JsonDiffPatch::MODE_SIMPLE;
+    JsonDiffPatch::JsonDiffPatch simple(simpleOptions);
+    simpleOptions.DeltaCache = nullptr;
+    JsonDiffPatch::JsonDiffPatch simplePlain(simpleOptions);
+    ASSERT_EQ(simple.Diff(json{ 1, 2 }, json{ 2, 1 }).dump(), simplePlain.Diff(json{ 1, 2 }, json{ 2, 1 }).dump());
+    ASSERT_EQ(cache.Stats().Hits, size_t(2));
+    ASSERT_EQ(cache.Stats().Misses, size_t(6));
+    
+    // Hashes computed once by the caller find the same entries
+    JsonDiffPatch::DocumentHash leftHash = JsonDiffPatch::DeltaCache::Hash(left);
+    JsonDiffPatch::DocumentHash rightHash = JsonDiffPatch::DeltaCache::Hash(right);
+    ASSERT_TRUE(leftHash == JsonDiffPatch::DeltaCache::Hash(json::parse(left.dump())));
+    ASSERT_TRUE(leftHash != rightHash);
+    ASSERT_EQ(cached.Diff(left, right, leftHash, rightHash).dump(), expected.dump());
+    ASSERT_TRUE(cached.DiffTo(left, right, leftHash, rightHash, text));
+    ASSERT_EQ(text, expected.dump());
+    ASSERT_FALSE(cached.DiffTo(left, left, leftHash, leftHash, text));
+    ASSERT_EQ(plain.Diff(left, right, leftHash, rightHash).dump(), expected.dump());
+    ASSERT_EQ(cache.Stats().Hits, size_t(5));
+    ASSERT_EQ(cache.Stats().Misses, size_t(6));
+    
+    // Lambdas differing only in what they capture bypass the cache, unless tagged apart
+    auto byField = [](std::string field) {
+        return std::function<std::string(const json&)>([field](const json& value) { return value[field].dump(); });
+    };
+    json people = json::parse(R"([{"id":1,"name":"a"},{"id":2,"name":"b"}])");
+    json swapped = json::parse(R"([{"id":2,"name":"a"},{"id":1,"name":"b"}])");
+    JsonDiffPatch::Options idOptions;
+    idOptions.ObjectHash = byField("id");
+    JsonDiffPatch::Options nameOptions;
+    nameOptions.ObjectHash = byField("name");
+    json byId = JsonDiffPatch::JsonDiffPatch(idOptions).Diff(people, swapped);
+    json byName = JsonDiffPatch::JsonDiffPatch(nameOptions).Diff(people, swapped);
+    ASSERT_TRUE(byId != byName);
+    
+    JsonDiffPatch::DeltaCache shared;
+    idOptions.DeltaCache = &shared;
+    nameOptions.DeltaCache = &shared;
+    JsonDiffPatch::JsonDiffPatch untaggedId(idOptions);
+    JsonDiffPatch::JsonDiffPatch untaggedName(nameOptions);
+    ASSERT_EQ(untaggedId.Diff(people, swapped).dump(), byId.dump());
+    ASSERT_EQ(untaggedName.Diff(people, swapped).dump(), byName.dump());
+    ASSERT_EQ(shared.Stats().Misses, size_t(0));
+    
+    idOptions.DeltaCacheTag = 1;
+    nameOptions.DeltaCacheTag = 2;
+    JsonDiffPatch::JsonDiffPatch taggedId(idOptions);
+    JsonDiffPatch::JsonDiffPatch taggedName(nameOptions);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(taggedId.Diff(people, swapped).dump(), byId.dump());
+        ASSERT_EQ(taggedName.Diff(people, swapped).dump(), byName.dump());
+    }
+    ASSERT_EQ(shared.Stats().Misses, size_t(2));
+    ASSERT_EQ(shared.Stats().Hits, size_t(2));
+    
+    // A small cap evicts the least recently used deltas first
+    JsonDiffPatch::DeltaCache small(4096);
+    options.DeltaCache = &small;
+    JsonDiffPatch::JsonDiffPatch limited(options);
+    limited.Diff(left, right);
+    for (int i = 0; i < 100; ++i) {
+        limited.Diff(json{ { "n", i } }, json{ { "n", i + 1 } });
+        limited.Diff(left, right);
+    }
+    JsonDiffPatch::DeltaCacheStats stats = small.Stats();
+    ASSERT_TRUE(stats.Bytes <= small.MaxBytes());
+    ASSERT_TRUE(stats.Evictions > 0);
+    ASSERT_EQ(stats.Hits, size_t(100));
+    ASSERT_EQ(stats.Entries + stats.Evictions, size_t(101));
+    
+    small.Clear();
+    ASSERT_EQ(small.Stats().Entries, size_t(0));
+    ASSERT_EQ(small.Stats().Bytes, size_t(0));
+}
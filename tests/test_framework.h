@@ -5,6 +5,7 @@
 #include <functional>
 #include <vector>
 #include <sstream>
+#include "alloc_counter.h"
 
 // Simple test framework
 class TestRunner {
@@ -82,6 +83,20 @@ public:
         throw std::runtime_error(oss.str()); \
     }
 
+// Runs the statement and fails if it made more than budget heap allocations on this thread
+#define ASSERT_ALLOCATIONS_AT_MOST(budget, ...) \
+    { \
+        AllocationCounter::Scope allocationScope; \
+        __VA_ARGS__; \
+        size_t allocationCount = allocationScope.Allocations(); \
+        if (allocationCount > size_t(budget)) { \
+            std::ostringstream oss; \
+            oss << "Allocation budget exceeded: " << allocationCount << " > " << (budget) \
+                << " for " << #__VA_ARGS__ << " at line " << __LINE__; \
+            throw std::runtime_error(oss.str()); \
+        } \
+    }
+
 #define TEST(testName) \
     void test_##testName(); \
     struct TestRegistrar_##testName { \
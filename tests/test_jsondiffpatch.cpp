@@ -309,6 +309,255 @@ TEST(C_API_Unpatch) {
     JDP_FreeString(unpatch_result);
 }
 
+// Test handle-based C API round trip
+TEST(C_API_Handle) {
+    const char* left_str = "{\"x\":1,\"y\":[1,2,3]}";
+    const char* right_str = "{\"x\":2,\"y\":[1,2,3,4]}";
+    
+    JDP_Handle handle = JDP_Create(nullptr);
+    ASSERT_NE(handle, nullptr);
+    
+    std::string diff_string = JDP_DiffH(handle, left_str, right_str);
+    ASSERT_FALSE(diff_string.empty());
+    
+    json patched = json::parse(JDP_PatchH(handle, left_str, diff_string.c_str()));
+    ASSERT_EQ(patched, json::parse(right_str));
+    
+    json unpatched = json::parse(JDP_UnpatchH(handle, right_str, diff_string.c_str()));
+    ASSERT_EQ(unpatched, json::parse(left_str));
+    
+    std::string invalid(JDP_DiffH(handle, "{invalid json}", right_str));
+    ASSERT_TRUE(invalid.empty());
+    
+    JDP_Destroy(handle);
+}
+
+// Test per-handle options
+TEST(C_API_HandleOptions) {
+    std::string longLeft(60, 'a');
+    std::string longRight = longLeft + "b";
+    json left = {{"text", longLeft}, {"items", json::array({{{"id", 1}, {"v", 1}}})}};
+    json right = {{"text", longRight}, {"items", json::array({{{"id", 1}, {"v", 2}}})}};
+    
+    JDP_Handle handle = JDP_Create("{\"textDiff\":\"simple\",\"objectHash\":\"id\"}");
+    ASSERT_NE(handle, nullptr);
+    
+    json diff = json::parse(JDP_DiffH(handle, left.dump().c_str(), right.dump().c_str()));
+    
+    // Simple text diff produces a plain replacement
+    ASSERT_EQ(diff["text"].size(), 2);
+    // Items are matched by "id", so the nested change is not reported
+    ASSERT_FALSE(diff.contains("items"));
+    
+    JDP_Destroy(handle);
+    
+    ASSERT_TRUE(JDP_Create("{\"arrayDiff\":\"sometimes\"}") == nullptr);
+    ASSERT_TRUE(JDP_Create("[1,2]") == nullptr);
+}
+
+// Test length-delimited C API with caller-provided buffers
+TEST(C_API_LengthDelimited) {
+    // Spans are not NUL-terminated at their ends
+    std::string storage = "{\"x\":1,\"y\":2}{\"x\":1,\"y\":3}";
+    const char* left = storage.data();
+    const char* right = storage.data() + 13;
+    
+    size_t needed = 0;
+    char small[4];
+    ASSERT_EQ(JDP_DiffN(left, 13, right, 13, small, sizeof(small), &needed), JDP_ERROR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(needed, std::string("{\"y\":[2,3]}").size());
+    
+    std::vector<char> diff(needed + 1);
+    ASSERT_EQ(JDP_DiffN(left, 13, right, 13, diff.data(), diff.size(), &needed), JDP_OK);
+    ASSERT_EQ(std::string(diff.data()), "{\"y\":[2,3]}");
+    
+    char patched[64];
+    ASSERT_EQ(JDP_PatchN(left, 13, diff.data(), needed, patched, sizeof(patched), &needed), JDP_OK);
+    ASSERT_EQ(json::parse(patched), json::parse(storage.substr(13)));
+    
+    char unpatched[64];
+    ASSERT_EQ(JDP_UnpatchN(right, 13, diff.data(), diff.size() - 1, unpatched, sizeof(unpatched), &needed), JDP_OK);
+    ASSERT_EQ(json::parse(unpatched), json::parse(storage.substr(0, 13)));
+    
+    // Equal documents produce an empty result
+    ASSERT_EQ(JDP_DiffN(left, 13, left, 13, patched, sizeof(patched), &needed), JDP_OK);
+    ASSERT_EQ(needed, 0);
+    ASSERT_EQ(std::string(patched), "");
+    
+    ASSERT_EQ(JDP_DiffN("{bad", 4, right, 13, patched, sizeof(patched), &needed), JDP_ERROR);
+}
+
+// Test batched C API
+TEST(C_API_Batch) {
+    std::vector<std::string> lefts, rights;
+    for (int i = 0; i < 32; ++i) {
+        lefts.push_back(json({{"id", i}, {"hp", 100}}).dump());
+        rights.push_back(json({{"id", i}, {"hp", i % 2 == 0 ? 100 : 90}}).dump());
+    }
+    lefts.push_back("{invalid json}");
+    rights.push_back("{}");
+    
+    std::vector<JDP_Span> leftSpans, rightSpans;
+    for (size_t i = 0; i < lefts.size(); ++i) {
+        leftSpans.push_back({lefts[i].data(), lefts[i].size()});
+        rightSpans.push_back({rights[i].data(), rights[i].size()});
+    }
+    size_t count = leftSpans.size();
+    
+    std::vector<size_t> offsets(count), lengths(count);
+    std::vector<int> statuses(count);
+    size_t needed = 0;
+    
+    ASSERT_EQ(JDP_DiffBatch(nullptr, leftSpans.data(), rightSpans.data(), count, nullptr, 0,
+                            offsets.data(), lengths.data(), statuses.data(), &needed, 1),
+              JDP_ERROR_BUFFER_TOO_SMALL);
+    
+    // The results computed by the undersized call are taken without running the batch again
+    std::vector<char> arena(needed);
+    ASSERT_EQ(JDP_TakeBatchResults(nullptr, arena.data(), needed - 1, offsets.data(), lengths.data(),
+                                   statuses.data(), &needed),
+              JDP_ERROR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(JDP_TakeBatchResults(nullptr, arena.data(), arena.size(), offsets.data(), lengths.data(),
+                                   statuses.data(), &needed),
+              JDP_OK);
+    ASSERT_EQ(JDP_TakeBatchResults(nullptr, arena.data(), arena.size(), offsets.data(), lengths.data(),
+                                   statuses.data(), &needed),
+              JDP_ERROR);
+    std::vector<char> taken = arena;
+    
+    ASSERT_EQ(JDP_DiffBatch(nullptr, leftSpans.data(), rightSpans.data(), count, arena.data(), arena.size(),
+                            offsets.data(), lengths.data(), statuses.data(), &needed, 1),
+              JDP_OK);
+    ASSERT_TRUE(taken == arena);
+    ASSERT_EQ(JDP_TakeBatchResults(nullptr, arena.data(), arena.size(), offsets.data(), lengths.data(),
+                                   statuses.data(), &needed),
+              JDP_ERROR);
+    
+    for (int i = 0; i < 32; ++i) {
+        ASSERT_EQ(statuses[i], JDP_OK);
+        std::string diff(arena.data() + offsets[i], lengths[i]);
+        ASSERT_EQ(diff, i % 2 == 0 ? "" : "{\"hp\":[100,90]}");
+    }
+    ASSERT_EQ(statuses[32], JDP_ERROR);
+    ASSERT_EQ(lengths[32], 0);
+    
+    // Patch the same items sequentially through a handle
+    std::vector<JDP_Span> patchSpans;
+    for (size_t i = 0; i < 32; ++i) {
+        patchSpans.push_back({arena.data() + offsets[i], lengths[i]});
+    }
+    JDP_Handle handle = JDP_Create(nullptr);
+    std::vector<char> patched(64 * 32);
+    ASSERT_EQ(JDP_PatchBatch(handle, leftSpans.data(), patchSpans.data(), 32, patched.data(), patched.size(),
+                             offsets.data(), lengths.data(), nullptr, &needed, 0),
+              JDP_OK);
+    for (size_t i = 0; i < 32; ++i) {
+        ASSERT_EQ(json::parse(patched.data() + offsets[i]), json::parse(rights[i]));
+    }
+    
+    std::vector<char> unpatched(64 * 32);
+    ASSERT_EQ(JDP_UnpatchBatch(handle, rightSpans.data(), patchSpans.data(), 32, unpatched.data(), unpatched.size(),
+                               offsets.data(), lengths.data(), nullptr, &needed, 1),
+              JDP_OK);
+    for (size_t i = 0; i < 32; ++i) {
+        ASSERT_EQ(json::parse(unpatched.data() + offsets[i]), json::parse(lefts[i]));
+    }
+    JDP_Destroy(handle);
+}
+
+// Test parsed-document handles in the C API
+TEST(C_API_Documents) {
+    JDP_Doc base = JDP_LoadDocument("{\"x\":1,\"items\":[1,2]}");
+    JDP_Doc next = JDP_LoadDocument("{\"x\":2,\"items\":[1,2,3]}");
+    ASSERT_NE(base, nullptr);
+    ASSERT_NE(next, nullptr);
+    ASSERT_TRUE(JDP_LoadDocument("{invalid json}") == nullptr);
+    
+    JDP_Doc delta = JDP_DiffDocs(nullptr, base, next);
+    ASSERT_NE(delta, nullptr);
+    
+    // Patch results are documents themselves and can be patched again
+    JDP_Doc patched = JDP_PatchDoc(nullptr, base, delta);
+    ASSERT_EQ(json::parse(JDP_DocumentText(patched)), json::parse(JDP_DocumentText(next)));
+    
+    JDP_Doc unpatched = JDP_UnpatchDoc(nullptr, patched, delta);
+    char out[64];
+    size_t needed = 0;
+    ASSERT_EQ(JDP_SerializeDocument(unpatched, out, sizeof(out), &needed), JDP_OK);
+    ASSERT_EQ(std::string(out), "{\"items\":[1,2],\"x\":1}");
+    
+    // Equal documents give a null delta that patches to the input
+    JDP_Doc noDelta = JDP_DiffDocs(nullptr, base, base);
+    ASSERT_EQ(std::string(JDP_DocumentText(noDelta)), "");
+    JDP_Doc same = JDP_PatchDoc(nullptr, base, noDelta);
+    ASSERT_EQ(std::string(JDP_DocumentText(same)), std::string(JDP_DocumentText(base)));
+    
+    for (JDP_Doc doc : {base, next, delta, patched, unpatched, noDelta, same}) {
+        JDP_ReleaseDocument(doc);
+    }
+}
+
+TEST(C_API_Stats) {
+    JDP_Handle handle = JDP_Create("{\"objectHash\":\"id\"}");
+    ASSERT_NE(handle, nullptr);
+    JDP_Stats stats;
+    
+    JDP_DiffH(handle, "{\"a\":[{\"id\":1},{\"id\":2}]}", "{\"a\":[{\"id\":2},{\"id\":3},{\"id\":4}]}");
+    ASSERT_EQ(JDP_GetLastStats(handle, &stats), JDP_OK);
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+    ASSERT_TRUE(stats.nodes_visited > 0);
+    ASSERT_TRUE(stats.lcs_cells > 0);
+    ASSERT_TRUE(stats.hash_calls > 0);
+#endif
+    
+    // Each call starts from zero
+    JDP_PatchH(handle, "{\"x\":1}", "{\"x\":[1,2]}");
+    ASSERT_EQ(JDP_GetLastStats(handle, &stats), JDP_OK);
+    ASSERT_EQ(stats.lcs_cells, 0ULL);
+    ASSERT_EQ(stats.hash_calls, 0ULL);
+    
+    // NULL reports the calls made without a handle on this thread
+    char out[64];
+    JDP_DiffN("[1,2,3]", 7, "[1,3,4,5]", 9, out, sizeof(out), nullptr);
+    ASSERT_EQ(JDP_GetLastStats(nullptr, &stats), JDP_OK);
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+    ASSERT_EQ(stats.lcs_arrays, 1ULL);
+#endif
+    ASSERT_EQ(JDP_GetLastStats(nullptr, nullptr), JDP_ERROR);
+    
+    // A parallel batch counts the items of every thread, like a serial one
+    std::vector<std::string> lefts;
+    std::vector<std::string> rights;
+    for (int i = 0; i < 64; ++i) {
+        lefts.push_back("{\"a\":[" + std::to_string(i) + ",1,2,3],\"b\":" + std::to_string(i) + "}");
+        rights.push_back("{\"a\":[1,2," + std::to_string(i) + ",4],\"b\":" + std::to_string(i + 1) + "}");
+    }
+    std::vector<JDP_Span> leftSpans;
+    std::vector<JDP_Span> rightSpans;
+    for (int i = 0; i < 64; ++i) {
+        leftSpans.push_back({ lefts[i].data(), lefts[i].size() });
+        rightSpans.push_back({ rights[i].data(), rights[i].size() });
+    }
+    std::vector<char> arena(1 << 16);
+    std::vector<size_t> offsets(64);
+    std::vector<size_t> lengths(64);
+    JDP_Stats serial;
+    JDP_Stats parallel;
+    ASSERT_EQ(JDP_DiffBatch(handle, leftSpans.data(), rightSpans.data(), 64, arena.data(), arena.size(),
+                            offsets.data(), lengths.data(), nullptr, nullptr, 0), JDP_OK);
+    ASSERT_EQ(JDP_GetLastStats(handle, &serial), JDP_OK);
+    ASSERT_EQ(JDP_DiffBatch(handle, leftSpans.data(), rightSpans.data(), 64, arena.data(), arena.size(),
+                            offsets.data(), lengths.data(), nullptr, nullptr, 1), JDP_OK);
+    ASSERT_EQ(JDP_GetLastStats(handle, &parallel), JDP_OK);
+    ASSERT_EQ(parallel.nodes_visited, serial.nodes_visited);
+    ASSERT_EQ(parallel.lcs_cells, serial.lcs_cells);
+#ifndef JSONDIFFPATCH_DISABLE_STATS
+    ASSERT_TRUE(serial.nodes_visited > 0);
+#endif
+    
+    JDP_Destroy(handle);
+}
+
 // Test empty objects
 TEST(EmptyObjects) {
     JsonDiffPatch::JsonDiffPatch jdp;
@@ -0,0 +1,363 @@
+// jdp - command line front end for JsonDiffPatch
+//
+//   jdp diff <left.json> <right.json>     exit code 0: equal, 1: different
+//   jdp patch <left.json> <delta>         prints the patched document
+//   jdp unpatch <right.json> <delta>      prints the original document
+//   jdp pipeline [records.ndjson]         one result line per {left,right} / {doc,delta}
+//                                         record, reading stdin when no file is given
+//
+// Options:
+//   --binary   write (diff) or read (patch/unpatch) deltas in the binary CBOR encoding
+//   --pretty   indent JSON output
+//   --stream   diff without building the documents (for very large inputs)
+//   --stats    print per-phase timings to stderr
+//   --trace F  (diff/patch/unpatch) write a Chrome trace of the object/array steps to F
+//   --unpatch  (pipeline) apply {doc,delta} records in reverse
+//   --lanes N  (pipeline) number of parse/diff/dump lanes, default derived from the core count
+//
+// Errors exit with code 2.
+
+#include "JsonDiffPatch/JsonDiffPatch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+    const int EXIT_OK = 0;
+    const int EXIT_EQUAL = 0;
+    const int EXIT_DIFFERENT = 1;
+    const int EXIT_ERROR = 2;
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+            _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (_file == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error("cannot open " + path);
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(_file, &size)) {
+                CloseHandle(_file);
+                throw std::runtime_error("cannot stat " + path);
+            }
+            _size = static_cast<size_t>(size.QuadPart);
+            if (_size > 0) {
+                _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                _data = _mapping ? static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+                if (!_data) {
+                    if (_mapping) CloseHandle(_mapping);
+                    CloseHandle(_file);
+                    throw std::runtime_error("cannot map " + path);
+                }
+            }
+#else
+            _fd = open(path.c_str(), O_RDONLY);
+            if (_fd < 0) {
+                throw std::runtime_error("cannot open " + path);
+            }
+            struct stat info;
+            if (fstat(_fd, &info) != 0) {
+                close(_fd);
+                throw std::runtime_error("cannot stat " + path);
+            }
+            _size = static_cast<size_t>(info.st_size);
+            if (_size > 0) {
+                void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+                if (data == MAP_FAILED) {
+                    close(_fd);
+                    throw std::runtime_error("cannot map " + path);
+                }
+                madvise(data, _size, MADV_SEQUENTIAL);
+                _data = static_cast<const char*>(data);
+            }
+#endif
+        }
+
+        ~MappedFile() {
+#ifdef _WIN32
+            if (_data) UnmapViewOfFile(_data);
+            if (_mapping) CloseHandle(_mapping);
+            CloseHandle(_file);
+#else
+            if (_data) munmap(const_cast<char*>(_data), _size);
+            close(_fd);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return _data; }
+        size_t size() const { return _size; }
+        const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(_data); }
+
+    private:
+#ifdef _WIN32
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping = nullptr;
+#else
+        int _fd = -1;
+#endif
+        const char* _data = nullptr;
+        size_t _size = 0;
+    };
+
+    struct CommandLine {
+        std::string command;
+        std::vector<std::string> files;
+        bool binary = false;
+        bool pretty = false;
+        bool stream = false;
+        bool stats = false;
+        bool unpatch = false;
+        size_t lanes = 0;
+        std::string trace;
+    };
+
+    // Engine options with a Chrome trace writer attached when --trace is given
+    class TraceOutput {
+    public:
+        explicit TraceOutput(const std::string& path) {
+            if (!path.empty()) {
+                _file.open(path, std::ios::binary);
+                if (!_file) {
+                    throw std::runtime_error("cannot open " + path);
+                }
+                _writer = std::make_unique<JsonDiffPatch::ChromeTraceWriter>(_file);
+            }
+        }
+
+        JsonDiffPatch::Options Options() const {
+            JsonDiffPatch::Options options;
+            options.Tracer = _writer.get();
+            return options;
+        }
+
+    private:
+        std::ofstream _file;
+        std::unique_ptr<JsonDiffPatch::ChromeTraceWriter> _writer;
+    };
+
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(bool enabled) : _enabled(enabled), _start(Clock::now()) {}
+
+        void Mark(const char* phase) {
+            auto now = Clock::now();
+            if (_enabled) {
+                _phases.emplace_back(phase, std::chrono::duration<double, std::milli>(now - _start).count());
+            }
+            _start = now;
+        }
+
+        void Print() const {
+            double total = 0;
+            for (const auto& phase : _phases) {
+                std::fprintf(stderr, "%-10s %10.3f ms\n", phase.first, phase.second);
+                total += phase.second;
+            }
+            if (_enabled) {
+                std::fprintf(stderr, "%-10s %10.3f ms\n", "total", total);
+            }
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        bool _enabled;
+        Clock::time_point _start;
+        std::vector<std::pair<const char*, double>> _phases;
+    };
+
+    void PrintUsage() {
+        std::fprintf(stderr,
+            "usage: jdp diff <left.json> <right.json> [--binary] [--pretty] [--stream] [--stats] [--trace FILE]\n"
+            "       jdp patch <left.json> <delta> [--binary] [--pretty] [--stats] [--trace FILE]\n"
+            "       jdp unpatch <right.json> <delta> [--binary] [--pretty] [--stats] [--trace FILE]\n"
+            "       jdp pipeline [records.ndjson] [--unpatch] [--lanes N] [--stats]\n");
+    }
+
+    json Parse(const MappedFile& file) {
+        return file.size() == 0 ? json("") : json::parse(file.data(), file.data() + file.size());
+    }
+
+    void Write(const void* data, size_t size) {
+        if (size > 0 && std::fwrite(data, 1, size, stdout) != size) {
+            throw std::runtime_error("write failed");
+        }
+    }
+
+    std::string Serialize(const json& value, bool pretty) {
+        std::string text = value.dump(pretty ? 2 : -1);
+        text += '\n';
+        return text;
+    }
+
+    int RunDiff(const CommandLine& cmd) {
+        TraceOutput trace(cmd.trace);
+        JsonDiffPatch::JsonDiffPatch jdp(trace.Options());
+        PhaseTimer timer(cmd.stats);
+
+        MappedFile left(cmd.files[0]);
+        MappedFile right(cmd.files[1]);
+        timer.Mark("map");
+
+        json delta;
+        if (cmd.stream) {
+            jdp.DiffStream(left.data(), left.size(), right.data(), right.size(),
+                [&delta](const std::vector<std::string>& path, json&& fragment) {
+                    JsonDiffPatch::JsonDiffPatch::ApplyFragment(delta, path, std::move(fragment));
+                });
+            timer.Mark("diff");
+        } else {
+            json leftJson = Parse(left);
+            json rightJson = Parse(right);
+            timer.Mark("parse");
+            delta = jdp.Diff(leftJson, rightJson);
+            timer.Mark("diff");
+        }
+
+        if (!delta.is_null()) {
+            if (cmd.binary) {
+                std::vector<uint8_t> encoded = JsonDiffPatch::BinaryDelta::Encode(delta);
+                timer.Mark("serialize");
+                Write(encoded.data(), encoded.size());
+            } else {
+                std::string text = Serialize(delta, cmd.pretty);
+                timer.Mark("serialize");
+                Write(text.data(), text.size());
+            }
+        }
+        std::fflush(stdout);
+        timer.Mark("write");
+        timer.Print();
+
+        return delta.is_null() ? EXIT_EQUAL : EXIT_DIFFERENT;
+    }
+
+    int RunPatch(const CommandLine& cmd, bool reverse) {
+        TraceOutput trace(cmd.trace);
+        JsonDiffPatch::JsonDiffPatch jdp(trace.Options());
+        PhaseTimer timer(cmd.stats);
+
+        MappedFile document(cmd.files[0]);
+        MappedFile deltaFile(cmd.files[1]);
+        timer.Mark("map");
+
+        json documentJson = Parse(document);
+        json delta = cmd.binary
+            ? JsonDiffPatch::BinaryDelta::Decode(deltaFile.bytes(), deltaFile.size())
+            : (deltaFile.size() == 0 ? json(nullptr) : json::parse(deltaFile.data(), deltaFile.data() + deltaFile.size()));
+        timer.Mark("parse");
+
+        json result = reverse ? jdp.Unpatch(documentJson, delta) : jdp.Patch(documentJson, delta);
+        timer.Mark(reverse ? "unpatch" : "patch");
+
+        std::string text = Serialize(result, cmd.pretty);
+        timer.Mark("serialize");
+        Write(text.data(), text.size());
+        std::fflush(stdout);
+        timer.Mark("write");
+        timer.Print();
+
+        return EXIT_OK;
+    }
+
+    int RunPipeline(const CommandLine& cmd) {
+        PhaseTimer timer(cmd.stats);
+        JsonDiffPatch::PipelineOptions pipelineOptions;
+        pipelineOptions.Lanes = cmd.lanes;
+        pipelineOptions.Unpatch = cmd.unpatch;
+
+        std::ifstream file;
+        if (!cmd.files.empty()) {
+            file.open(cmd.files[0], std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("cannot open " + cmd.files[0]);
+            }
+        }
+        std::istream& in = cmd.files.empty() ? std::cin : file;
+
+        size_t records = JsonDiffPatch::RunNdjsonPipeline(in, std::cout, JsonDiffPatch::Options(), pipelineOptions);
+        if (!std::cout) {
+            throw std::runtime_error("write failed");
+        }
+        timer.Mark("pipeline");
+        if (cmd.stats) {
+            std::fprintf(stderr, "%-10s %10zu\n", "records", records);
+        }
+        timer.Print();
+
+        return EXIT_OK;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CommandLine cmd;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--binary") cmd.binary = true;
+        else if (arg == "--pretty") cmd.pretty = true;
+        else if (arg == "--stream") cmd.stream = true;
+        else if (arg == "--stats") cmd.stats = true;
+        else if (arg == "--unpatch") cmd.unpatch = true;
+        else if (arg == "--lanes" && i + 1 < argc) cmd.lanes = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--trace" && i + 1 < argc) cmd.trace = argv[++i];
+        else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+            std::fprintf(stderr, "jdp: unknown option %s\n", arg.c_str());
+            PrintUsage();
+            return EXIT_ERROR;
+        }
+        else if (cmd.command.empty()) cmd.command = arg;
+        else cmd.files.push_back(arg);
+    }
+
+    bool pipeline = cmd.command == "pipeline";
+    bool known = pipeline || cmd.command == "diff" || cmd.command == "patch" || cmd.command == "unpatch";
+    if (!known || (pipeline ? cmd.files.size() > 1 : cmd.files.size() != 2)) {
+        PrintUsage();
+        return EXIT_ERROR;
+    }
+
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    try {
+        if (pipeline) {
+            std::ios::sync_with_stdio(false);
+            return RunPipeline(cmd);
+        }
+        if (cmd.command == "diff") {
+            return RunDiff(cmd);
+        }
+        return RunPatch(cmd, cmd.command == "unpatch");
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "jdp: %s\n", e.what());
+        return EXIT_ERROR;
+    }
+}